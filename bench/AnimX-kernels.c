@@ -0,0 +1,369 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+
+// Micro-benchmarks of the kernels behind the pipeline: swscale with
+// every flag worth considering, the crossfade blend, the tile diff,
+// frame copies and both upload paths. Everything runs through the same
+// functions AnimX itself calls, on buffers of real monitor sizes.
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+
+#include <X11/Xlib.h>
+
+#include "AnimX-blend.h"
+#include "AnimX-context.h"
+#include "AnimX-gl.h"
+#include "AnimX-session.h"
+#include "AnimX-tiles.h"
+#include "AnimX-upload.h"
+
+// AnimX-context.c reads the configured fps
+__typeof__(g_config) g_config = { .fps = 30, .mon = -2 };
+
+typedef struct {
+        const char *name;
+        int width, height;
+} Size;
+
+static const Size sizes[] = {
+        { "1080p", 1920, 1080 },
+        { "1440p", 2560, 1440 },
+        { "4k", 3840, 2160 },
+        { "ultrawide", 3440, 1440 },
+};
+
+typedef struct {
+        const char *name;
+        int flags;
+} Scaler;
+
+static const Scaler scalers[] = {
+        { "fast_bilinear", SWS_FAST_BILINEAR },
+        { "bilinear", SWS_BILINEAR },
+        { "bicubic", SWS_BICUBIC },
+        { "point", SWS_POINT },
+        { "area", SWS_AREA },
+};
+
+typedef enum {
+        KERNEL_SCALE,
+        KERNEL_BLEND,
+        KERNEL_TILES_DIFF,
+        KERNEL_MEMCPY,
+        KERNEL_MEMCPY_ROWS,
+        KERNEL_UPLOAD,
+} Kernel_Type;
+
+// Everything one kernel works on, set up once per size
+typedef struct {
+        Kernel_Type type;
+        Context *ctx;        // Scale and tile diff
+        uint8_t *a, *b, *dst; // BGRA frames
+        uint8_t *mask;
+        int width, height;
+        size_t size;         // Bytes of one BGRA frame
+        Uploader *up;
+        Display_Session *ds;
+} Kernel;
+
+static struct {
+        int warmup;
+        int reps;
+        int cpu;             // -1 for no pinning
+        const char *filter;  // Only kernels whose name contains this
+        int src_width, src_height; // Video scaled from
+} opts = { 5, 50, -1, NULL, 1920, 1080 };
+
+static long now_ns(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (long)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static int cmp_long(const void *a, const void *b) {
+        long x = *(const long *)a, y = *(const long *)b;
+        return (x > y) - (x < y);
+}
+
+static void run_kernel(Kernel *k) {
+        switch (k->type) {
+        case KERNEL_SCALE:
+                context_scale_frame(k->ctx);
+                break;
+        case KERNEL_BLEND:
+                blend_bgra(k->dst, k->a, k->b, 128, k->size);
+                break;
+        case KERNEL_TILES_DIFF:
+                tiles_diff(k->ctx, k->a, k->b, k->mask);
+                break;
+        case KERNEL_MEMCPY:
+                memcpy(k->dst, k->a, k->size);
+                break;
+        case KERNEL_MEMCPY_ROWS: {
+                size_t row = (size_t)k->width * 4;
+                for (int y = 0; y < k->height; y++) {
+                        memcpy(k->dst + y * row, k->a + y * row, row);
+                }
+        } break;
+        case KERNEL_UPLOAD: {
+                uint8_t *data = upload_acquire(k->up, k->ds, k->size);
+                if (!data) break;
+                XRectangle src = { 0, 0, (unsigned short)k->width, (unsigned short)k->height };
+                pthread_mutex_lock(&k->ds->lock);
+                upload_put(k->up, k->ds, k->ds->root_pixmap, k->ds->root_gc, 0, k->width, k->height, &src, 0, 0);
+                XSync(k->ds->display, False); // Until the server has the pixels
+                pthread_mutex_unlock(&k->ds->lock);
+        } break;
+        }
+}
+
+// Bytes read and written per run, for GB/s
+static double kernel_bytes(const Kernel *k) {
+        double frame = (double)k->size;
+        switch (k->type) {
+        case KERNEL_SCALE:
+                return frame + opts.src_width * opts.src_height * 1.5; // YUV 4:2:0 in
+        case KERNEL_BLEND:
+                return frame * 3;
+        case KERNEL_TILES_DIFF:
+        case KERNEL_MEMCPY:
+        case KERNEL_MEMCPY_ROWS:
+                return frame * 2;
+        case KERNEL_UPLOAD:
+                return frame;
+        }
+        return frame;
+}
+
+static void bench_kernel(const char *name, const Size *sz, Kernel *k) {
+        if (opts.filter && !strstr(name, opts.filter)) return;
+        for (int i = 0; i < opts.warmup; i++) {
+                run_kernel(k);
+        }
+        long *times = (long *)malloc(opts.reps * sizeof(long));
+        if (!times) return;
+        for (int i = 0; i < opts.reps; i++) {
+                long start = now_ns();
+                run_kernel(k);
+                times[i] = now_ns() - start;
+        }
+        qsort(times, opts.reps, sizeof(long), cmp_long);
+        long median = times[opts.reps / 2];
+        double pixels = (double)k->width * k->height;
+        printf("%-24s %-10s %9.3f %9.3f %8.2f %8.2f\n", name, sz->name,
+               (double)median / pixels, kernel_bytes(k) / (double)median,
+               (double)median / 1e6, (double)times[0] / 1e6);
+        free(times);
+}
+
+// A decoded YUV 4:2:0 frame with a gradient, like a real video frame
+static AVFrame *make_frame(void) {
+        AVFrame *frame = av_frame_alloc();
+        if (!frame) return NULL;
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = opts.src_width;
+        frame->height = opts.src_height;
+        if (av_frame_get_buffer(frame, 0) < 0) {
+                av_frame_free(&frame);
+                return NULL;
+        }
+        for (int p = 0; p < 3; p++) {
+                int h = p ? (opts.src_height + 1) / 2 : opts.src_height;
+                for (int y = 0; y < h; y++) {
+                        for (int x = 0; x < frame->linesize[p]; x++) {
+                                frame->data[p][y * frame->linesize[p] + x] = (uint8_t)(x + y + p * 64);
+                        }
+                }
+        }
+        return frame;
+}
+
+// The parts of a headless Context the kernels read: one surface
+// covering the whole frame, laid out like AnimX-context.c does
+static int init_kernel_context(Context *ctx, AVCodecContext *codec_ctx, AVFrame *frame,
+                               const Size *sz, uint8_t *bgra) {
+        Surface *sf = (Surface *)calloc(1, sizeof(Surface));
+        if (!sf) return -1;
+        sf->width = sz->width;
+        sf->height = sz->height;
+        sf->src_width = opts.src_width;
+        sf->src_height = opts.src_height;
+        sf->tiles_x = (sf->width + TILE_SIZE - 1) / TILE_SIZE;
+        sf->tiles_y = (sf->height + TILE_SIZE - 1) / TILE_SIZE;
+        ctx->surfaces = sf;
+        ctx->num_surfaces = 1;
+        ctx->num_tiles = sf->tiles_x * sf->tiles_y;
+        ctx->codec_ctx = codec_ctx;
+        ctx->frame = frame;
+        ctx->bgra_buffer = bgra;
+        ctx->bgra_size = sz->width * sz->height * 4;
+        return 0;
+}
+
+static void bench_size(const Size *sz, AVCodecContext *codec_ctx, AVFrame *frame, Display_Session *ds) {
+        size_t size = (size_t)sz->width * sz->height * 4;
+        Kernel k = { .width = sz->width, .height = sz->height, .size = size };
+        Context ctx = {0};
+        k.a = (uint8_t *)malloc(size);
+        k.b = (uint8_t *)malloc(size);
+        k.dst = (uint8_t *)malloc(size);
+        if (!k.a || !k.b || !k.dst || init_kernel_context(&ctx, codec_ctx, frame, sz, k.dst) < 0) {
+                fprintf(stderr, "Out of memory for %s\n", sz->name);
+                goto done;
+        }
+        k.ctx = &ctx;
+        k.mask = (uint8_t *)malloc(ctx.num_tiles);
+        if (!k.mask) goto done;
+        // Identical frames, so the tile diff has to look at every byte
+        for (size_t i = 0; i < size; i++) {
+                k.a[i] = k.b[i] = (uint8_t)(i * 7);
+        }
+
+        char name[64];
+        k.type = KERNEL_SCALE;
+        for (size_t i = 0; i < sizeof(scalers) / sizeof(*scalers); i++) {
+                ctx.surfaces[0].sws_ctx = sws_getContext(opts.src_width, opts.src_height, AV_PIX_FMT_YUV420P,
+                                                         sz->width, sz->height, AV_PIX_FMT_BGRA,
+                                                         scalers[i].flags, NULL, NULL, NULL);
+                if (!ctx.surfaces[0].sws_ctx) continue;
+                snprintf(name, sizeof(name), "scale/%s%s", scalers[i].name,
+                         scalers[i].flags == CONTEXT_SWS_FLAGS ? "*" : "");
+                bench_kernel(name, sz, &k);
+                sws_freeContext(ctx.surfaces[0].sws_ctx);
+                ctx.surfaces[0].sws_ctx = NULL;
+        }
+
+        k.type = KERNEL_BLEND;
+        bench_kernel("blend_bgra", sz, &k);
+        k.type = KERNEL_TILES_DIFF;
+        bench_kernel("tiles_diff", sz, &k);
+        k.type = KERNEL_MEMCPY;
+        bench_kernel("copy/memcpy", sz, &k);
+        k.type = KERNEL_MEMCPY_ROWS;
+        bench_kernel("copy/rows", sz, &k);
+
+        if (ds->display && sz->width <= ds->root_width && sz->height <= ds->root_height) {
+                k.type = KERNEL_UPLOAD;
+                k.ds = ds;
+                Uploader up = {0};
+                k.up = &up;
+                if (upload_acquire(&up, ds, size)) { // Picks the kind AnimX would use
+                        snprintf(name, sizeof(name), "upload/%s", upload_kind_name(&up));
+                        bench_kernel(name, sz, &k);
+                }
+                upload_cleanup(&up, ds);
+                if (up.kind == UPLOAD_XCB_SHM) {
+                        // The fallback AnimX uses without shared memory
+                        Uploader xlib = { .kind = UPLOAD_XLIB, .probed = 1 };
+                        k.up = &xlib;
+                        bench_kernel("upload/xlib", sz, &k);
+                        upload_cleanup(&xlib, ds);
+                }
+        }
+
+done:
+        free(k.mask);
+        free(ctx.surfaces);
+        free(k.a);
+        free(k.b);
+        free(k.dst);
+}
+
+static void usage(const char *prog) {
+        printf("Usage: %s [--warmup=N] [--reps=N] [--cpu=N] [--filter=<name>] [--src=<w>x<h>]\n", prog);
+        printf("Runs every kernel at 1080p, 1440p, 4K and ultrawide sizes. Times are per run,\n");
+        printf("ns/px and GB/s come from the median; `*` marks the scaler AnimX uses.\n");
+        printf("Upload kernels need an X server (DISPLAY) with a root at least as large.\n");
+}
+
+int main(int argc, char **argv) {
+        for (int i = 1; i < argc; i++) {
+                const char *arg = argv[i];
+                if (!strncmp(arg, "--warmup=", 9)) {
+                        opts.warmup = atoi(arg + 9);
+                } else if (!strncmp(arg, "--reps=", 7)) {
+                        opts.reps = atoi(arg + 7);
+                } else if (!strncmp(arg, "--cpu=", 6)) {
+                        opts.cpu = atoi(arg + 6);
+                } else if (!strncmp(arg, "--filter=", 9)) {
+                        opts.filter = arg + 9;
+                } else if (!strncmp(arg, "--src=", 6)) {
+                        if (sscanf(arg + 6, "%dx%d", &opts.src_width, &opts.src_height) != 2
+                            || opts.src_width <= 0 || opts.src_height <= 0) {
+                                fprintf(stderr, "Invalid source size: %s\n", arg + 6);
+                                return 1;
+                        }
+                } else {
+                        usage(argv[0]);
+                        return !strcmp(arg, "--help") ? 0 : 1;
+                }
+        }
+        if (opts.reps < 1) opts.reps = 1;
+        if (opts.warmup < 0) opts.warmup = 0;
+
+        if (opts.cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(opts.cpu, &set);
+                if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+                        perror("sched_setaffinity");
+                        return 1;
+                }
+        }
+
+        AVCodecContext *codec_ctx = avcodec_alloc_context3(NULL);
+        AVFrame *frame = make_frame();
+        if (!codec_ctx || !frame) {
+                fprintf(stderr, "Could not allocate the source frame\n");
+                return 1;
+        }
+        codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+        codec_ctx->width = opts.src_width;
+        codec_ctx->height = opts.src_height;
+
+        Display_Session ds = DISPLAY_SESSION_INIT;
+        if (!getenv("DISPLAY") || init_display_session(&ds) < 0) {
+                fprintf(stderr, "No X server, skipping the upload kernels\n");
+        }
+
+        printf("# source %dx%d yuv420p, %d warmup, %d reps, cpu %d\n",
+               opts.src_width, opts.src_height, opts.warmup, opts.reps, opts.cpu);
+        printf("%-24s %-10s %9s %9s %8s %8s\n", "kernel", "size", "ns/px", "GB/s", "med ms", "min ms");
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+                bench_size(&sizes[i], codec_ctx, frame, &ds);
+        }
+
+        if (ds.display) cleanup_display_session(&ds);
+        av_frame_free(&frame);
+        avcodec_free_context(&codec_ctx);
+        return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef ANIMX_BENCH_H
+#define ANIMX_BENCH_H
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+// Pipeline stages --bench can run. A stage that is switched off still
+// runs once up front when a later stage needs its output, so e.g.
+// `scale,present` keeps scaling and presenting the same decoded frame.
+typedef enum {
+        BENCH_DEMUX = 1 << 0,
+        BENCH_DECODE = 1 << 1, // Needs BENCH_DEMUX
+        BENCH_SCALE = 1 << 2,
+        BENCH_PRESENT = 1 << 3, // Hands frames to --sink
+} Bench_Stage;
+
+#define BENCH_DEFAULT_STAGES (BENCH_DEMUX | BENCH_DECODE | BENCH_SCALE)
+
+typedef struct {
+        const char *file;
+        int seconds;     // How long to run
+        int fps;         // Target rate, 0 for as fast as possible
+        unsigned stages; // Bench_Stage bits
+} Bench_Options;
+
+typedef struct {
+        long launch_us;    // Before the video was opened
+        long startup_us;   // From `launch_us` until the first frame was done
+        long start_us, wall_us;
+        unsigned long frames;
+        long last_start_us; // Frame pacing: intervals between frame starts
+        double interval_sum, interval_sq;
+        long interval_max;
+        int width, height; // What frames were scaled to
+        struct rusage usage_start, usage_end;
+        unsigned long heap_start, heap_end; // Heap bytes in use
+} Bench_Result;
+
+// Parses a comma separated list of `demux`, `decode`, `scale` and
+// `present`. Returns -1 on an unknown or inconsistent list.
+int bench_parse_stages(const char *list, unsigned *stages);
+
+// Snapshots the clock, CPU time and heap use around the run.
+void bench_begin(Bench_Result *res);
+void bench_end(Bench_Result *res);
+
+// Counts a frame that started at `start_us` and is done now.
+void bench_frame_done(Bench_Result *res, long start_us);
+
+// Moves stdout to stderr, so whatever the pipeline prints does not mix
+// with the report, and returns a stream on the original stdout.
+FILE *bench_report_stream(void);
+
+// Writes the options, throughput, CPU time, peak RSS, heap growth and
+// the per-stage numbers of AnimX-stats.h as a single JSON object.
+void bench_report(FILE *out, const Bench_Options *opts, const Bench_Result *res);
+
+#endif // ANIMX_BENCH_H
@@ -0,0 +1,11 @@
+#ifndef ANIMX_BLEND_H
+#define ANIMX_BLEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Crossfades two BGRA buffers of `n` bytes into `dst`.
+// `alpha` is the weight of `a` in the range [0, 256].
+void blend_bgra(uint8_t *dst, const uint8_t *a, const uint8_t *b, int alpha, size_t n);
+
+#endif // ANIMX_BLEND_H
@@ -3,40 +3,113 @@
 
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
 #include <X11/extensions/Xrandr.h>
 
+#include "AnimX-session.h"
+#include "AnimX-sink.h"
+#include "AnimX-upload.h"
+
+// How every surface is scaled, bench/AnimX-kernels.c compares it
+// against the other swscale flags
+#define CONTEXT_SWS_FLAGS SWS_BILINEAR
+
+// Ways to trade quality for CPU time, see context_set_quality()
+typedef enum {
+        QUALITY_FAST_SCALER = 1 << 0, // SWS_FAST_BILINEAR instead of CONTEXT_SWS_FLAGS
+        QUALITY_FAST_DECODE = 1 << 1, // No deblocking, and shortcuts where the decoder has them
+        QUALITY_SKIP_NONREF = 1 << 2, // Frames nothing else refers to are not decoded at all
+} Quality_Reduction;
+
+// One scaled copy of (part of) the video inside each frame buffer.
+// Single mode has exactly one. Combined mode has one per CRTC, each
+// scaled from the matching crop of the video, so the parts of the
+// bounding box no monitor shows are never converted or uploaded.
+// Mirror mode has one per distinct monitor resolution, uploaded once
+// per frame into `pixmap` and copied to every monitor of that
+// resolution by the server.
 typedef struct {
-        Display *display;
-        int screen;
-        Window root;
-        Visual *visual;
-        int depth;
-        XRRScreenResources *screen_res;
-        XRROutputInfo **output_infos; // Array for multiple monitors
-        XRRCrtcInfo **crtc_infos; // Array for multiple monitors
+        int width, height;
+        long x, y;         // Where the surface is shown (the first monitor in mirror mode)
+        int offset;        // Byte offset of this surface in a frame buffer
+        int cropped;       // Shows only part of the bounding box, combined mode only
+        int src_x, src_y, src_width, src_height; // Part of the video scaled into this surface
+        struct SwsContext *sws_ctx;
+        Pixmap pixmap;     // Mirror mode only
+        GC gc;
+        int *monitors;     // Indices into `ds->crtc_infos` showing this surface, mirror mode only
+        int num_monitors;
+        int tiles_x, tiles_y; // Grid of TILE_SIZE tiles, see AnimX-tiles.h
+        int tile_offset;   // Index of this surface's first tile in a tile mask
+} Surface;
+
+typedef struct {
+        Display_Session *ds; // Borrowed, outlives the context
+        Sink *sink;          // Borrowed, NULL means SINK_X11
+        int monitor_index; // --mon this context was laid out for
+        unsigned layout_gen; // `ds->layout_gen` the geometry below belongs to
         int num_monitors; // Number of monitors
-        long monitor_x, monitor_y, monitor_width, monitor_height; // Used for single or combined mode
-        Pixmap *monitor_pixmaps; // Array of pixmaps for each monitor in mirror mode
-        GC *monitor_gcs; // Array of GCs for each monitor in mirror mode
-        Pixmap root_pixmap; // Used for single or combined mode
-        GC root_gc; // Used for single or combined mode
-        Atom xrootpmap_id, esetroot_pmap_id;
+        long monitor_x, monitor_y, monitor_width, monitor_height; // Used for single or combined mode, first surface in mirror mode
+        Surface *surfaces;
+        int num_surfaces;
         AVFormatContext *fmt_ctx;
         int video_stream_idx;
         AVCodecContext *codec_ctx;
         AVCodecParameters *codec_par;
-        struct SwsContext *sws_ctx;
-        AVFrame *frame, *bgra_frame;
+        AVFrame *frame;
         AVPacket *packet;
-        uint8_t *bgra_buffer;
+        uint8_t *bgra_buffer; // Every surface of the current frame, packed
         int bgra_size;
         double frame_interval;
         double video_time_base;
         int64_t frame_duration;
         int mirror_mode; // Flag to indicate --mon=-2 (mirror mode)
+        uint8_t *fade_from; // Snapshot of the previous wallpaper to crossfade from
+        int fade_step, fade_steps;
+        int num_tiles;      // Tiles over all surfaces
+        uint8_t *tile_mask; // Scratch mask of changed tiles
+        XRectangle *tile_rects; // Scratch rectangles built from `tile_mask`
+        int *tile_runs;     // Scratch for tiles_rects(), two rows of the widest surface
+        Uploader upload;    // Buffers frames are rendered into and uploaded from
+        uint8_t *last_frame; // What was last put into the root pixmap (a slot of `upload`), NULL to upload everything
+        int last_blended;    // `last_frame` was part of a crossfade
+        unsigned long last_visible; // Monitors that were visible for `last_frame`, mirror mode
+        unsigned quality;   // Quality_Reduction bits in effect
 } Context;
 
 void cleanup_context(Context *ctx);
-int init_context(Context *ctx, int monitor_index, const char *video_mp4);
+// With a sink other than SINK_X11 in `ctx->sink` this opens no display
+// and lays the context out like init_context_headless() at the size of
+// the sink.
+int init_context(Context *ctx, Display_Session *ds, int monitor_index, const char *video_mp4);
+
+// A context without a display: one surface of `width`x`height` (the
+// video size where 0) that frames are scaled into and never shown.
+// Used by --bench and --sink, `ctx->ds` stays NULL.
+int init_context_headless(Context *ctx, int width, int height, const char *video_mp4);
+
+// True once the session has re-read the monitors since the last layout.
+int context_layout_stale(Context *ctx);
+
+// Lays the context out again for the current monitors and rebuilds the
+// surfaces and BGRA buffer to match. The demuxer and decoder are kept, so
+// this is cheap enough to do between two frames.
+int context_relayout(Context *ctx);
+
+// Scales `ctx->frame` into every surface of `ctx->bgra_buffer`.
+void context_scale_frame(Context *ctx);
+
+// Changes how often frames are sampled from the video, nothing is rebuilt.
+void context_set_fps(Context *ctx, int fps);
+
+// Roughly what the context itself holds in bytes: the frame buffers
+// it scales and uploads from, and an estimate of the decoder's frame
+// pool. Other contexts and the rest of the process are not counted.
+size_t context_footprint(const Context *ctx);
+
+// Applies Quality_Reduction bits from the next decoded frame on. Only
+// the scalers are rebuilt, and only when QUALITY_FAST_SCALER changes.
+// Must be called from the thread that decodes and scales.
+int context_set_quality(Context *ctx, unsigned quality);
 
 #endif // ANIMX_CONTEXT_H
@@ -15,6 +15,27 @@
 #define FLAG_2HY_RESTORE "restore"
 #define FLAG_2HY_COPYING "copying"
 #define FLAG_2HY_VERSION "version"
+#define FLAG_2HY_PLAYLIST "playlist"
+#define FLAG_2HY_INTERVAL "interval"
+#define FLAG_2HY_ORDER "order"
+#define FLAG_2HY_FADE "fade"
+#define FLAG_2HY_STATUS "status"
+#define FLAG_2HY_PAUSE "pause"
+#define FLAG_2HY_RESUME "resume"
+#define FLAG_2HY_STEP "step"
+#define FLAG_2HY_OCCLUSION "occlusion"
+#define FLAG_2HY_IDLE "idle"
+#define FLAG_2HY_IDLEFPS "idlefps"
+#define FLAG_2HY_BACKEND "backend"
+#define FLAG_2HY_STATS "stats"
+#define FLAG_2HY_BENCH "bench"
+#define FLAG_2HY_STAGES "stages"
+#define FLAG_2HY_SIZE "size"
+#define FLAG_2HY_SINK "sink"
+#define FLAG_2HY_TRACE "trace"
+#define FLAG_2HY_LOGLEVEL "loglevel"
+#define FLAG_2HY_THREADSTATS "threadstats"
+#define FLAG_2HY_CPUBUDGET "cpu-budget"
 
 typedef enum {
         FT_MAXMEM = 1 << 0,
@@ -10,6 +10,14 @@ extern struct {
         int mode;
         double maxmem;
         int fps;
+        char *playlist;
+        int interval;
+        int order;
+        int fade;
+        int occlusion;
+        int idle;
+        int idle_fps;
+        int backend;
 } g_config;
 
 #endif // ANIMX_GL_H
@@ -0,0 +1,43 @@
+#ifndef ANIMX_GOVERNOR_H
+#define ANIMX_GOVERNOR_H
+
+// Holds AnimX to --cpu-budget, a share of one core. Once a second it
+// compares the process's CPU time with the budget and the CPU cost of a
+// presented frame. Over budget it gives up quality first, one
+// Quality_Reduction (AnimX-context.h) per step since they are hard to
+// see, then frame rate in proportion to the overshoot. After a few calm
+// seconds well below the budget it takes the same steps back, frame
+// rate first.
+
+// Where an over-budget reading needs to be, and how far below the
+// budget it has to stay for GOVERNOR_CALM_TICKS, to change anything
+#define GOVERNOR_HIGH 1.10
+#define GOVERNOR_LOW 0.70
+#define GOVERNOR_CALM_TICKS 3
+#define GOVERNOR_TICK_US 1000000L
+#define GOVERNOR_MIN_PERCENT 5 // Frame rate never drops below this share
+
+// Called from the governor thread when the frame rate share changed.
+// Quality is read by the pipelines themselves, see governor_quality().
+typedef void (*Governor_Changed)(int fps_percent, void *user);
+
+// Parses a percentage of one core, e.g. `5` or `12.5`. 0 turns the
+// governor off. Returns -1 on anything else.
+int governor_parse_budget(const char *s, double *percent);
+
+// Starts the governor, or changes the budget of a running one. A budget
+// of 0 restores full quality and frame rate, through `changed` as well,
+// and leaves the thread idle until a budget is set again.
+int governor_set_budget(double percent, Governor_Changed changed, void *user);
+
+// Joins the thread and resets quality and frame rate without calling
+// `changed`, for shutdown. Must not be called while holding a lock
+// `changed` takes.
+void governor_stop(void);
+
+// Quality_Reduction bits for the pipelines, cheap enough to poll per frame
+unsigned governor_quality(void);
+int governor_fps_percent(void);
+double governor_budget(void);
+
+#endif // ANIMX_GOVERNOR_H
@@ -0,0 +1,29 @@
+#ifndef ANIMX_HOTPLUG_H
+#define ANIMX_HOTPLUG_H
+
+#include <pthread.h>
+
+#include <X11/Xlib.h>
+
+// Called from the watcher thread once a burst of RandR notifies has
+// settled, i.e. after docking, undocking or an xrandr call.
+typedef void (*Hotplug_Changed)(void *user);
+
+// Listens for RRScreenChangeNotify and RRNotify (CRTC and output
+// changes) on a connection of its own.
+typedef struct {
+        Display *display;
+        int rr_event_base;
+        pthread_t thread;
+        int started;    // `thread` exists and has to be joined
+        int wake_fd[2]; // Written to by hotplug_stop()
+        Hotplug_Changed changed;
+        void *user;
+} Hotplug;
+
+#define HOTPLUG_INIT { .display = NULL, .wake_fd = {-1, -1} }
+
+int hotplug_start(Hotplug *hp, Hotplug_Changed changed, void *user);
+void hotplug_stop(Hotplug *hp);
+
+#endif // ANIMX_HOTPLUG_H
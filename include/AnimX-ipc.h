@@ -0,0 +1,39 @@
+#ifndef ANIMX_IPC_H
+#define ANIMX_IPC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IPC_SOCK_PATH "/tmp/AnimX.sock"
+#define IPC_MAGIC 0x50495841 // "AXIP"
+#define IPC_MAX_PAYLOAD (64 * 1024)
+#define IPC_MAX_ARGS 64
+
+typedef enum {
+        IPC_CMD_SET = 1,     // Payload: client cwd followed by argv, each NUL terminated
+        IPC_CMD_STATUS,      // No payload
+        IPC_CMD_STATS,       // Payload: optionally "reset", NUL terminated
+        IPC_REPLY = 0x100,   // Payload: text, `status` is 0 on success
+} Ipc_Type;
+
+// Every message is a single SOCK_SEQPACKET record: this header
+// followed by exactly `len` bytes of payload.
+typedef struct {
+        uint32_t magic;
+        uint16_t type;
+        uint16_t status;
+        uint32_t len;
+} Ipc_Header;
+
+typedef struct {
+        Ipc_Header hdr;
+        char payload[IPC_MAX_PAYLOAD + 1]; // Always NUL terminated
+} Ipc_Msg;
+
+int ipc_listen(const char *path);
+int ipc_connect(const char *path);
+int ipc_send(int fd, uint16_t type, uint16_t status, const void *payload, size_t len);
+int ipc_recv(int fd, Ipc_Msg *msg);
+int ipc_split_args(Ipc_Msg *msg, char **argv, int max);
+
+#endif // ANIMX_IPC_H
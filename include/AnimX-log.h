@@ -0,0 +1,58 @@
+#ifndef ANIMX_LOG_H
+#define ANIMX_LOG_H
+
+#include <stdatomic.h>
+
+typedef enum {
+        LEVEL_ERROR,
+        LEVEL_WARN,
+        LEVEL_INFO,
+        LEVEL_DEBUG,
+} Log_Level;
+
+// Messages above this level are dropped before anything is formatted
+extern atomic_int g_log_level;
+
+static inline int log_enabled(Log_Level level) {
+        return (int)level <= atomic_load_explicit(&g_log_level, memory_order_relaxed);
+}
+
+// Formats into a ring owned by the calling thread and returns; a
+// background thread writes it to syslog (and the terminal with
+// `console`). Never blocks, a full ring drops the message and counts it.
+// Before log_start() and after log_stop() messages are written directly.
+void log_write(Log_Level level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// True at most once per `interval_us` for the call site owning `next_us`
+int log_ratelimit(atomic_long *next_us, long interval_us);
+
+#define log_at(level, ...)                                              \
+        do {                                                            \
+                if (log_enabled(level)) log_write((level), __VA_ARGS__); \
+        } while (0)
+
+#define log_error(...) log_at(LEVEL_ERROR, __VA_ARGS__)
+#define log_warn(...) log_at(LEVEL_WARN, __VA_ARGS__)
+#define log_info(...) log_at(LEVEL_INFO, __VA_ARGS__)
+#define log_debug(...) log_at(LEVEL_DEBUG, __VA_ARGS__)
+
+// For per-frame messages: at most one per `interval_us` from this call
+// site, the rest are dropped without being formatted.
+#define log_every(level, interval_us, ...)                              \
+        do {                                                            \
+                static atomic_long log_next_us_;                        \
+                if (log_enabled(level) && log_ratelimit(&log_next_us_, (interval_us))) \
+                        log_write((level), __VA_ARGS__);                \
+        } while (0)
+
+// Parses `error`, `warn`, `info` or `debug`, -1 otherwise.
+int log_parse_level(const char *name);
+
+// Starts the thread that drains every ring. `console` also prints
+// messages, errors and warnings to stderr and the rest to stdout.
+int log_start(int console);
+
+// Writes out everything queued so far and stops the thread.
+void log_stop(void);
+
+#endif // ANIMX_LOG_H
@@ -0,0 +1,51 @@
+#ifndef ANIMX_MEMORY_H
+#define ANIMX_MEMORY_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Resident memory of the whole process in bytes, -1 if unknown.
+long mem_rss_bytes(void);
+
+// What malloc() really set aside for `ptr`: the requested size plus the
+// allocator's slack. 0 for NULL.
+size_t mem_block_size(void *ptr);
+
+// Called from the watcher thread when the system (or AnimX's cgroup)
+// starts running short of memory. At most once per MEMWATCH_WINDOW_US.
+typedef void (*Memwatch_Pressure)(void *user);
+
+typedef enum {
+        MEMWATCH_NONE,   // Nothing to watch, pressure is never reported
+        MEMWATCH_PSI,    // A trigger on /proc/pressure/memory
+        MEMWATCH_CGROUP, // New `high`, `max` or `oom` events in the cgroup's memory.events
+} Memwatch_Source;
+
+// PSI trigger: tasks stalled on memory for MEMWATCH_STALL_US within
+// MEMWATCH_WINDOW_US. A window of whole multiples of 2s is what the
+// kernel allows without privileges.
+#define MEMWATCH_STALL_US 150000
+#define MEMWATCH_WINDOW_US 2000000
+
+typedef struct {
+        Memwatch_Source source;
+        int fd;         // The trigger or memory.events
+        int wake_fd[2]; // Written to by memwatch_stop()
+        pthread_t thread;
+        int started;    // `thread` exists and has to be joined
+        pthread_mutex_t mutex;
+        unsigned long cg_events; // Sum of the counters last read from memory.events
+        unsigned long events;    // Pressure reported so far
+        Memwatch_Pressure pressure;
+        void *user;
+} Memwatch;
+
+#define MEMWATCH_INIT { .source = MEMWATCH_NONE, .fd = -1, .wake_fd = {-1, -1}, .mutex = PTHREAD_MUTEX_INITIALIZER }
+
+// Prefers PSI and falls back to the cgroup (v2) memory.events.
+int memwatch_start(Memwatch *mw, Memwatch_Pressure pressure, void *user);
+void memwatch_stop(Memwatch *mw);
+unsigned long memwatch_events(Memwatch *mw);
+const char *memwatch_source_name(const Memwatch *mw);
+
+#endif // ANIMX_MEMORY_H
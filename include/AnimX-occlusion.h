@@ -0,0 +1,48 @@
+#ifndef ANIMX_OCCLUSION_H
+#define ANIMX_OCCLUSION_H
+
+#include <pthread.h>
+
+#include <X11/Xlib.h>
+
+#include "AnimX-session.h"
+
+// Called from the watcher thread whenever the set of monitors that
+// show some wallpaper changes. Bit i stands for `ds->crtc_infos[i]`.
+typedef void (*Occlusion_Changed)(unsigned long visible, void *user);
+
+// Watches the stacking order and geometry of the root's children on a
+// connection of its own and works out which monitors are completely
+// covered. Only plain Xlib is used, so it behaves the same with or
+// without a window manager or compositor (and under Xvfb).
+typedef struct {
+        Display *display;
+        Window root;
+        Display_Session *ds; // Monitor rectangles are copied from here
+        XRectangle *monitors;
+        int num_monitors;
+        Window *own_windows; // The session's desktop windows, never count as covering
+        int num_own_windows;
+        Atom client_list_stacking;
+        pthread_t thread;
+        int started;    // `thread` exists and has to be joined
+        int wake_fd[2]; // Written to by occlusion_stop() and occlusion_refresh()
+        pthread_mutex_t mutex;
+        unsigned long visible;
+        Occlusion_Changed changed;
+        void *user;
+} Occlusion;
+
+#define OCCLUSION_INIT { .display = NULL, .wake_fd = {-1, -1}, .mutex = PTHREAD_MUTEX_INITIALIZER, .visible = ~0UL }
+
+int occlusion_start(Occlusion *oc, Display_Session *ds, Occlusion_Changed changed, void *user);
+void occlusion_stop(Occlusion *oc);
+
+// Re-reads the monitor rectangles and desktop windows after the session
+// was refreshed or changed backend.
+void occlusion_refresh(Occlusion *oc);
+
+// Bitmask of monitors with visible wallpaper, all bits when not watching.
+unsigned long occlusion_visible(Occlusion *oc);
+
+#endif // ANIMX_OCCLUSION_H
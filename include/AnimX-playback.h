@@ -0,0 +1,56 @@
+#ifndef ANIMX_PLAYBACK_H
+#define ANIMX_PLAYBACK_H
+
+#include <pthread.h>
+
+// Why playback is paused. Each reason is set and cleared on its own,
+// playback only continues once every reason is gone.
+typedef enum {
+        PAUSE_USER = 1 << 0,     // --pause from a client
+        PAUSE_OCCLUDED = 1 << 1, // Every monitor of the wallpaper is covered
+        PAUSE_IDLE = 1 << 2,     // User is idle and --idlefps=0
+        PAUSE_BLANKED = 1 << 3,  // Screensaver on or display powered off
+} Pause_Reason;
+
+// After a pause that involved one of these reasons the frames that were
+// buffered are stale, so playback picks up again at the next keyframe.
+#define PAUSE_RESYNC (PAUSE_OCCLUDED | PAUSE_IDLE | PAUSE_BLANKED)
+
+// Live playback parameters shared by every worker. Changing them never
+// rebuilds a pipeline: the presenting thread picks them up on its next
+// wait, and a paused presenter sleeps on `cond` until something changes.
+typedef struct {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        int fps;
+        int fps_cap;         // Upper bound on `fps` from the power policy, 0 for none
+        int fps_percent;     // Share of `fps` the CPU governor allows, 100 for all of it
+        unsigned pause_mask; // Pause_Reason bits, playing when 0
+        int steps;           // Frames that may still be shown while paused
+        int resync_pending;  // A PAUSE_RESYNC reason was set during this pause
+        unsigned resync;     // Bumped when playback resumes after such a pause
+} Playback;
+
+void playback_init(Playback *pb, int fps);
+// Rate frames are presented at: `fps` scaled by `fps_percent` (at
+// least 1), limited by `fps_cap`.
+int playback_fps(Playback *pb);
+unsigned playback_paused(Playback *pb);
+void playback_set_fps(Playback *pb, int fps);
+void playback_set_cap(Playback *pb, int cap);
+void playback_set_percent(Playback *pb, int percent);
+void playback_pause(Playback *pb, unsigned reason);
+void playback_resume(Playback *pb, unsigned reason);
+void playback_step(Playback *pb, int frames);
+unsigned playback_resync(Playback *pb);
+
+// Wakes every waiter so it can recheck `done`.
+void playback_wake(Playback *pb);
+
+// Waits until the frame after the one presented at `since_us` is due.
+// While paused this blocks without a timeout until playback resumes, a
+// step is requested or `*done` is set. Returns 0 when the next frame
+// should be presented and -1 once `*done` is set.
+int playback_wait(Playback *pb, long since_us, const int *done);
+
+#endif // ANIMX_PLAYBACK_H
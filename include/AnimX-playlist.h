@@ -0,0 +1,28 @@
+#ifndef ANIMX_PLAYLIST_H
+#define ANIMX_PLAYLIST_H
+
+#include <stddef.h>
+
+#include "dyn_array.h"
+
+typedef enum {
+        ORDER_SEQUENTIAL = 0,
+        ORDER_SHUFFLE,
+} Order_Type;
+
+DYN_ARRAY_TYPE(char *, Playlist_Items);
+
+typedef struct {
+        Playlist_Items items; // Absolute paths of every entry
+        size_t pos;           // Index of the next entry to hand out
+        int order;            // Uses Order_Type
+        unsigned int seed;    // rand_r() state for shuffling
+} Playlist;
+
+// Loads every regular file in the directory `path`, or every line
+// of the list file `path`. Returns the number of entries or -1.
+int playlist_load(Playlist *pl, const char *path, int order);
+const char *playlist_next(Playlist *pl);
+void playlist_free(Playlist *pl);
+
+#endif // ANIMX_PLAYLIST_H
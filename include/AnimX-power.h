@@ -0,0 +1,42 @@
+#ifndef ANIMX_POWER_H
+#define ANIMX_POWER_H
+
+#include <pthread.h>
+
+#include <X11/Xlib.h>
+
+typedef enum {
+        POWER_ACTIVE = 0, // Somebody is using the machine
+        POWER_IDLE,       // No input for longer than the idle timeout
+        POWER_OFF,        // Screensaver active or DPMS turned the display off
+} Power_State;
+
+typedef void (*Power_Changed)(Power_State state, void *user);
+
+// Follows user idle time (MIT-SCREEN-SAVER) and the display power level
+// (DPMS) on a connection of its own. Neither extension is required, a
+// missing one simply never reports its state.
+typedef struct {
+        Display *display;
+        int have_saver, have_dpms;
+        int saver_event_base;
+        pthread_t thread;
+        int started;    // `thread` exists and has to be joined
+        int wake_fd[2]; // Wakes the watcher for a new timeout or to stop
+        int stop;
+        pthread_mutex_t mutex;
+        int idle_s;     // 0 disables POWER_IDLE
+        Power_State state;
+        Power_Changed changed;
+        void *user;
+} Power;
+
+#define POWER_INIT { .display = NULL, .wake_fd = {-1, -1}, .mutex = PTHREAD_MUTEX_INITIALIZER, .state = POWER_ACTIVE }
+
+int power_start(Power *pw, int idle_s, Power_Changed changed, void *user);
+void power_stop(Power *pw);
+void power_set_idle(Power *pw, int idle_s);
+Power_State power_state(Power *pw);
+const char *power_state_name(Power_State state);
+
+#endif // ANIMX_POWER_H
@@ -0,0 +1,49 @@
+#ifndef ANIMX_PRESENT_H
+#define ANIMX_PRESENT_H
+
+#include <pthread.h>
+
+#include "AnimX-session.h"
+
+// Publishes the root pixmap for every pipeline at once. Pipelines draw
+// their frames into the root pixmap and report the area they touched;
+// the presenter collects those areas and does a single root update per
+// refresh period of the fastest monitor, however many outputs changed.
+// It only wakes up while there is something to publish.
+
+// Areas redrawn separately per update. Past this the bounding box of all
+// of them is redrawn instead.
+#define PRESENT_MAX_RECTS 32
+
+typedef struct {
+        Display_Session *ds;
+        pthread_t thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        int running;
+        int stop;
+        int dirty;
+        XRectangle rects[PRESENT_MAX_RECTS]; // Damage since the last update
+        int num_rects;          // -1 once `rects` overflowed
+        int x1, y1, x2, y2;     // Bounding box of the damage since the last update
+        long last_update_us;
+        unsigned long updates;  // Root updates done
+        unsigned long damages;  // Areas reported by pipelines
+} Presenter;
+
+#define PRESENTER_INIT { .ds = NULL, .mutex = PTHREAD_MUTEX_INITIALIZER, .running = 0 }
+
+int presenter_start(Presenter *pr, Display_Session *ds);
+
+// Publishes whatever is still pending and stops the thread.
+void presenter_stop(Presenter *pr);
+
+// Marks an area of the root pixmap as changed. Only takes the
+// presenter's own lock, so it may be called with `ds->lock` held.
+void presenter_damage(Presenter *pr, int x, int y, int width, int height);
+
+// Without a running presenter, publishes the pending damage right away.
+// Must not be called with `ds->lock` held.
+void presenter_flush(Presenter *pr, Display_Session *ds);
+
+#endif // ANIMX_PRESENT_H
@@ -0,0 +1,88 @@
+#ifndef ANIMX_SESSION_H
+#define ANIMX_SESSION_H
+
+#include <pthread.h>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+// How frames reach the screen. Either way every pipeline draws into
+// `root_pixmap`, the backend only decides what is shown from it.
+typedef enum {
+        BACKEND_ROOT,   // Root background, republished with every update
+        BACKEND_WINDOW, // A desktop window per monitor, see session_set_backend()
+} Backend_Type;
+
+// Override-redirect window of type _NET_WM_WINDOW_TYPE_DESKTOP below
+// everything else. Its background is a pixmap of its own, updated from
+// the root pixmap where there is damage.
+typedef struct {
+        Window window;
+        Pixmap pixmap;
+        int x, y, width, height;
+} Desktop_Window;
+
+// X-side state that outlives a single wallpaper. The daemon owns one
+// of these for its whole lifetime and every worker borrows it, so a
+// wallpaper switch only rebuilds the media-specific parts of a Context.
+typedef struct {
+        Display *display;
+        int screen;
+        Window root;
+        Visual *visual;
+        int depth;
+        XRRScreenResources *screen_res;
+        XRROutputInfo **output_infos; // Connected outputs with a valid CRTC
+        XRRCrtcInfo **crtc_infos; // Matching CRTCs for `output_infos`
+        int *monitor_outputs; // Index into `screen_res->outputs` for each monitor
+        int num_monitors; // Number of connected monitors
+        long root_width, root_height; // Size of the root window
+        long frame_period_us; // Refresh period of the fastest monitor
+        Pixmap root_pixmap; // Back buffer, every pipeline draws into this one
+        Pixmap front_pixmap; // Installed as the root background, swapped with `root_pixmap` on present
+        GC root_gc;
+        int has_present;    // The server has the Present extension, flips wait for vblank
+        unsigned present_serial;
+        Atom xrootpmap_id, esetroot_pmap_id;
+        Backend_Type backend;
+        Desktop_Window *desktops; // One per monitor with BACKEND_WINDOW
+        int num_desktops;
+        int root_published; // The root properties point at the current fallback frame
+        unsigned layout_gen; // Bumped every time the monitor layout is re-read
+        pthread_mutex_t lock; // Serializes X requests between workers
+} Display_Session;
+
+#define DISPLAY_SESSION_INIT { .display = NULL, .backend = BACKEND_ROOT, .lock = PTHREAD_MUTEX_INITIALIZER }
+
+// Opens the session if it is not open yet. Safe to call from
+// any worker; returns 0 when the session is usable.
+int init_display_session(Display_Session *ds);
+void cleanup_display_session(Display_Session *ds);
+
+// Re-reads outputs, CRTCs and the root size after a RandR change and
+// resizes the root pixmap if needed. Contexts notice the new
+// `layout_gen` and relayout themselves.
+int session_refresh(Display_Session *ds);
+unsigned session_layout_gen(Display_Session *ds);
+
+// Publishes what the pipelines drew and repaints the given areas of the
+// root window, or of the desktop windows. With the root backend the two
+// root pixmaps are swapped, so the screen never shows a half-drawn
+// frame. Every screen update goes through here, see AnimX-present.h.
+void session_present(Display_Session *ds, const XRectangle *rects, int num_rects);
+
+// The same with `ds->lock` already held, so the caller can collect the
+// damage under that lock and nothing is drawn between that and the flip.
+void session_present_locked(Display_Session *ds, const XRectangle *rects, int num_rects);
+
+// Switches between the root background and desktop windows. With
+// desktop windows a compositor only sees damage on those windows, and
+// the root properties are only set again once `root_published` is
+// cleared, i.e. when a pipeline settles on a new frame to fall back to.
+void session_set_backend(Display_Session *ds, Backend_Type backend);
+long session_frame_period_us(Display_Session *ds);
+
+// Maps a --mon output index to its monitor index, -1 if it has no CRTC.
+int session_monitor_of_output(Display_Session *ds, int output);
+
+#endif // ANIMX_SESSION_H
@@ -0,0 +1,43 @@
+#ifndef ANIMX_SINK_H
+#define ANIMX_SINK_H
+
+#include <stdint.h>
+
+// Where finished frames go. SINK_X11 is the normal case and is handled
+// by display_frame() itself; the others need no display at all, so the
+// decode and scale paths can be profiled and checked in a container.
+typedef enum {
+        SINK_X11,  // Root pixmap or desktop windows, see AnimX-session.h
+        SINK_NULL, // Frames are dropped as soon as they are done
+        SINK_DUMP, // Frames are written to a directory as PPM files
+} Sink_Type;
+
+typedef struct {
+        Sink_Type type;
+        int width, height;     // Output size without a display, 0 for the video size
+        char *dir;             // SINK_DUMP
+        unsigned long *select; // Frame numbers to write, sorted, every frame when NULL
+        int num_select;
+        int next_select;       // First entry of `select` not written yet
+        unsigned long frames;  // Frames handed to the sink so far
+        uint8_t *row;          // One RGB row of a SINK_DUMP file
+        size_t row_size;
+} Sink;
+
+#define SINK_INIT { .type = SINK_X11 }
+
+// Parses `x11`, `null` or `dump:<dir>[:<n>[,<n>...]]`, where the
+// numbers pick which frames (counted from 0) are written. Returns -1 on
+// a malformed spec.
+int sink_parse(Sink *sink, const char *spec);
+
+// Takes one tightly packed BGRA frame. Returns -1 if it could not be
+// written.
+int sink_frame(Sink *sink, const uint8_t *data, int width, int height);
+
+// True once a dump sink has written every frame it was asked for.
+int sink_done(const Sink *sink);
+
+void sink_cleanup(Sink *sink);
+
+#endif // ANIMX_SINK_H
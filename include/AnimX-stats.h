@@ -0,0 +1,75 @@
+#ifndef ANIMX_STATS_H
+#define ANIMX_STATS_H
+
+#include <stddef.h>
+
+// Where a frame spends its time on the way to the screen
+typedef enum {
+        STAGE_DEMUX,   // av_read_frame()
+        STAGE_DECODE,  // Sending a packet and receiving its frames
+        STAGE_SCALE,   // Converting a frame into the frame buffer
+        STAGE_UPLOAD,  // Blending, diffing and putting a frame into the root pixmap
+        STAGE_PRESENT, // One screen update by the presenter
+        NUM_STAGES,
+} Stats_Stage;
+
+typedef enum {
+        COUNT_PRESENTED,  // Frames put into the root pixmap
+        COUNT_DROPPED,    // Decoded and buffered, then thrown away (resync, relayout)
+        COUNT_LATE,       // Took longer than the frame period to show
+        COUNT_DUPLICATED, // Shown twice in a row, playback is faster than the frames
+        COUNT_DISCARDED,  // Decoded, but fell between two sampled frames
+        NUM_COUNTS,
+} Stats_Count;
+
+// Latencies are kept per stage in log-linear buckets, 16 per power of
+// two (so within about 6%), and updated with relaxed atomics from
+// whichever thread does the work. Nothing here ever blocks.
+void stats_record(Stats_Stage stage, long us);
+void stats_count(Stats_Count what, unsigned long n);
+
+typedef struct {
+        unsigned long count;
+        unsigned long total_us;
+        unsigned long p50_us, p95_us, p99_us, max_us;
+} Stats_Summary;
+
+void stats_summary(Stats_Stage stage, Stats_Summary *out);
+unsigned long stats_counter(Stats_Count what);
+const char *stats_stage_name(Stats_Stage stage);
+const char *stats_count_name(Stats_Count what);
+
+// Every AnimX thread calls this first thing. It names the thread (as
+// seen by top -H and ps -L) and registers it for the per-thread numbers
+// below; what it used is kept under its name once it exits. Threads map
+// onto stages: the producer demuxes and decodes, the consumer scales
+// and uploads, the presenter presents and a daemon worker does all of
+// it for load mode. Names are cut at 15 characters; the main thread is
+// only registered, it keeps the process name.
+void stats_thread_start(const char *name);
+
+#define STATS_MAX_THREADS 64
+
+// CPU time, context switches and page faults of all threads of one
+// name, the live ones read from /proc/self/task
+typedef struct {
+        char name[16];
+        int live;                 // Threads of this name still running
+        unsigned long user_us, system_us;
+        unsigned long vcsw, ivcsw; // Voluntary and involuntary context switches
+        unsigned long minflt, majflt;
+} Stats_Thread;
+
+// Fills at most `max` entries, one per thread name. Returns how many.
+int stats_threads(Stats_Thread *out, int max);
+
+// Logs stats_threads() every `seconds` from a thread of its own.
+int stats_threads_log_start(int seconds);
+void stats_threads_log_stop(void);
+
+// Writes `key=value` lines: count, p50, p95, p99 and max per stage,
+// the counters and the per-thread numbers. Returns what snprintf() would.
+int stats_format(char *buf, size_t len);
+void stats_reset(void);
+
+#endif // ANIMX_STATS_H
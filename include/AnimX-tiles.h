@@ -0,0 +1,24 @@
+#ifndef ANIMX_TILES_H
+#define ANIMX_TILES_H
+
+#include <stdint.h>
+
+#include <X11/Xlib.h>
+
+#include "AnimX-context.h"
+
+// Frames are compared in square tiles of this many pixels, so only the
+// parts of a wallpaper that actually move are uploaded and redrawn.
+#define TILE_SIZE 64
+
+// Sets one byte of `mask` per tile of every surface (`ctx->num_tiles` in
+// all) to whether that tile differs between the two frame buffers.
+// Returns the number of changed tiles.
+int tiles_diff(const Context *ctx, const uint8_t *prev, const uint8_t *cur, uint8_t *mask);
+
+// Turns the changed tiles of surface `s` into as few rectangles as rows
+// and columns allow, in surface coordinates. `rects` needs room for one
+// rectangle per tile of the surface. Returns the number of rectangles.
+int tiles_rects(const Context *ctx, int s, const uint8_t *mask, XRectangle *rects);
+
+#endif // ANIMX_TILES_H
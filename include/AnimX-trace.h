@@ -0,0 +1,55 @@
+#ifndef ANIMX_TRACE_H
+#define ANIMX_TRACE_H
+
+#include <stdatomic.h>
+
+#include "AnimX-utils.h"
+
+// What a thread was doing between two points in time. Every one of
+// these ends up as a complete ("X") event in a Chrome trace, which
+// Perfetto and chrome://tracing both load.
+typedef enum {
+        TRACE_DEMUX,
+        TRACE_DECODE,
+        TRACE_SCALE,
+        TRACE_RING_WAIT, // Producer waiting for room, consumer waiting for a frame
+        TRACE_UPLOAD,
+        TRACE_PRESENT,
+        TRACE_SLEEP,     // Waiting for the next frame to be due
+        TRACE_SEEK,      // Looping back to the start of the video
+        TRACE_WORKER,    // A daemon worker from start to retirement
+        NUM_TRACE_EVENTS,
+} Trace_Event;
+
+// Set once by trace_open() before any other thread starts. When it is
+// 0 the helpers below cost a load and a branch.
+extern atomic_int g_tracing;
+
+static inline long trace_start(void) {
+        return atomic_load_explicit(&g_tracing, memory_order_relaxed) ? get_time_us() : 0;
+}
+
+// Records `ev` from `start_us` (from trace_start()) until now in a ring
+// buffer owned by the calling thread. `arg` ends up in the event's args.
+void trace_record(Trace_Event ev, long start_us, long end_us, long arg);
+
+static inline void trace_end(Trace_Event ev, long start_us, long arg) {
+        if (atomic_load_explicit(&g_tracing, memory_order_relaxed)) trace_record(ev, start_us, get_time_us(), arg);
+}
+
+// Names the calling thread in the trace, a no-op when not tracing.
+void trace_thread_name(const char *name);
+
+// Creates `path` and starts tracing. Each thread keeps its newest
+// TRACE_RING_EVENTS events, everything is written out by trace_close().
+// Of threads that already exited only the last TRACE_MAX_RETIRED are
+// kept, so a daemon changing wallpapers for hours stays bounded.
+int trace_open(const char *path);
+#define TRACE_RING_EVENTS 16384
+#define TRACE_MAX_RETIRED 16
+
+// Writes the trace and stops tracing. Threads that are still running
+// may lose the event they are recording at that moment.
+void trace_close(void);
+
+#endif // ANIMX_TRACE_H
@@ -0,0 +1,67 @@
+#ifndef ANIMX_UPLOAD_H
+#define ANIMX_UPLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <X11/Xlib.h>
+
+#include "config.h"
+#ifdef HAVE_XCB_SHM
+#include <xcb/xcb.h>
+#endif
+
+#include "AnimX-session.h"
+
+// Frames are rendered into a small ring of buffers and uploaded from
+// there. With XCB and MIT-SHM (a local server) the buffers are shared
+// memory segments: puts are pipelined without the pixels going through
+// the socket and without waiting on the server, and their errors are
+// collected only when a buffer comes round again, which is also the
+// only time the server is waited for. Otherwise plain XPutImage is used.
+#define UPLOAD_SLOTS 3
+
+typedef enum {
+        UPLOAD_XLIB,
+        UPLOAD_XCB_SHM,
+} Upload_Kind;
+
+typedef struct {
+        uint8_t *data;
+#ifdef HAVE_XCB_SHM
+        int shmid;
+        uint32_t shmseg;
+        xcb_void_cookie_t *cookies; // Puts reading `data`, checked on recycle
+        int num_cookies, cap_cookies;
+#endif
+} Upload_Slot;
+
+typedef struct {
+        Upload_Kind kind;
+        int probed;    // `kind` has been chosen
+        Upload_Slot slots[UPLOAD_SLOTS];
+        size_t size;   // Of every slot, 0 until the first frame
+        int current;   // Slot handed out by the last upload_acquire()
+#ifdef HAVE_XCB_SHM
+        xcb_connection_t *conn; // Xlib's own connection
+#endif
+        unsigned long errors; // Puts the server rejected
+} Uploader;
+
+// Returns a buffer of `size` bytes to render the next frame into. The
+// buffer handed out before it is left alone, so it can still be
+// compared against. May wait for the server to finish reading a shared
+// buffer. NULL on failure.
+uint8_t *upload_acquire(Uploader *up, Display_Session *ds, size_t size);
+
+// Puts the `src` part of a `width`x`height` image, found `offset` bytes
+// into the acquired buffer, onto `drawable` at `dst_x`, `dst_y`. Does
+// not flush. Expects `ds->lock` held.
+int upload_put(Uploader *up, Display_Session *ds, Drawable drawable, GC gc, size_t offset,
+               int width, int height, const XRectangle *src, int dst_x, int dst_y);
+
+const char *upload_kind_name(const Uploader *up);
+
+void upload_cleanup(Uploader *up, Display_Session *ds);
+
+#endif // ANIMX_UPLOAD_H
@@ -3,6 +3,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
 
 #define err_wargs(msg, ...)                                             \
         do {                                                            \
@@ -19,4 +21,9 @@
 int str_isdigit(const char *s);
 char *resolve(const char *fp);
 
+// Monotonic clock helpers shared by every timed wait
+long get_time_us(void);
+struct timespec us_to_timespec(long us);
+void init_monotonic_cond(pthread_cond_t *cond);
+
 #endif // ANIMX_UTILS_H
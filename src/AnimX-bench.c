@@ -0,0 +1,207 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "AnimX-bench.h"
+#include "AnimX-stats.h"
+#include "AnimX-utils.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+// Bytes the allocator has handed out and not got back, mmap'd blocks
+// included. Only read around the run, so --bench costs nothing to the
+// rest of the program.
+#define HEAP_MEASURED 1
+static unsigned long heap_in_use(void) {
+#ifdef HAVE_MALLINFO2
+        struct mallinfo2 mi = mallinfo2();
+#else
+        struct mallinfo mi = mallinfo(); // Wraps past 4 GB
+#endif
+        return (unsigned long)mi.uordblks + (unsigned long)mi.hblkhd;
+}
+#else
+#define HEAP_MEASURED 0
+#define heap_in_use() 0UL
+#endif
+
+static const struct {
+        const char *name;
+        Bench_Stage stage;
+} stage_names[] = {
+        { "demux", BENCH_DEMUX },
+        { "decode", BENCH_DECODE },
+        { "scale", BENCH_SCALE },
+        { "present", BENCH_PRESENT },
+};
+
+#define NUM_STAGE_NAMES (sizeof(stage_names) / sizeof(*stage_names))
+
+int bench_parse_stages(const char *list, unsigned *stages) {
+        unsigned out = 0;
+        const char *p = list;
+        while (*p) {
+                size_t len = strcspn(p, ",");
+                size_t i;
+                for (i = 0; i < NUM_STAGE_NAMES; i++) {
+                        if (strlen(stage_names[i].name) == len && !strncmp(p, stage_names[i].name, len)) {
+                                out |= stage_names[i].stage;
+                                break;
+                        }
+                }
+                if (i == NUM_STAGE_NAMES) {
+                        return -1;
+                }
+                p += len;
+                if (*p == ',') p++;
+        }
+        if (!out || ((out & BENCH_DECODE) && !(out & BENCH_DEMUX))) {
+                return -1;
+        }
+        *stages = out;
+        return 0;
+}
+
+void bench_begin(Bench_Result *res) {
+        stats_reset();
+        res->frames = 0;
+        res->heap_start = heap_in_use();
+        getrusage(RUSAGE_SELF, &res->usage_start);
+        res->start_us = get_time_us();
+}
+
+void bench_frame_done(Bench_Result *res, long start_us) {
+        if (res->frames++ == 0) {
+                res->startup_us = get_time_us() - res->launch_us;
+        } else {
+                long interval = start_us - res->last_start_us;
+                res->interval_sum += (double)interval;
+                res->interval_sq += (double)interval * (double)interval;
+                if (interval > res->interval_max) res->interval_max = interval;
+        }
+        res->last_start_us = start_us;
+}
+
+void bench_end(Bench_Result *res) {
+        res->wall_us = get_time_us() - res->start_us;
+        getrusage(RUSAGE_SELF, &res->usage_end);
+        res->heap_end = heap_in_use();
+}
+
+FILE *bench_report_stream(void) {
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        if (fd < 0) {
+                return NULL;
+        }
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        return fdopen(fd, "w");
+}
+
+static void json_string(FILE *out, const char *s) {
+        fputc('"', out);
+        for (; *s; s++) {
+                unsigned char c = (unsigned char)*s;
+                if (c == '"' || c == '\\') {
+                        fprintf(out, "\\%c", c);
+                } else if (c < 0x20) {
+                        fprintf(out, "\\u%04x", c);
+                } else {
+                        fputc(c, out);
+                }
+        }
+        fputc('"', out);
+}
+
+static double timeval_s(const struct timeval *a, const struct timeval *b) {
+        return (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_usec - a->tv_usec) / 1e6;
+}
+
+void bench_report(FILE *out, const Bench_Options *opts, const Bench_Result *res) {
+        double wall_s = (double)res->wall_us / 1e6;
+        double user_s = timeval_s(&res->usage_start.ru_utime, &res->usage_end.ru_utime);
+        double system_s = timeval_s(&res->usage_start.ru_stime, &res->usage_end.ru_stime);
+        long heap_growth = (long)res->heap_end - (long)res->heap_start;
+
+        fprintf(out, "{\n  \"file\": ");
+        json_string(out, opts->file);
+        fprintf(out, ",\n  \"stages\": [");
+        int first = 1;
+        for (size_t i = 0; i < NUM_STAGE_NAMES; i++) {
+                if (!(opts->stages & stage_names[i].stage)) continue;
+                fprintf(out, "%s\"%s\"", first ? "" : ", ", stage_names[i].name);
+                first = 0;
+        }
+        fprintf(out, "],\n");
+        fprintf(out, "  \"target_fps\": %d,\n", opts->fps);
+        fprintf(out, "  \"width\": %d,\n", res->width);
+        fprintf(out, "  \"height\": %d,\n", res->height);
+        fprintf(out, "  \"seconds\": %.3f,\n", wall_s);
+        fprintf(out, "  \"frames\": %lu,\n", res->frames);
+        fprintf(out, "  \"fps\": %.2f,\n", wall_s > 0 ? (double)res->frames / wall_s : 0.0);
+        fprintf(out, "  \"startup_ms\": %.1f,\n", (double)res->startup_us / 1e3);
+        // Standard deviation of the time between frame starts
+        double n = res->frames > 1 ? (double)(res->frames - 1) : 0.0;
+        double mean = n > 0 ? res->interval_sum / n : 0.0;
+        double var = n > 0 ? res->interval_sq / n - mean * mean : 0.0;
+        fprintf(out, "  \"interval_mean_us\": %.1f,\n", mean);
+        fprintf(out, "  \"jitter_us\": %.1f,\n", var > 0 ? sqrt(var) : 0.0);
+        fprintf(out, "  \"interval_max_us\": %ld,\n", res->interval_max);
+        fprintf(out, "  \"cpu_user_s\": %.3f,\n", user_s);
+        fprintf(out, "  \"cpu_system_s\": %.3f,\n", system_s);
+        fprintf(out, "  \"cpu_utilization\": %.3f,\n", wall_s > 0 ? (user_s + system_s) / wall_s : 0.0);
+        fprintf(out, "  \"peak_rss_kb\": %ld,\n", res->usage_end.ru_maxrss);
+        if (HEAP_MEASURED) {
+                fprintf(out, "  \"heap_bytes\": %lu,\n", res->heap_end);
+                fprintf(out, "  \"heap_growth_bytes\": %ld,\n", heap_growth);
+                fprintf(out, "  \"heap_growth_per_frame\": %.1f,\n",
+                        res->frames ? (double)heap_growth / (double)res->frames : 0.0);
+        } else {
+                fprintf(out, "  \"heap_bytes\": null,\n");
+                fprintf(out, "  \"heap_growth_bytes\": null,\n");
+                fprintf(out, "  \"heap_growth_per_frame\": null,\n");
+        }
+
+        fprintf(out, "  \"stages_us\": {\n");
+        for (int s = 0; s < NUM_STAGES; s++) {
+                Stats_Summary sum;
+                stats_summary((Stats_Stage)s, &sum);
+                fprintf(out, "    \"%s\": {\"count\": %lu, \"mean\": %.1f, \"p50\": %lu, \"p95\": %lu, \"p99\": %lu, \"max\": %lu}%s\n",
+                        stats_stage_name((Stats_Stage)s), sum.count,
+                        sum.count ? (double)sum.total_us / (double)sum.count : 0.0,
+                        sum.p50_us, sum.p95_us, sum.p99_us, sum.max_us,
+                        s + 1 < NUM_STAGES ? "," : "");
+        }
+        fprintf(out, "  },\n");
+
+        fprintf(out, "  \"counters\": {");
+        for (int c = 0; c < NUM_COUNTS; c++) {
+                fprintf(out, "%s\"%s\": %lu", c ? ", " : "", stats_count_name((Stats_Count)c),
+                        stats_counter((Stats_Count)c));
+        }
+        fprintf(out, "}\n}\n");
+        fflush(out);
+}
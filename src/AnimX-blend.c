@@ -0,0 +1,86 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "AnimX-blend.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Every channel is computed as (a*alpha + b*(256-alpha)) >> 8, which
+// never exceeds 255*256 and so fits in an unsigned 16-bit lane.
+
+#if defined(__AVX2__)
+static size_t blend_bgra_simd(uint8_t *dst, const uint8_t *a, const uint8_t *b, int alpha, size_t n) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i wa = _mm256_set1_epi16((short)alpha);
+        const __m256i wb = _mm256_set1_epi16((short)(256 - alpha));
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+                __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+                __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+                __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), wa),
+                                              _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), wb));
+                __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), wa),
+                                              _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), wb));
+                lo = _mm256_srli_epi16(lo, 8);
+                hi = _mm256_srli_epi16(hi, 8);
+                _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+        }
+        return i;
+}
+#elif defined(__SSE2__)
+static size_t blend_bgra_simd(uint8_t *dst, const uint8_t *a, const uint8_t *b, int alpha, size_t n) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i wa = _mm_set1_epi16((short)alpha);
+        const __m128i wb = _mm_set1_epi16((short)(256 - alpha));
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+                __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+                __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+                __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                           _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+                __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                           _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+                lo = _mm_srli_epi16(lo, 8);
+                hi = _mm_srli_epi16(hi, 8);
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+        }
+        return i;
+}
+#else
+static size_t blend_bgra_simd(uint8_t *dst, const uint8_t *a, const uint8_t *b, int alpha, size_t n) {
+        (void)dst; (void)a; (void)b; (void)alpha; (void)n;
+        return 0;
+}
+#endif
+
+void blend_bgra(uint8_t *dst, const uint8_t *a, const uint8_t *b, int alpha, size_t n) {
+        if (alpha < 0) alpha = 0;
+        if (alpha > 256) alpha = 256;
+
+        size_t i = blend_bgra_simd(dst, a, b, alpha, n);
+
+        // Scalar tail
+        for (; i < n; ++i) {
+                dst[i] = (uint8_t)((a[i] * alpha + b[i] * (256 - alpha)) >> 8);
+        }
+}
@@ -20,11 +20,18 @@
 #include <string.h>
 #include <errno.h>
 #include <syslog.h>
+#include <stdlib.h>
+#include <limits.h>
 
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 
 #include "AnimX-context.h"
+#include "AnimX-tiles.h"
+#include "AnimX-stats.h"
+#include "AnimX-trace.h"
+#include "AnimX-utils.h"
 #include "AnimX-gl.h"
 
 static AVCodec *find_codec_decoder(
@@ -91,273 +98,477 @@ static AVFormatContext *create_avformat_ctx(const char *video_fp) {
         return fmt_ctx;
 }
 
-int init_context(Context *ctx, int monitor_index, const char *video_mp4) {
-        avformat_network_init();
-        ctx->fmt_ctx = create_avformat_ctx(video_mp4);
-        if (!ctx->fmt_ctx) {
-                syslog(LOG_ERR, "ctx->fmt_ctx");
+static int layout_single_monitor(Context *ctx, Display_Session *ds, int monitor_index) {
+        int num_outputs = ds->screen_res->noutput;
+        if (monitor_index >= num_outputs) {
+                fprintf(stderr, "Monitor index %d out of range (0-%d)\n", monitor_index, num_outputs - 1);
                 return -1;
         }
-        ctx->video_stream_idx = get_video_stream_index(ctx->fmt_ctx);
-        if (ctx->video_stream_idx == -1) {
-                syslog(LOG_ERR, "ctx->video_stream_idx");
+        XRROutputInfo *output_info = XRRGetOutputInfo(ds->display, ds->screen_res, ds->screen_res->outputs[monitor_index]);
+        if (!output_info || output_info->connection != RR_Connected) {
+                fprintf(stderr, "Monitor %d is not connected\n", monitor_index);
+                if (output_info) XRRFreeOutputInfo(output_info);
                 return -1;
         }
-        if (!find_codec_decoder(ctx->fmt_ctx, ctx->video_stream_idx, &ctx->codec_ctx, &ctx->codec_par)) {
-                syslog(LOG_ERR, "find_codec_decoder()");
+        XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(ds->display, ds->screen_res, output_info->crtc);
+        if (!crtc_info || crtc_info->width <= 0 || crtc_info->height <= 0) {
+                fprintf(stderr, "Failed to get valid CRTC info for monitor %d\n", monitor_index);
+                if (crtc_info) XRRFreeCrtcInfo(crtc_info);
+                XRRFreeOutputInfo(output_info);
                 return -1;
         }
+        ctx->num_monitors = 1;
+        ctx->monitor_x = crtc_info->x;
+        ctx->monitor_y = crtc_info->y;
+        ctx->monitor_width = crtc_info->width;
+        ctx->monitor_height = crtc_info->height;
+        XRRFreeCrtcInfo(crtc_info);
+        XRRFreeOutputInfo(output_info);
+        printf("Monitor %d: %ldx%ld at (%ld,%ld)\n", monitor_index, ctx->monitor_width, ctx->monitor_height, ctx->monitor_x, ctx->monitor_y);
+        return 0;
+}
 
-        ctx->display = XOpenDisplay(NULL);
-        if (!ctx->display) {
-                syslog(LOG_ERR, "Cannot open X display\n");
-                fprintf(stderr, "Cannot open X display\n");
-                return -1;
-        }
+static int layout_combined_monitors(Context *ctx, Display_Session *ds) {
+        long min_x = LONG_MAX, min_y = LONG_MAX;
+        long max_x = LONG_MIN, max_y = LONG_MIN;
 
-        ctx->screen = DefaultScreen(ctx->display);
-        ctx->root = RootWindow(ctx->display, ctx->screen);
-        ctx->visual = DefaultVisual(ctx->display, ctx->screen);
-        ctx->depth = DefaultDepth(ctx->display, ctx->screen);
+        for (int i = 0; i < ds->num_monitors; i++) {
+                XRRCrtcInfo *crtc_info = ds->crtc_infos[i];
+                if (crtc_info->x < min_x) min_x = crtc_info->x;
+                if (crtc_info->y < min_y) min_y = crtc_info->y;
+                if ((long)crtc_info->x + crtc_info->width > max_x) max_x = (long)crtc_info->x + crtc_info->width;
+                if ((long)crtc_info->y + crtc_info->height > max_y) max_y = (long)crtc_info->y + crtc_info->height;
+        }
 
-        ctx->screen_res = XRRGetScreenResources(ctx->display, ctx->root);
-        if (!ctx->screen_res) {
-                syslog(LOG_ERR, "Failed to get screen resources\n");
-                fprintf(stderr, "Failed to get screen resources\n");
+        // Combine all monitors into a single virtual monitor
+        long width = max_x - min_x;
+        long height = max_y - min_y;
+        if (width <= 0 || height <= 0 || width > INT_MAX || height > INT_MAX) {
+                fprintf(stderr, "Invalid combined monitor dimensions: %ldx%ld\n", width, height);
                 return -1;
         }
+        ctx->num_monitors = ds->num_monitors;
+        ctx->monitor_x = min_x;
+        ctx->monitor_y = min_y;
+        ctx->monitor_width = width;
+        ctx->monitor_height = height;
+        printf("Combined monitors: %ldx%ld at (%ld,%ld)\n", ctx->monitor_width, ctx->monitor_height, ctx->monitor_x, ctx->monitor_y);
+        return 0;
+}
 
-        // Initialize monitor configurations
-        int num_outputs = ctx->screen_res->noutput;
-        int connected_count = 0;
+static int layout_mirrored_monitors(Context *ctx, Display_Session *ds) {
+        ctx->num_monitors = ds->num_monitors;
+        ctx->mirror_mode = 1;
+        ctx->surfaces = (Surface *)calloc(ds->num_monitors, sizeof(Surface));
+        if (!ctx->surfaces) {
+                syslog(LOG_ERR, "Failed to allocate monitor info arrays\n");
+                fprintf(stderr, "Failed to allocate monitor info arrays\n");
+                return -1;
+        }
 
-        // First pass: count connected monitors with valid CRTCs
-        for (int i = 0; i < num_outputs; i++) {
-                XRROutputInfo *output_info = XRRGetOutputInfo(ctx->display, ctx->screen_res, ctx->screen_res->outputs[i]);
-                if (output_info && output_info->connection == RR_Connected && output_info->crtc) {
-                        XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(ctx->display, ctx->screen_res, output_info->crtc);
-                        if (crtc_info && crtc_info->width > 0 && crtc_info->height > 0) {
-                                connected_count++;
+        // Monitors of the same resolution share a surface, so each
+        // resolution is scaled and uploaded once per frame
+        for (int i = 0; i < ds->num_monitors; i++) {
+                XRRCrtcInfo *crtc_info = ds->crtc_infos[i];
+                Surface *sf = NULL;
+                for (int j = 0; j < ctx->num_surfaces; j++) {
+                        if (ctx->surfaces[j].width == (int)crtc_info->width && ctx->surfaces[j].height == (int)crtc_info->height) {
+                                sf = &ctx->surfaces[j];
+                                break;
                         }
-                        if (crtc_info) XRRFreeCrtcInfo(crtc_info);
                 }
-                if (output_info) XRRFreeOutputInfo(output_info);
+                if (!sf) {
+                        sf = &ctx->surfaces[ctx->num_surfaces++];
+                        sf->width = crtc_info->width;
+                        sf->height = crtc_info->height;
+                        sf->x = crtc_info->x;
+                        sf->y = crtc_info->y;
+                        sf->monitors = (int *)calloc(ds->num_monitors, sizeof(int));
+                        sf->pixmap = XCreatePixmap(ds->display, ds->root, sf->width, sf->height, ds->depth);
+                        sf->gc = sf->pixmap ? XCreateGC(ds->display, sf->pixmap, 0, NULL) : NULL;
+                        if (!sf->monitors || !sf->pixmap || !sf->gc) {
+                                fprintf(stderr, "Failed to create pixmap or GC for %dx%d monitors\n", sf->width, sf->height);
+                                return -1;
+                        }
+                }
+                sf->monitors[sf->num_monitors++] = i;
         }
 
-        if (connected_count == 0) {
-                syslog(LOG_ERR, "No connected monitors with valid CRTCs found\n");
-                fprintf(stderr, "No connected monitors with valid CRTCs found\n");
+        ctx->monitor_x = ctx->surfaces[0].x;
+        ctx->monitor_y = ctx->surfaces[0].y;
+        ctx->monitor_width = ctx->surfaces[0].width;
+        ctx->monitor_height = ctx->surfaces[0].height;
+        printf("Mirroring on all %d monitors with %d distinct resolution(s)\n", ctx->num_monitors, ctx->num_surfaces);
+        return 0;
+}
+
+// The single surface of single and combined mode
+static int layout_single_surface(Context *ctx) {
+        ctx->surfaces = (Surface *)calloc(1, sizeof(Surface));
+        if (!ctx->surfaces) {
+                fprintf(stderr, "Failed to allocate surface\n");
                 return -1;
         }
+        ctx->num_surfaces = 1;
+        ctx->surfaces[0].width = (int)ctx->monitor_width;
+        ctx->surfaces[0].height = (int)ctx->monitor_height;
+        ctx->surfaces[0].x = ctx->monitor_x;
+        ctx->surfaces[0].y = ctx->monitor_y;
+        return 0;
+}
 
-        // Allocate arrays for all connected monitors
-        ctx->output_infos = (XRROutputInfo **)malloc(connected_count * sizeof(XRROutputInfo *));
-        ctx->crtc_infos = (XRRCrtcInfo **)malloc(connected_count * sizeof(XRRCrtcInfo *));
-        if (monitor_index == -2) {
-                ctx->monitor_pixmaps = (Pixmap *)malloc(connected_count * sizeof(Pixmap));
-                ctx->monitor_gcs = (GC *)malloc(connected_count * sizeof(GC));
-        }
-        if (!ctx->output_infos || !ctx->crtc_infos || (monitor_index == -2 && (!ctx->monitor_pixmaps || !ctx->monitor_gcs))) {
-                syslog(LOG_ERR, "Failed to allocate monitor info arrays\n");
-                fprintf(stderr, "Failed to allocate monitor info arrays\n");
-                if (ctx->output_infos) free(ctx->output_infos);
-                if (ctx->crtc_infos) free(ctx->crtc_infos);
-                if (ctx->monitor_pixmaps) free(ctx->monitor_pixmaps);
-                if (ctx->monitor_gcs) free(ctx->monitor_gcs);
+// Decoded frames can be cropped by moving their plane pointers, except
+// for bitstream and hardware formats.
+static int can_crop_frames(Context *ctx) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(ctx->codec_ctx->pix_fmt);
+        return desc && !(desc->flags & (AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL));
+}
+
+// Combined mode surfaces: one per CRTC at its place in the bounding box.
+// A CRTC that lies within another one (a clone) adds nothing.
+static int layout_combined_surfaces(Context *ctx, Display_Session *ds) {
+        ctx->surfaces = (Surface *)calloc(ds->num_monitors, sizeof(Surface));
+        if (!ctx->surfaces) {
+                fprintf(stderr, "Failed to allocate surfaces\n");
                 return -1;
         }
-        ctx->num_monitors = connected_count;
-        ctx->mirror_mode = (monitor_index == -2);
+        for (int i = 0; i < ds->num_monitors; i++) {
+                XRRCrtcInfo *c = ds->crtc_infos[i];
+                int covered = 0;
+                for (int j = 0; j < ds->num_monitors && !covered; j++) {
+                        XRRCrtcInfo *o = ds->crtc_infos[j];
+                        int same = c->x == o->x && c->y == o->y && c->width == o->width && c->height == o->height;
+                        covered = j != i && (!same || j < i)
+                                && c->x >= o->x && c->y >= o->y
+                                && (long)c->x + c->width <= (long)o->x + o->width
+                                && (long)c->y + c->height <= (long)o->y + o->height;
+                }
+                if (covered) continue;
+                Surface *sf = &ctx->surfaces[ctx->num_surfaces++];
+                sf->width = c->width;
+                sf->height = c->height;
+                sf->x = c->x;
+                sf->y = c->y;
+                sf->cropped = 1;
+        }
+        printf("Combined monitors: converting %d of %d monitor area(s)\n", ctx->num_surfaces, ds->num_monitors);
+        return 0;
+}
 
-        // Second pass: collect connected monitor info
-        int idx = 0;
-        long min_x = LONG_MAX, min_y = LONG_MAX;
-        long max_x = LONG_MIN, max_y = LONG_MIN;
+// Expects `ds->lock` to be held.
+static void free_surfaces(Context *ctx) {
+        Display *display = ctx->ds ? ctx->ds->display : NULL;
+        for (int i = 0; i < ctx->num_surfaces; i++) {
+                Surface *sf = &ctx->surfaces[i];
+                if (display && sf->gc) XFreeGC(display, sf->gc);
+                if (display && sf->pixmap) XFreePixmap(display, sf->pixmap);
+                if (sf->sws_ctx) sws_freeContext(sf->sws_ctx);
+                free(sf->monitors);
+        }
+        free(ctx->surfaces);
+        ctx->surfaces = NULL;
+        ctx->num_surfaces = 0;
+        ctx->num_monitors = 0;
+        ctx->mirror_mode = 0;
+}
 
-        for (int i = 0; i < num_outputs && idx < connected_count; i++) {
-                XRROutputInfo *output_info = XRRGetOutputInfo(ctx->display, ctx->screen_res, ctx->screen_res->outputs[i]);
-                if (output_info && output_info->connection == RR_Connected && output_info->crtc) {
-                        XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(ctx->display, ctx->screen_res, output_info->crtc);
-                        if (crtc_info && crtc_info->width > 0 && crtc_info->height > 0) {
-                                ctx->output_infos[idx] = output_info;
-                                ctx->crtc_infos[idx] = crtc_info;
-                                printf("Monitor %d: %dx%d at (%ld,%ld)\n", idx, crtc_info->width, crtc_info->height, (long)crtc_info->x, (long)crtc_info->y);
-                                // Update bounding rectangle for combined mode
-                                if (monitor_index == -1) {
-                                        if (crtc_info->x < min_x) min_x = crtc_info->x;
-                                        if (crtc_info->y < min_y) min_y = crtc_info->y;
-                                        if ((long)crtc_info->x + crtc_info->width > max_x) max_x = (long)crtc_info->x + crtc_info->width;
-                                        if ((long)crtc_info->y + crtc_info->height > max_y) max_y = (long)crtc_info->y + crtc_info->height;
-                                }
-                                idx++;
-                        } else {
-                                if (crtc_info) XRRFreeCrtcInfo(crtc_info);
-                                if (output_info) XRRFreeOutputInfo(output_info);
-                        }
-                } else if (output_info) {
-                        XRRFreeOutputInfo(output_info);
-                }
+static int layout_context(Context *ctx) {
+        Display_Session *ds = ctx->ds;
+        pthread_mutex_lock(&ds->lock);
+        free_surfaces(ctx);
+        int layout;
+        if (ds->num_monitors == 0) {
+                fprintf(stderr, "No monitors to lay out on\n");
+                layout = -1;
+        } else if (ctx->monitor_index == -2) {
+                layout = layout_mirrored_monitors(ctx, ds);
+        } else if (ctx->monitor_index == -1) {
+                layout = layout_combined_monitors(ctx, ds);
+        } else {
+                layout = layout_single_monitor(ctx, ds, ctx->monitor_index);
         }
+        if (layout == 0 && ctx->monitor_index == -1 && can_crop_frames(ctx)) {
+                layout = layout_combined_surfaces(ctx, ds);
+        } else if (layout == 0 && !ctx->mirror_mode) {
+                layout = layout_single_surface(ctx);
+        }
+        ctx->layout_gen = ds->layout_gen;
+        pthread_mutex_unlock(&ds->lock);
+        return layout;
+}
 
-        if (idx == 0) {
-                fprintf(stderr, "No valid CRTCs found for connected monitors\n");
-                free(ctx->output_infos);
-                free(ctx->crtc_infos);
-                if (ctx->monitor_pixmaps) free(ctx->monitor_pixmaps);
-                if (ctx->monitor_gcs) free(ctx->monitor_gcs);
+// Maps a cropped surface back onto the video, keeping the bounding box
+// mapping of combined mode. The crop starts on a whole chroma sample so
+// every plane can be offset exactly.
+static void crop_source(Context *ctx, Surface *sf) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(ctx->codec_ctx->pix_fmt);
+        long vw = ctx->codec_ctx->width, vh = ctx->codec_ctx->height;
+        long rx = sf->x - ctx->monitor_x, ry = sf->y - ctx->monitor_y;
+        long left = rx * vw / ctx->monitor_width;
+        long top = ry * vh / ctx->monitor_height;
+        long right = ((rx + sf->width) * vw + ctx->monitor_width - 1) / ctx->monitor_width;
+        long bottom = ((ry + sf->height) * vh + ctx->monitor_height - 1) / ctx->monitor_height;
+        left &= ~((1L << desc->log2_chroma_w) - 1);
+        top &= ~((1L << desc->log2_chroma_h) - 1);
+        if (right > vw) right = vw;
+        if (bottom > vh) bottom = vh;
+        if (right <= left) right = left + 1;
+        if (bottom <= top) bottom = top + 1;
+        sf->src_x = (int)left;
+        sf->src_y = (int)top;
+        sf->src_width = (int)(right - left);
+        sf->src_height = (int)(bottom - top);
+}
+
+static int create_surface_scaler(Context *ctx, Surface *sf) {
+        int flags = ctx->quality & QUALITY_FAST_SCALER ? SWS_FAST_BILINEAR : CONTEXT_SWS_FLAGS;
+        if (sf->sws_ctx) sws_freeContext(sf->sws_ctx);
+        sf->sws_ctx = sws_getContext(sf->src_width, sf->src_height, ctx->codec_ctx->pix_fmt,
+                                     sf->width, sf->height, AV_PIX_FMT_BGRA,
+                                     flags, NULL, NULL, NULL);
+        if (!sf->sws_ctx) {
+                fprintf(stderr, "Could not initialize swscale context\n");
                 return -1;
         }
+        return 0;
+}
 
-        if (monitor_index == -2) {
-                // Mirror mode: use first monitor's dimensions
-                int ref_idx = 0;
-                ctx->monitor_x = ctx->crtc_infos[ref_idx]->x;
-                ctx->monitor_y = ctx->crtc_infos[ref_idx]->y;
-                ctx->monitor_width = ctx->crtc_infos[ref_idx]->width;
-                ctx->monitor_height = ctx->crtc_infos[ref_idx]->height;
-                printf("Mirroring on all %d monitors using reference monitor %d: %ldx%ld at (%ld,%ld)\n",
-                       connected_count, ref_idx, ctx->monitor_width, ctx->monitor_height, ctx->monitor_x, ctx->monitor_y);
-
-                // Create pixmap and GC for each monitor
-                for (int i = 0; i < ctx->num_monitors; i++) {
-                        ctx->monitor_pixmaps[i] = XCreatePixmap(ctx->display, ctx->root, ctx->monitor_width, ctx->monitor_height, ctx->depth);
-                        ctx->monitor_gcs[i] = XCreateGC(ctx->display, ctx->monitor_pixmaps[i], 0, NULL);
-                        if (!ctx->monitor_pixmaps[i] || !ctx->monitor_gcs[i]) {
-                                fprintf(stderr, "Failed to create pixmap or GC for monitor %d\n", i);
-                                for (int j = 0; j < i; j++) {
-                                        if (ctx->monitor_gcs[j]) XFreeGC(ctx->display, ctx->monitor_gcs[j]);
-                                        if (ctx->monitor_pixmaps[j]) XFreePixmap(ctx->display, ctx->monitor_pixmaps[j]);
-                                }
-                                free(ctx->monitor_pixmaps);
-                                free(ctx->monitor_gcs);
-                                ctx->monitor_pixmaps = NULL;
-                                ctx->monitor_gcs = NULL;
-                                return -1;
-                        }
-                        XFillRectangle(ctx->display, ctx->monitor_pixmaps[i], ctx->monitor_gcs[i], 0, 0, ctx->monitor_width, ctx->monitor_height);
-                }
-        } else if (monitor_index == -1) {
-                // Combine all monitors into a single virtual monitor
-                long width = max_x - min_x;
-                long height = max_y - min_y;
-                if (width <= 0 || height <= 0 || width > INT_MAX || height > INT_MAX) {
-                        fprintf(stderr, "Invalid combined monitor dimensions: %ldx%ld\n", width, height);
-                        for (int i = 0; i < idx; i++) {
-                                if (ctx->crtc_infos[i]) XRRFreeCrtcInfo(ctx->crtc_infos[i]);
-                                if (ctx->output_infos[i]) XRRFreeOutputInfo(ctx->output_infos[i]);
-                        }
-                        free(ctx->output_infos);
-                        free(ctx->crtc_infos);
-                        return -1;
-                }
-                ctx->monitor_x = min_x;
-                ctx->monitor_y = min_y;
-                ctx->monitor_width = width;
-                ctx->monitor_height = height;
-                printf("Combined monitors: %ldx%ld at (%ld,%ld)\n", ctx->monitor_width, ctx->monitor_height, ctx->monitor_x, ctx->monitor_y);
-        } else {
-                // Single monitor
-                if (monitor_index >= num_outputs) {
-                        fprintf(stderr, "Monitor index %d out of range (0-%d)\n", monitor_index, num_outputs - 1);
-                        free(ctx->output_infos);
-                        free(ctx->crtc_infos);
-                        return -1;
+// (Re)creates everything that depends on the output size
+static int setup_scaler(Context *ctx) {
+        int offset = 0;
+        for (int i = 0; i < ctx->num_surfaces; i++) {
+                Surface *sf = &ctx->surfaces[i];
+                if (sf->cropped) {
+                        crop_source(ctx, sf);
+                } else {
+                        sf->src_x = sf->src_y = 0;
+                        sf->src_width = ctx->codec_ctx->width;
+                        sf->src_height = ctx->codec_ctx->height;
                 }
-                ctx->output_infos[0] = XRRGetOutputInfo(ctx->display, ctx->screen_res, ctx->screen_res->outputs[monitor_index]);
-                if (!ctx->output_infos[0] || ctx->output_infos[0]->connection != RR_Connected) {
-                        fprintf(stderr, "Monitor %d is not connected\n", monitor_index);
-                        free(ctx->output_infos);
-                        free(ctx->crtc_infos);
+                if (create_surface_scaler(ctx, sf) < 0) {
                         return -1;
                 }
-                ctx->crtc_infos[0] = XRRGetCrtcInfo(ctx->display, ctx->screen_res, ctx->output_infos[0]->crtc);
-                if (!ctx->crtc_infos[0] || ctx->crtc_infos[0]->width <= 0 || ctx->crtc_infos[0]->height <= 0) {
-                        fprintf(stderr, "Failed to get valid CRTC info for monitor %d\n", monitor_index);
-                        if (ctx->crtc_infos[0]) XRRFreeCrtcInfo(ctx->crtc_infos[0]);
-                        XRRFreeOutputInfo(ctx->output_infos[0]);
-                        free(ctx->output_infos);
-                        free(ctx->crtc_infos);
+                int size = av_image_get_buffer_size(AV_PIX_FMT_BGRA, sf->width, sf->height, 1);
+                if (size <= 0 || offset > INT_MAX - size) {
+                        fprintf(stderr, "Invalid BGRA buffer size for %dx%d\n", sf->width, sf->height);
                         return -1;
                 }
-                ctx->num_monitors = 1;
-                ctx->monitor_x = ctx->crtc_infos[0]->x;
-                ctx->monitor_y = ctx->crtc_infos[0]->y;
-                ctx->monitor_width = ctx->crtc_infos[0]->width;
-                ctx->monitor_height = ctx->crtc_infos[0]->height;
-                printf("Monitor %d: %ldx%ld at (%ld,%ld)\n", monitor_index, ctx->monitor_width, ctx->monitor_height, ctx->monitor_x, ctx->monitor_y);
-        }
-
-        ctx->sws_ctx = sws_getContext(ctx->codec_ctx->width, ctx->codec_ctx->height, ctx->codec_ctx->pix_fmt,
-                                      ctx->monitor_width, ctx->monitor_height, AV_PIX_FMT_BGRA,
-                                      SWS_BILINEAR, NULL, NULL, NULL);
-        if (!ctx->sws_ctx) {
-                fprintf(stderr, "Could not initialize swscale context\n");
+                sf->offset = offset;
+                offset += size;
+        }
+
+        ctx->num_tiles = 0;
+        int max_tiles_x = 1;
+        for (int i = 0; i < ctx->num_surfaces; i++) {
+                Surface *sf = &ctx->surfaces[i];
+                sf->tiles_x = (sf->width + TILE_SIZE - 1) / TILE_SIZE;
+                sf->tiles_y = (sf->height + TILE_SIZE - 1) / TILE_SIZE;
+                sf->tile_offset = ctx->num_tiles;
+                ctx->num_tiles += sf->tiles_x * sf->tiles_y;
+                if (sf->tiles_x > max_tiles_x) max_tiles_x = sf->tiles_x;
+        }
+        free(ctx->tile_mask);
+        free(ctx->tile_rects);
+        free(ctx->tile_runs);
+        ctx->tile_mask = (uint8_t *)malloc(ctx->num_tiles);
+        ctx->tile_rects = (XRectangle *)malloc(ctx->num_tiles * sizeof(XRectangle));
+        ctx->tile_runs = (int *)malloc(2 * max_tiles_x * sizeof(int));
+        if (!ctx->tile_mask || !ctx->tile_rects || !ctx->tile_runs) {
+                fprintf(stderr, "Failed to allocate tile masks\n");
+                return -1;
+        }
+        // Nothing on screen matches the new layout yet
+        ctx->last_frame = NULL;
+
+        ctx->bgra_size = offset;
+        if (ctx->bgra_buffer) av_free(ctx->bgra_buffer);
+        ctx->bgra_buffer = (uint8_t *)av_malloc(ctx->bgra_size * sizeof(uint8_t));
+        if (!ctx->bgra_buffer) {
+                fprintf(stderr, "Failed to allocate BGRA buffer\n");
+                return -1;
+        }
+
+        // A crossfade snapshot of the old size is useless now
+        if (ctx->fade_from) av_free(ctx->fade_from);
+        ctx->fade_from = NULL;
+        ctx->fade_step = ctx->fade_steps = 0;
+        return 0;
+}
+
+// Everything that only depends on the video: demuxer, decoder, frame and packet
+static int open_video(Context *ctx, const char *video_mp4) {
+        avformat_network_init();
+        ctx->fmt_ctx = create_avformat_ctx(video_mp4);
+        if (!ctx->fmt_ctx) {
+                syslog(LOG_ERR, "ctx->fmt_ctx");
+                return -1;
+        }
+        ctx->video_stream_idx = get_video_stream_index(ctx->fmt_ctx);
+        if (ctx->video_stream_idx == -1) {
+                syslog(LOG_ERR, "ctx->video_stream_idx");
+                return -1;
+        }
+        if (!find_codec_decoder(ctx->fmt_ctx, ctx->video_stream_idx, &ctx->codec_ctx, &ctx->codec_par)) {
+                syslog(LOG_ERR, "find_codec_decoder()");
                 return -1;
         }
 
         ctx->frame = av_frame_alloc();
-        ctx->bgra_frame = av_frame_alloc();
         ctx->packet = av_packet_alloc();
-        if (!ctx->frame || !ctx->bgra_frame || !ctx->packet) {
+        if (!ctx->frame || !ctx->packet) {
                 fprintf(stderr, "Memory allocation failed\n");
                 return -1;
         }
+        ctx->video_time_base = av_q2d(ctx->fmt_ctx->streams[ctx->video_stream_idx]->time_base);
+        return 0;
+}
 
-        ctx->bgra_size = av_image_get_buffer_size(AV_PIX_FMT_BGRA, ctx->monitor_width, ctx->monitor_height, 1);
-        if (ctx->bgra_size <= 0) {
-                fprintf(stderr, "Invalid BGRA buffer size for %ldx%ld\n", ctx->monitor_width, ctx->monitor_height);
+int init_context(Context *ctx, Display_Session *ds, int monitor_index, const char *video_mp4) {
+        if (ctx->sink && ctx->sink->type != SINK_X11) {
+                return init_context_headless(ctx, ctx->sink->width, ctx->sink->height, video_mp4);
+        }
+        if (open_video(ctx, video_mp4) < 0) {
                 return -1;
         }
-        ctx->bgra_buffer = (uint8_t *)av_malloc(ctx->bgra_size * sizeof(uint8_t));
-        if (!ctx->bgra_buffer) {
-                fprintf(stderr, "Failed to allocate BGRA buffer\n");
+
+        if (init_display_session(ds) < 0) {
                 return -1;
         }
-        av_image_fill_arrays(ctx->bgra_frame->data, ctx->bgra_frame->linesize, ctx->bgra_buffer, AV_PIX_FMT_BGRA, ctx->monitor_width, ctx->monitor_height, 1);
+        ctx->ds = ds;
+        ctx->monitor_index = monitor_index;
 
-        ctx->root_pixmap = XCreatePixmap(ctx->display, ctx->root, DisplayWidth(ctx->display, ctx->screen), DisplayHeight(ctx->display, ctx->screen), ctx->depth);
-        ctx->root_gc = XCreateGC(ctx->display, ctx->root_pixmap, 0, NULL);
-        if (!ctx->root_gc) {
-                fprintf(stderr, "Failed to create root GC\n");
+        if (layout_context(ctx) < 0) {
                 return -1;
         }
-        XFillRectangle(ctx->display, ctx->root_pixmap, ctx->root_gc, 0, 0, DisplayWidth(ctx->display, ctx->screen), DisplayHeight(ctx->display, ctx->screen));
 
-        ctx->xrootpmap_id = XInternAtom(ctx->display, "_XROOTPMAP_ID", False);
-        ctx->esetroot_pmap_id = XInternAtom(ctx->display, "ESETROOT_PMAP_ID", False);
+        if (setup_scaler(ctx) < 0) {
+                return -1;
+        }
 
-        ctx->frame_interval = 1.0 / (double)g_config.fps;
-        ctx->video_time_base = av_q2d(ctx->fmt_ctx->streams[ctx->video_stream_idx]->time_base);
+        context_set_fps(ctx, g_config.fps);
+
+        return 0;
+}
+
+int init_context_headless(Context *ctx, int width, int height, const char *video_mp4) {
+        if (open_video(ctx, video_mp4) < 0) {
+                return -1;
+        }
+        ctx->monitor_index = 0;
+        ctx->num_monitors = 1;
+        ctx->monitor_width = width > 0 ? width : ctx->codec_ctx->width;
+        ctx->monitor_height = height > 0 ? height : ctx->codec_ctx->height;
+        if (layout_single_surface(ctx) < 0 || setup_scaler(ctx) < 0) {
+                return -1;
+        }
+        context_set_fps(ctx, g_config.fps);
+        return 0;
+}
+
+int context_layout_stale(Context *ctx) {
+        return ctx->ds && session_layout_gen(ctx->ds) != ctx->layout_gen;
+}
+
+int context_relayout(Context *ctx) {
+        if (layout_context(ctx) < 0) {
+                syslog(LOG_ERR, "Relayout for --mon=%d failed", ctx->monitor_index);
+                return -1;
+        }
+        if (setup_scaler(ctx) < 0) {
+                return -1;
+        }
+        syslog(LOG_INFO, "Relayout for --mon=%d: %ldx%ld at (%ld,%ld)", ctx->monitor_index,
+               ctx->monitor_width, ctx->monitor_height, ctx->monitor_x, ctx->monitor_y);
+        return 0;
+}
+
+void context_scale_frame(Context *ctx) {
+        long start = get_time_us();
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(ctx->codec_ctx->pix_fmt);
+        int max_step[4] = {0};
+        if (desc) av_image_fill_max_pixsteps(max_step, NULL, desc);
+
+        for (int i = 0; i < ctx->num_surfaces; i++) {
+                Surface *sf = &ctx->surfaces[i];
+                const uint8_t *src[4] = {0};
+                for (int p = 0; p < 4 && ctx->frame->data[p]; p++) {
+                        src[p] = ctx->frame->data[p];
+                        if (!sf->cropped || (p > 0 && (desc->flags & AV_PIX_FMT_FLAG_PAL))) {
+                                continue; // The palette of PAL8 is not an image plane
+                        }
+                        int chroma = p == 1 || p == 2;
+                        int x = chroma ? sf->src_x >> desc->log2_chroma_w : sf->src_x;
+                        int y = chroma ? sf->src_y >> desc->log2_chroma_h : sf->src_y;
+                        src[p] += (ptrdiff_t)y * ctx->frame->linesize[p] + (ptrdiff_t)x * max_step[p];
+                }
+                uint8_t *dst[4] = { ctx->bgra_buffer + sf->offset, NULL, NULL, NULL };
+                int dst_stride[4] = { sf->width * 4, 0, 0, 0 };
+                sws_scale(sf->sws_ctx, src, ctx->frame->linesize, 0, sf->src_height, dst, dst_stride);
+        }
+        stats_record(STAGE_SCALE, get_time_us() - start);
+        trace_end(TRACE_SCALE, start, ctx->num_surfaces);
+}
+
+void context_set_fps(Context *ctx, int fps) {
+        ctx->frame_interval = 1.0 / (double)fps;
         ctx->frame_duration = ctx->frame_interval / ctx->video_time_base;
+}
 
+int context_set_quality(Context *ctx, unsigned quality) {
+        unsigned changed = ctx->quality ^ quality;
+        ctx->quality = quality;
+        ctx->codec_ctx->skip_loop_filter = quality & QUALITY_FAST_DECODE ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+        if (quality & QUALITY_FAST_DECODE) {
+                ctx->codec_ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+        } else {
+                ctx->codec_ctx->flags2 &= ~AV_CODEC_FLAG2_FAST;
+        }
+        ctx->codec_ctx->skip_frame = quality & QUALITY_SKIP_NONREF ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+        if (changed & QUALITY_FAST_SCALER) {
+                for (int i = 0; i < ctx->num_surfaces; i++) {
+                        if (create_surface_scaler(ctx, &ctx->surfaces[i]) < 0) {
+                                return -1;
+                        }
+                }
+        }
         return 0;
 }
 
+size_t context_footprint(const Context *ctx) {
+        size_t bytes = (size_t)ctx->bgra_size;
+        if (ctx->fade_from) bytes += (size_t)ctx->bgra_size;
+        bytes += (size_t)ctx->num_tiles * (1 + sizeof(XRectangle));
+        for (int i = 0; i < UPLOAD_SLOTS; i++) {
+                if (ctx->upload.slots[i].data) bytes += ctx->upload.size;
+        }
+        if (ctx->codec_ctx) {
+                // Reference frames, one in flight per decoding thread and
+                // the one being handed out
+                int frame_bytes = av_image_get_buffer_size(ctx->codec_ctx->pix_fmt, ctx->codec_ctx->width,
+                                                           ctx->codec_ctx->height, 1);
+                int refs = ctx->codec_ctx->refs > 0 ? ctx->codec_ctx->refs : 1;
+                int threads = ctx->codec_ctx->thread_count > 0 ? ctx->codec_ctx->thread_count : 1;
+                if (frame_bytes > 0) bytes += (size_t)frame_bytes * (size_t)(refs + threads + 1);
+        }
+        return bytes;
+}
+
 void cleanup_context(Context *ctx) {
-        if (ctx->root_gc) XFreeGC(ctx->display, ctx->root_gc);
-        if (ctx->root_pixmap) XFreePixmap(ctx->display, ctx->root_pixmap);
-        if (ctx->mirror_mode) {
-                for (int i = 0; i < ctx->num_monitors; i++) {
-                        if (ctx->monitor_gcs && ctx->monitor_gcs[i]) XFreeGC(ctx->display, ctx->monitor_gcs[i]);
-                        if (ctx->monitor_pixmaps && ctx->monitor_pixmaps[i]) XFreePixmap(ctx->display, ctx->monitor_pixmaps[i]);
-                }
-                if (ctx->monitor_gcs) free(ctx->monitor_gcs);
-                if (ctx->monitor_pixmaps) free(ctx->monitor_pixmaps);
+        if (ctx->ds) {
+                pthread_mutex_lock(&ctx->ds->lock);
+                free_surfaces(ctx);
+                pthread_mutex_unlock(&ctx->ds->lock);
+        } else {
+                free_surfaces(ctx);
         }
         if (ctx->bgra_buffer) av_free(ctx->bgra_buffer);
+        if (ctx->fade_from) av_free(ctx->fade_from);
+        free(ctx->tile_mask);
+        free(ctx->tile_rects);
+        free(ctx->tile_runs);
+        upload_cleanup(&ctx->upload, ctx->ds);
         if (ctx->frame) av_frame_free(&ctx->frame);
-        if (ctx->bgra_frame) av_frame_free(&ctx->bgra_frame);
         if (ctx->packet) av_packet_free(&ctx->packet);
-        if (ctx->sws_ctx) sws_freeContext(ctx->sws_ctx);
-        for (int i = 0; i < ctx->num_monitors; i++) {
-                if (ctx->crtc_infos && ctx->crtc_infos[i]) XRRFreeCrtcInfo(ctx->crtc_infos[i]);
-                if (ctx->output_infos && ctx->output_infos[i]) XRRFreeOutputInfo(ctx->output_infos[i]);
-        }
-        if (ctx->crtc_infos) free(ctx->crtc_infos);
-        if (ctx->output_infos) free(ctx->output_infos);
-        if (ctx->screen_res) XRRFreeScreenResources(ctx->screen_res);
-        if (ctx->display) XCloseDisplay(ctx->display);
         if (ctx->codec_ctx) avcodec_free_context(&ctx->codec_ctx);
         if (ctx->fmt_ctx) avformat_close_input(&ctx->fmt_ctx);
 }
-
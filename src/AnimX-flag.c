@@ -22,6 +22,44 @@
 #include "AnimX-flag.h"
 #include "AnimX-utils.h"
 
+static void playlist_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_PLAYLIST);
+        printf("    Rotate through a playlist of wallpapers inside the daemon.\n");
+        printf("    The playlist is either a directory (every file in it, sorted by name)\n");
+        printf("    or a text file with one wallpaper path per line.\n");
+        printf("    The next entry is decoded and scaled in the background before\n");
+        printf("    it is due, so switching costs almost nothing.\n\n");
+        printf("    Note:\n");
+        printf("        Requires the daemon. See --interval, --order and --fade.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX -d --playlist=/home/user/vids\n");
+        printf("        AnimX --playlist=/home/user/wallpapers.txt --interval=600\n");
+}
+
+static void interval_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_INTERVAL);
+        printf("    Set the number of seconds each playlist entry is shown. Defaults to 300.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX --interval=60\n");
+}
+
+static void order_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_ORDER);
+        printf("    Set the playlist order to either `sequential` or `shuffle`.\n");
+        printf("    Shuffle reshuffles the playlist every time it wraps around.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX --order=sequential\n");
+        printf("        AnimX --order=shuffle\n");
+}
+
+static void fade_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_FADE);
+        printf("    Crossfade from the previous wallpaper to the new one over\n");
+        printf("    the given number of milliseconds. Defaults to 0 (no fade).\n\n");
+        printf("    Example:\n");
+        printf("        AnimX --fade=500\n");
+}
+
 static void version_info(void) {
         printf("--help(%c, %s):\n", FLAG_1HY_VERSION, FLAG_2HY_VERSION);
         printf("    See verison information.\n\n");
@@ -78,7 +116,12 @@ static void mon_info(void) {
         printf("        AnimX --mon=1\n");
         printf("        AnimX --mon=2\n");
         printf("        AnimX --mon=-1 # combine all monitors into one monitor\n");
-        printf("        AnimX --mon=-2 # mirror wallpaper\n");
+        printf("        AnimX --mon=-2 # mirror wallpaper\n\n");
+        printf("    With the daemon, every output keeps its own wallpaper, fps and mode.\n");
+        printf("    Setting one output replaces a combined or mirrored wallpaper, and\n");
+        printf("    --fps or --mode together with --mon only change that output.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX a.mp4 --mon=0 --fps=30 && AnimX b.gif --mon=1 --fps=10\n");
 }
 
 static void mode_info(void) {
@@ -106,10 +149,15 @@ static void maxmem_info(void) {
         printf("    Set the allowed maximum memory usage in GB as a float.\n");
         printf("    If the maximum memory usage has been hit, the program\n");
         printf("    will not exit, rather, it will stop frame generation\n");
-        printf("    and just use those frames.\n\n");
+        printf("    and just use those frames. Memory is what malloc() set\n");
+        printf("    aside for the frames, plus the buffers and an estimate of\n");
+        printf("    the decoder of the same output. The limit applies to each\n");
+        printf("    output on its own.\n\n");
 
         printf("Note:\n");
-        printf("    This option does nothing when --mode=stream is used.\n\n");
+        printf("    This option does nothing when --mode=stream is used.\n");
+        printf("    Under memory pressure (PSI or the cgroup's memory.events)\n");
+        printf("    the daemon drops loaded frames and streams instead.\n\n");
 
         printf("    Example:\n");
         printf("        AnimX --maxmem=1.0\n");
@@ -125,7 +173,7 @@ static void daemon_info(void) {
         printf("    you send a signal to it. Issue the `--stop` flag to stop it.\n\n");
         printf("    Note:\n");
         printf("        1. You can see logging information in `/var/log/syslog`.\n");
-        printf("        2. A FIFO file and PID file are created in `/tmp/`.\n\n");
+        printf("        2. A control socket and PID file are created in `/tmp/`.\n\n");
         printf("    Example:\n");
         printf("        AnimX -d                                     # starts the daemon, does nothing noticable\n");
         printf("        AnimX /home/user/vids/vid.mp4 --mon=1        # the daemon will use this information\n");
@@ -143,6 +191,185 @@ static void stop_info(void) {
         printf("        AnimX --stop\n");
 }
 
+static void status_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_STATUS);
+        printf("    Ask the running daemon what it is doing and print it as\n");
+        printf("    `key=value` lines. Fails if no daemon is running.\n");
+        printf("    Example:\n");
+        printf("        AnimX --status\n");
+}
+
+static void pause_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_PAUSE);
+        printf("    Freeze the wallpaper on its current frame. Nothing is decoded\n");
+        printf("    while paused and a playlist keeps its remaining time.\n");
+        printf("    Requires the daemon.\n");
+        printf("    Example:\n");
+        printf("        AnimX --pause\n");
+}
+
+static void resume_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_RESUME);
+        printf("    Continue playback after --pause or --step.\n");
+        printf("    Example:\n");
+        printf("        AnimX --resume\n");
+}
+
+static void step_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_STEP);
+        printf("    Pause (if needed) and show the next <int> frames, 1 by default.\n");
+        printf("    Example:\n");
+        printf("        AnimX --step\n");
+        printf("        AnimX --step=10\n");
+}
+
+static void occlusion_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_OCCLUSION);
+        printf("    Pause the daemon while windows completely cover every monitor\n");
+        printf("    the wallpaper is on, and continue at the next keyframe once some\n");
+        printf("    of it is visible again. On by default. Translucent (32-bit)\n");
+        printf("    windows do not count as covering.\n");
+        printf("    Example:\n");
+        printf("        AnimX --occlusion=off\n");
+}
+
+static void idle_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_IDLE);
+        printf("    After this many seconds without keyboard or mouse input the daemon\n");
+        printf("    drops to --idlefps. 0 disables it, the default is 300. Independent\n");
+        printf("    of this, playback stops while the screensaver is active or DPMS has\n");
+        printf("    turned the display off.\n");
+        printf("    Example:\n");
+        printf("        AnimX --idle=120\n");
+        printf("        AnimX --idle=0\n");
+}
+
+static void idlefps_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_IDLEFPS);
+        printf("    The FPS used while the user is idle (see --idle). 0, the default,\n");
+        printf("    freezes the wallpaper on its current frame instead.\n");
+        printf("    Example:\n");
+        printf("        AnimX --idlefps=5\n");
+}
+
+static void backend_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_BACKEND);
+        printf("    How frames reach the screen. `root`, the default, sets the root\n");
+        printf("    window background on every update. `window` draws into a desktop\n");
+        printf("    window on each monitor instead and only sets the root properties\n");
+        printf("    when a new wallpaper settles, which is much cheaper under a\n");
+        printf("    compositor (picom and similar) and avoids flicker there.\n");
+        printf("    Example:\n");
+        printf("        AnimX --backend=window\n");
+}
+
+static void stats_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_STATS);
+        printf("    Ask the running daemon how long each pipeline stage takes (demux,\n");
+        printf("    decode, scale, upload, present) as count, p50, p95, p99 and max in\n");
+        printf("    microseconds, and how many frames were presented, dropped, late,\n");
+        printf("    duplicated or decoded but discarded. `reset` clears them after\n");
+        printf("    printing. Fails if no daemon is running.\n");
+        printf("    Example:\n");
+        printf("        AnimX --stats\n");
+        printf("        AnimX --stats=reset\n");
+}
+
+static void bench_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_BENCH);
+        printf("    Run the pipeline on the given video for this many seconds (default\n");
+        printf("    10) without a daemon and print the results as JSON on stdout:\n");
+        printf("    achieved fps, per-stage costs, CPU time, peak RSS and heap growth.\n");
+        printf("    Runs as fast as possible unless --fps is given. Without `present`\n");
+        printf("    in --stages, or with a --sink other than x11, no X display is needed.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX --bench video.mp4\n");
+        printf("        AnimX --bench=30 video.mp4 --fps=60 --stages=demux,decode,scale,present --mon=0\n");
+}
+
+static void stages_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_STAGES);
+        printf("    Choose the stages --bench runs, any of `demux`, `decode`, `scale`\n");
+        printf("    and `present` (decode needs demux). Defaults to demux,decode,scale.\n");
+        printf("    A stage that is left out runs once up front when a later one needs\n");
+        printf("    its output, so `scale` alone keeps scaling the first frame.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX --bench video.mp4 --stages=demux\n");
+        printf("        AnimX --bench video.mp4 --stages=scale --size=3840x2160\n");
+}
+
+static void size_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_SIZE);
+        printf("    Set the size frames are scaled to when they are not shown on a\n");
+        printf("    display: with --sink=null, --sink=dump or --bench without `present`.\n");
+        printf("    Defaults to the size of the video. On a display the monitors chosen\n");
+        printf("    by --mon decide it.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX --bench video.mp4 --size=2560x1440\n");
+}
+
+static void sink_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_SINK);
+        printf("    Choose where finished frames go. `x11` (the default) shows them,\n");
+        printf("    `null` throws them away and `dump:<dir>` writes them to <dir> as\n");
+        printf("    frame-<n>.ppm. A list after another colon only writes those frames\n");
+        printf("    (counted from 0) and stops once the last one is written. Neither\n");
+        printf("    `null` nor `dump` needs an X display. Not available to the daemon.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX video.mp4 --sink=null --fps=60\n");
+        printf("        AnimX video.mp4 --sink=dump:/tmp/frames:0,30,60 --size=640x360\n");
+        printf("        AnimX --bench video.mp4 --stages=demux,decode,scale,present --sink=null\n");
+}
+
+static void trace_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_TRACE);
+        printf("    Record when every thread demuxes, decodes, scales, waits on the\n");
+        printf("    frame ring, uploads, presents, sleeps, loops back to the start and\n");
+        printf("    how long each daemon worker lives. The newest events of each thread\n");
+        printf("    are kept and written to <file> as Chrome trace JSON on exit (Ctrl-C,\n");
+        printf("    --stop or the end of --bench). Open it in ui.perfetto.dev or\n");
+        printf("    chrome://tracing. Costs next to nothing when not given.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX -d video.mp4 --trace=/tmp/animx.json\n");
+        printf("        AnimX --bench video.mp4 --trace=bench.json\n");
+}
+
+static void loglevel_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_LOGLEVEL);
+        printf("    Set which messages are logged: `error`, `warn`, `info` (the default)\n");
+        printf("    or `debug`. Messages go to syslog, and to the terminal when not\n");
+        printf("    running as the daemon. They are written by a background thread, and\n");
+        printf("    per-frame messages (debug) are limited to one per second, so logging\n");
+        printf("    never slows playback down.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX video.mp4 --loglevel=debug\n");
+        printf("        AnimX -d video.mp4 --loglevel=warn\n");
+}
+
+static void threadstats_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_THREADSTATS);
+        printf("    Log the CPU time, context switches and page faults of every AnimX\n");
+        printf("    thread (producer, consumer, worker, presenter, control, ...) every\n");
+        printf("    <int> seconds. 0 stops logging. Sent to a running daemon it takes\n");
+        printf("    effect right away. The same numbers are always part of --stats.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX -d video.mp4 --threadstats=60\n");
+        printf("        AnimX --threadstats=0\n");
+}
+
+static void cpubudget_info(void) {
+        printf("--help(%s):\n", FLAG_2HY_CPUBUDGET);
+        printf("    Hold AnimX to this percent of one core. Over budget it first scales\n");
+        printf("    with a faster filter, then decodes without the loop filter, then\n");
+        printf("    skips frames nothing else refers to, and only then lowers the FPS.\n");
+        printf("    Below budget it takes the same steps back, FPS first. Every change\n");
+        printf("    is logged with the CPU cost of a frame. 0, the default, turns it\n");
+        printf("    off. Sent to a running daemon it takes effect right away.\n\n");
+        printf("    Example:\n");
+        printf("        AnimX -d video.mp4 --cpu-budget=5\n");
+        printf("        AnimX --cpu-budget=0\n");
+}
+
 void dump_flag_info(const char *name) {
         if (*name == '-') {
                 err_wargs("no known help infomation for `%s`, do not include hyphens `-`", name);
@@ -158,6 +385,27 @@ void dump_flag_info(const char *name) {
                 restore_info,
                 copying_info,
                 version_info,
+                playlist_info,
+                interval_info,
+                order_info,
+                fade_info,
+                status_info,
+                pause_info,
+                resume_info,
+                step_info,
+                occlusion_info,
+                idle_info,
+                idlefps_info,
+                backend_info,
+                stats_info,
+                bench_info,
+                stages_info,
+                size_info,
+                sink_info,
+                trace_info,
+                loglevel_info,
+                threadstats_info,
+                cpubudget_info,
         };
 
 #define OHYEQ(n, flag, actual) ((n) == 1 && (flag)[0] == (actual))
@@ -182,6 +430,48 @@ void dump_flag_info(const char *name) {
                 infos[8]();
         } else if (OHYEQ(n, name, FLAG_1HY_VERSION) || !strcmp(name, FLAG_2HY_VERSION)) {
                 infos[9]();
+        } else if (!strcmp(name, FLAG_2HY_PLAYLIST)) {
+                infos[10]();
+        } else if (!strcmp(name, FLAG_2HY_INTERVAL)) {
+                infos[11]();
+        } else if (!strcmp(name, FLAG_2HY_ORDER)) {
+                infos[12]();
+        } else if (!strcmp(name, FLAG_2HY_FADE)) {
+                infos[13]();
+        } else if (!strcmp(name, FLAG_2HY_STATUS)) {
+                infos[14]();
+        } else if (!strcmp(name, FLAG_2HY_PAUSE)) {
+                infos[15]();
+        } else if (!strcmp(name, FLAG_2HY_RESUME)) {
+                infos[16]();
+        } else if (!strcmp(name, FLAG_2HY_STEP)) {
+                infos[17]();
+        } else if (!strcmp(name, FLAG_2HY_OCCLUSION)) {
+                infos[18]();
+        } else if (!strcmp(name, FLAG_2HY_IDLE)) {
+                infos[19]();
+        } else if (!strcmp(name, FLAG_2HY_IDLEFPS)) {
+                infos[20]();
+        } else if (!strcmp(name, FLAG_2HY_BACKEND)) {
+                infos[21]();
+        } else if (!strcmp(name, FLAG_2HY_STATS)) {
+                infos[22]();
+        } else if (!strcmp(name, FLAG_2HY_BENCH)) {
+                infos[23]();
+        } else if (!strcmp(name, FLAG_2HY_STAGES)) {
+                infos[24]();
+        } else if (!strcmp(name, FLAG_2HY_SIZE)) {
+                infos[25]();
+        } else if (!strcmp(name, FLAG_2HY_SINK)) {
+                infos[26]();
+        } else if (!strcmp(name, FLAG_2HY_TRACE)) {
+                infos[27]();
+        } else if (!strcmp(name, FLAG_2HY_LOGLEVEL)) {
+                infos[28]();
+        } else if (!strcmp(name, FLAG_2HY_THREADSTATS)) {
+                infos[29]();
+        } else if (!strcmp(name, FLAG_2HY_CPUBUDGET)) {
+                infos[30]();
         } else if (OHYEQ(n, name, '*')) {
                 for (size_t i = 0; i < sizeof(infos)/sizeof(*infos); ++i) {
                         if (i != 0) putchar('\n');
@@ -0,0 +1,223 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "AnimX-context.h"
+#include "AnimX-governor.h"
+#include "AnimX-log.h"
+#include "AnimX-stats.h"
+#include "AnimX-utils.h"
+
+// Given up in this order
+static const unsigned levels[] = {
+        0,
+        QUALITY_FAST_SCALER,
+        QUALITY_FAST_SCALER | QUALITY_FAST_DECODE,
+        QUALITY_FAST_SCALER | QUALITY_FAST_DECODE | QUALITY_SKIP_NONREF,
+};
+#define NUM_LEVELS (int)(sizeof(levels) / sizeof(*levels))
+
+static atomic_uint g_quality;
+static atomic_int g_fps_percent = 100;
+
+static struct {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        pthread_t thread;
+        int running, stop;
+        double budget; // Percent of one core
+        Governor_Changed changed;
+        void *user;
+} g_gov = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+int governor_parse_budget(const char *s, double *percent) {
+        char *end;
+        double value = strtod(s, &end);
+        if (end == s || *end || value < 0 || value > 100 * 1024) return -1;
+        *percent = value;
+        return 0;
+}
+
+static long cpu_time_us(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return (long)ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static void describe(char *buf, size_t len, int level, int fps_percent) {
+        snprintf(buf, len, "%s scaler, %s decoding%s, %d%% frame rate",
+                 levels[level] & QUALITY_FAST_SCALER ? "fast" : "full",
+                 levels[level] & QUALITY_FAST_DECODE ? "fast" : "full",
+                 levels[level] & QUALITY_SKIP_NONREF ? " without non-reference frames" : "",
+                 fps_percent);
+}
+
+static void *governor_thread(void *arg) {
+        (void)arg;
+        stats_thread_start("governor");
+        int level = 0, fps_percent = 100, calm = 0, settle = 0;
+        long last_wall = get_time_us(), last_cpu = cpu_time_us();
+        unsigned long last_frames = stats_counter(COUNT_PRESENTED);
+
+        pthread_mutex_lock(&g_gov.mutex);
+        while (!g_gov.stop) {
+                struct timespec deadline = us_to_timespec(get_time_us() + GOVERNOR_TICK_US);
+                pthread_cond_timedwait(&g_gov.cond, &g_gov.mutex, &deadline);
+                if (g_gov.stop) break;
+                double budget = g_gov.budget;
+                Governor_Changed changed = g_gov.changed;
+                void *user = g_gov.user;
+                pthread_mutex_unlock(&g_gov.mutex);
+
+                long wall = get_time_us(), cpu = cpu_time_us();
+                unsigned long frames = stats_counter(COUNT_PRESENTED);
+                double usage = wall > last_wall ? 100.0 * (double)(cpu - last_cpu) / (double)(wall - last_wall) : 0.0;
+                double frame_us = frames > last_frames ? (double)(cpu - last_cpu) / (double)(frames - last_frames) : 0.0;
+                last_wall = wall;
+                last_cpu = cpu;
+                last_frames = frames;
+
+                int new_level = level, new_percent = fps_percent;
+                if (budget <= 0) {
+                        // Switched off, give everything back at once
+                        new_level = 0;
+                        new_percent = 100;
+                        calm = 0;
+                } else if (settle) {
+                        // Part of this second still ran with the old settings
+                        settle = 0;
+                } else if (usage > budget * GOVERNOR_HIGH) {
+                        calm = 0;
+                        if (level < NUM_LEVELS - 1) new_level++;
+                        // Far over, or nothing left but the frame rate: cut it by
+                        // the overshoot, since each frame costs about the same
+                        if (level == NUM_LEVELS - 1 || usage > 2 * budget * GOVERNOR_HIGH) {
+                                new_percent = (int)(fps_percent * budget / usage);
+                                if (new_percent < GOVERNOR_MIN_PERCENT) new_percent = GOVERNOR_MIN_PERCENT;
+                        }
+                } else if (usage >= budget * GOVERNOR_LOW) {
+                        calm = 0;
+                } else if (++calm >= GOVERNOR_CALM_TICKS) {
+                        calm = 0;
+                        if (fps_percent < 100) {
+                                double room = usage > 0 ? budget * GOVERNOR_LOW / usage : 2.0;
+                                new_percent = (int)(fps_percent * (room < 1.5 ? room : 1.5)) + 1;
+                                if (new_percent > 100) new_percent = 100;
+                        } else if (level > 0) {
+                                new_level--;
+                        }
+                }
+
+                if (new_level != level || new_percent != fps_percent) {
+                        char was[128], now[128];
+                        describe(was, sizeof(was), level, fps_percent);
+                        describe(now, sizeof(now), new_level, new_percent);
+                        if (budget <= 0) {
+                                log_info("Governor: switched off: %s -> %s", was, now);
+                        } else {
+                                log_info("Governor: %.1f%% of a core for a %.1f%% budget, %.0f us per frame: %s -> %s",
+                                         usage, budget, frame_us, was, now);
+                        }
+                        level = new_level;
+                        atomic_store(&g_quality, levels[level]);
+                        if (new_percent != fps_percent) {
+                                fps_percent = new_percent;
+                                atomic_store(&g_fps_percent, fps_percent);
+                                if (changed) changed(fps_percent, user);
+                        }
+                        settle = 1;
+                } else if (budget > 0) {
+                        log_debug("Governor: %.1f%% of a core for a %.1f%% budget, %.0f us per frame",
+                                  usage, budget, frame_us);
+                }
+                pthread_mutex_lock(&g_gov.mutex);
+        }
+        pthread_mutex_unlock(&g_gov.mutex);
+        return NULL;
+}
+
+int governor_set_budget(double percent, Governor_Changed changed, void *user) {
+        pthread_mutex_lock(&g_gov.mutex);
+        g_gov.budget = percent > 0 ? percent : 0;
+        g_gov.changed = changed;
+        g_gov.user = user;
+        if (g_gov.running || percent <= 0) {
+                // A running governor picks it up on its next tick, or right
+                // away when switched off. It is only joined by governor_stop(),
+                // so `changed` may take locks the caller holds.
+                if (g_gov.running && percent <= 0) pthread_cond_signal(&g_gov.cond);
+                pthread_mutex_unlock(&g_gov.mutex);
+                if (percent > 0) log_info("Governor: holding AnimX to %.1f%% of a core", percent);
+                return 0;
+        }
+        init_monotonic_cond(&g_gov.cond);
+        g_gov.stop = 0;
+        if (pthread_create(&g_gov.thread, NULL, governor_thread, NULL) != 0) {
+                pthread_cond_destroy(&g_gov.cond);
+                pthread_mutex_unlock(&g_gov.mutex);
+                log_error("Failed to create the CPU governor thread");
+                return -1;
+        }
+        g_gov.running = 1;
+        pthread_mutex_unlock(&g_gov.mutex);
+        log_info("Governor: holding AnimX to %.1f%% of a core", percent);
+        return 0;
+}
+
+void governor_stop(void) {
+        pthread_mutex_lock(&g_gov.mutex);
+        if (!g_gov.running) {
+                pthread_mutex_unlock(&g_gov.mutex);
+                return;
+        }
+        g_gov.stop = 1;
+        pthread_cond_signal(&g_gov.cond);
+        pthread_mutex_unlock(&g_gov.mutex);
+        pthread_join(g_gov.thread, NULL);
+
+        pthread_mutex_lock(&g_gov.mutex);
+        pthread_cond_destroy(&g_gov.cond);
+        g_gov.running = 0;
+        g_gov.budget = 0;
+        pthread_mutex_unlock(&g_gov.mutex);
+        atomic_store(&g_quality, 0);
+        atomic_store(&g_fps_percent, 100);
+}
+
+unsigned governor_quality(void) {
+        return atomic_load_explicit(&g_quality, memory_order_relaxed);
+}
+
+int governor_fps_percent(void) {
+        return atomic_load_explicit(&g_fps_percent, memory_order_relaxed);
+}
+
+double governor_budget(void) {
+        pthread_mutex_lock(&g_gov.mutex);
+        double budget = g_gov.budget;
+        pthread_mutex_unlock(&g_gov.mutex);
+        return budget;
+}
@@ -0,0 +1,122 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <X11/extensions/Xrandr.h>
+
+#include "AnimX-hotplug.h"
+#include "AnimX-stats.h"
+#include "AnimX-utils.h"
+
+// Docking easily produces a dozen notifies over a few hundred
+// milliseconds, only act once they stop coming.
+#define HOTPLUG_SETTLE_US (250L * 1000L)
+
+static void *hotplug_thread(void *arg) {
+        Hotplug *hp = (Hotplug *)arg;
+        stats_thread_start("hotplug");
+        struct pollfd fds[2] = {
+                { .fd = ConnectionNumber(hp->display), .events = POLLIN },
+                { .fd = hp->wake_fd[0], .events = POLLIN },
+        };
+
+        long settle_at = 0;
+        while (1) {
+                while (XPending(hp->display)) {
+                        XEvent ev;
+                        XNextEvent(hp->display, &ev);
+                        if (ev.type == hp->rr_event_base + RRScreenChangeNotify
+                            || ev.type == hp->rr_event_base + RRNotify) {
+                                XRRUpdateConfiguration(&ev);
+                                settle_at = get_time_us() + HOTPLUG_SETTLE_US;
+                        }
+                }
+
+                int timeout = -1;
+                if (settle_at) {
+                        long left = settle_at - get_time_us();
+                        timeout = left > 0 ? (int)((left + 999) / 1000) : 0;
+                }
+                if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+                        syslog(LOG_ERR, "Hotplug: poll(): %s", strerror(errno));
+                        break;
+                }
+                if (fds[1].revents) {
+                        break;
+                }
+                if (settle_at && get_time_us() >= settle_at) {
+                        settle_at = 0;
+                        syslog(LOG_INFO, "Hotplug: monitor layout changed");
+                        if (hp->changed) hp->changed(hp->user);
+                }
+        }
+        return NULL;
+}
+
+int hotplug_start(Hotplug *hp, Hotplug_Changed changed, void *user) {
+        hp->display = XOpenDisplay(NULL);
+        if (!hp->display) {
+                syslog(LOG_ERR, "Hotplug: cannot open X display");
+                return -1;
+        }
+
+        int error_base;
+        if (!XRRQueryExtension(hp->display, &hp->rr_event_base, &error_base)) {
+                syslog(LOG_ERR, "Hotplug: RandR is not available");
+                hotplug_stop(hp);
+                return -1;
+        }
+        hp->changed = changed;
+        hp->user = user;
+        XRRSelectInput(hp->display, DefaultRootWindow(hp->display),
+                       RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+        XFlush(hp->display);
+
+        if (pipe(hp->wake_fd) < 0 || pthread_create(&hp->thread, NULL, hotplug_thread, hp) != 0) {
+                syslog(LOG_ERR, "Hotplug: failed to start watcher thread");
+                hotplug_stop(hp);
+                return -1;
+        }
+        hp->started = 1;
+        return 0;
+}
+
+void hotplug_stop(Hotplug *hp) {
+        if (hp->started) {
+                if (write(hp->wake_fd[1], "x", 1) < 0) {
+                        syslog(LOG_ERR, "Hotplug: failed to wake watcher: %s", strerror(errno));
+                }
+                pthread_join(hp->thread, NULL);
+                hp->started = 0;
+        }
+        for (int i = 0; i < 2; i++) {
+                if (hp->wake_fd[i] >= 0) close(hp->wake_fd[i]);
+                hp->wake_fd[i] = -1;
+        }
+        if (hp->display) {
+                XCloseDisplay(hp->display);
+                hp->display = NULL;
+        }
+}
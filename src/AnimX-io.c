@@ -27,6 +27,8 @@
 #include "AnimX-gl.h"
 #include "AnimX-utils.h"
 #include "AnimX-flag.h"
+#include "AnimX-playlist.h"
+#include "AnimX-session.h"
 #include "dyn_array.h"
 #define CIO_IMPL
 #include "cio.h"
@@ -101,6 +103,54 @@ static void parse_config_file(const char *path) {
                                 err_wargs("parse_config_file(): --fps expects a number, not `%s`\n", value.data);
                         }
                         g_config.fps = atoi(value.data);
+                } else if (!strcmp(cmd.data, "playlist")) {
+                        if (value.data[0]) {
+                                g_config.playlist = strdup(value.data);
+                        }
+                } else if (!strcmp(cmd.data, "interval")) {
+                        if (!str_isdigit(value.data)) {
+                                err_wargs("parse_config_file(): --interval expects a number, not `%s`\n", value.data);
+                        }
+                        g_config.interval = atoi(value.data);
+                } else if (!strcmp(cmd.data, "order")) {
+                        if (!strcmp(value.data, "sequential")) {
+                                g_config.order = ORDER_SEQUENTIAL;
+                        } else if (!strcmp(value.data, "shuffle")) {
+                                g_config.order = ORDER_SHUFFLE;
+                        } else {
+                                fprintf(stderr, "parse_config_file(): --order expects either `sequential` or `shuffle`, not `%s`\n", value.data);
+                        }
+                } else if (!strcmp(cmd.data, "fade")) {
+                        if (!str_isdigit(value.data)) {
+                                err_wargs("parse_config_file(): --fade expects a number, not `%s`\n", value.data);
+                        }
+                        g_config.fade = atoi(value.data);
+                } else if (!strcmp(cmd.data, "idle")) {
+                        if (!str_isdigit(value.data)) {
+                                err_wargs("parse_config_file(): --idle expects a number, not `%s`\n", value.data);
+                        }
+                        g_config.idle = atoi(value.data);
+                } else if (!strcmp(cmd.data, "idlefps")) {
+                        if (!str_isdigit(value.data)) {
+                                err_wargs("parse_config_file(): --idlefps expects a number, not `%s`\n", value.data);
+                        }
+                        g_config.idle_fps = atoi(value.data);
+                } else if (!strcmp(cmd.data, "backend")) {
+                        if (!strcmp(value.data, "root")) {
+                                g_config.backend = BACKEND_ROOT;
+                        } else if (!strcmp(value.data, "window")) {
+                                g_config.backend = BACKEND_WINDOW;
+                        } else {
+                                fprintf(stderr, "parse_config_file(): --backend expects either `root` or `window`, not `%s`\n", value.data);
+                        }
+                } else if (!strcmp(cmd.data, "occlusion")) {
+                        if (!strcmp(value.data, "on")) {
+                                g_config.occlusion = 1;
+                        } else if (!strcmp(value.data, "off")) {
+                                g_config.occlusion = 0;
+                        } else {
+                                fprintf(stderr, "parse_config_file(): --occlusion expects either `on` or `off`, not `%s`\n", value.data);
+                        }
                 } else if (!strcmp(cmd.data, "daemon")) {
                         if (!strcmp(value.data, "true")) {
                                 g_config.flags |= FT_DAEMON;
@@ -140,7 +190,7 @@ void write_config_file(void) {
                 for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
                 dyn_array_append(content, '=');
 
-                for (size_t i = 0; g_config.wp[i]; ++i) {
+                for (size_t i = 0; g_config.wp && g_config.wp[i]; ++i) {
                         dyn_array_append(content, g_config.wp[i]);
                 } dyn_array_append(content, '\n');
         }
@@ -201,6 +251,105 @@ void write_config_file(void) {
                 memset(buf, 0, sizeof(buf)/sizeof(*buf));
         }
 
+        // playlist
+        {
+                char cmd[256] = "playlist";
+                for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
+                dyn_array_append(content, '=');
+
+                for (size_t i = 0; g_config.playlist && g_config.playlist[i]; ++i) {
+                        dyn_array_append(content, g_config.playlist[i]);
+                } dyn_array_append(content, '\n');
+        }
+
+        // interval
+        {
+                char cmd[256] = "interval";
+                for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
+                dyn_array_append(content, '=');
+
+                sprintf(buf, "%d", g_config.interval);
+                for (size_t i = 0; buf[i]; ++i) {
+                        dyn_array_append(content, buf[i]);
+                } dyn_array_append(content, '\n');
+                memset(buf, 0, sizeof(buf)/sizeof(*buf));
+        }
+
+        // order
+        {
+                char cmd[256] = "order";
+                for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
+                dyn_array_append(content, '=');
+
+                const char *order = g_config.order == ORDER_SHUFFLE ? "shuffle" : "sequential";
+                for (size_t i = 0; order[i]; ++i) {
+                        dyn_array_append(content, order[i]);
+                } dyn_array_append(content, '\n');
+        }
+
+        // fade
+        {
+                char cmd[256] = "fade";
+                for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
+                dyn_array_append(content, '=');
+
+                sprintf(buf, "%d", g_config.fade);
+                for (size_t i = 0; buf[i]; ++i) {
+                        dyn_array_append(content, buf[i]);
+                } dyn_array_append(content, '\n');
+                memset(buf, 0, sizeof(buf)/sizeof(*buf));
+        }
+
+        // occlusion
+        {
+                char cmd[256] = "occlusion";
+                for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
+                dyn_array_append(content, '=');
+
+                const char *occlusion = g_config.occlusion ? "on" : "off";
+                for (size_t i = 0; occlusion[i]; ++i) {
+                        dyn_array_append(content, occlusion[i]);
+                } dyn_array_append(content, '\n');
+        }
+
+        // backend
+        {
+                char cmd[256] = "backend";
+                for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
+                dyn_array_append(content, '=');
+
+                const char *backend = g_config.backend == BACKEND_WINDOW ? "window" : "root";
+                for (size_t i = 0; backend[i]; ++i) {
+                        dyn_array_append(content, backend[i]);
+                } dyn_array_append(content, '\n');
+        }
+
+        // idle
+        {
+                char cmd[256] = "idle";
+                for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
+                dyn_array_append(content, '=');
+
+                sprintf(buf, "%d", g_config.idle);
+                for (size_t i = 0; buf[i]; ++i) {
+                        dyn_array_append(content, buf[i]);
+                } dyn_array_append(content, '\n');
+                memset(buf, 0, sizeof(buf)/sizeof(*buf));
+        }
+
+        // idlefps
+        {
+                char cmd[256] = "idlefps";
+                for (size_t i = 0; cmd[i]; ++i) dyn_array_append(content, cmd[i]);
+                dyn_array_append(content, '=');
+
+                sprintf(buf, "%d", g_config.idle_fps);
+                for (size_t i = 0; buf[i]; ++i) {
+                        dyn_array_append(content, buf[i]);
+                } dyn_array_append(content, '\n');
+                memset(buf, 0, sizeof(buf)/sizeof(*buf));
+        }
+
         // daemon
         {
                 char cmd[256] = "daemon";
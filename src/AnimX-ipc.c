@@ -0,0 +1,155 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "AnimX-ipc.h"
+
+static int make_addr(const char *path, struct sockaddr_un *addr) {
+        memset(addr, 0, sizeof(*addr));
+        addr->sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr->sun_path)) {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+        strcpy(addr->sun_path, path);
+        return 0;
+}
+
+int ipc_listen(const char *path) {
+        struct sockaddr_un addr;
+        if (make_addr(path, &addr) < 0) {
+                return -1;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+                syslog(LOG_ERR, "socket(): %s", strerror(errno));
+                return -1;
+        }
+
+        unlink(path);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                syslog(LOG_ERR, "Failed to bind %s: %s", path, strerror(errno));
+                close(fd);
+                return -1;
+        }
+        if (listen(fd, 16) < 0) {
+                syslog(LOG_ERR, "Failed to listen on %s: %s", path, strerror(errno));
+                close(fd);
+                unlink(path);
+                return -1;
+        }
+        return fd;
+}
+
+int ipc_connect(const char *path) {
+        struct sockaddr_un addr;
+        if (make_addr(path, &addr) < 0) {
+                return -1;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+                return -1;
+        }
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+int ipc_send(int fd, uint16_t type, uint16_t status, const void *payload, size_t len) {
+        if (len > IPC_MAX_PAYLOAD) {
+                errno = EMSGSIZE;
+                return -1;
+        }
+
+        Ipc_Header hdr = {
+                .magic = IPC_MAGIC,
+                .type = type,
+                .status = status,
+                .len = (uint32_t)len,
+        };
+        struct iovec iov[2] = {
+                { .iov_base = &hdr, .iov_len = sizeof(hdr) },
+                { .iov_base = (void *)payload, .iov_len = len },
+        };
+        struct msghdr mh = {0};
+        mh.msg_iov = iov;
+        mh.msg_iovlen = len ? 2 : 1;
+
+        ssize_t n;
+        do {
+                n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+        } while (n < 0 && errno == EINTR);
+        return n == (ssize_t)(sizeof(hdr) + len) ? 0 : -1;
+}
+
+// Returns 1 on a message, 0 when the peer hung up, -1 on error.
+int ipc_recv(int fd, Ipc_Msg *msg) {
+        struct iovec iov[2] = {
+                { .iov_base = &msg->hdr, .iov_len = sizeof(msg->hdr) },
+                { .iov_base = msg->payload, .iov_len = IPC_MAX_PAYLOAD },
+        };
+        struct msghdr mh = {0};
+        mh.msg_iov = iov;
+        mh.msg_iovlen = 2;
+
+        ssize_t n;
+        do {
+                n = recvmsg(fd, &mh, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n == 0) {
+                return 0;
+        }
+        if (n < 0) {
+                return -1;
+        }
+        if ((mh.msg_flags & MSG_TRUNC) || (size_t)n < sizeof(msg->hdr)
+            || msg->hdr.magic != IPC_MAGIC || msg->hdr.len != (size_t)n - sizeof(msg->hdr)) {
+                errno = EPROTO;
+                return -1;
+        }
+        msg->payload[msg->hdr.len] = '\0';
+        return 1;
+}
+
+// Splits a payload of NUL terminated strings in place. Returns -1 when
+// there are more than `max`, rather than applying only some of them.
+int ipc_split_args(Ipc_Msg *msg, char **argv, int max) {
+        int argc = 0;
+        size_t i = 0;
+        while (i < msg->hdr.len && argc < max) {
+                argv[argc++] = &msg->payload[i];
+                i += strlen(&msg->payload[i]) + 1;
+        }
+        if (i < msg->hdr.len) {
+                errno = E2BIG;
+                return -1;
+        }
+        return argc;
+}
@@ -0,0 +1,249 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "AnimX-log.h"
+#include "AnimX-stats.h"
+#include "AnimX-utils.h"
+
+#define LOG_RING_SLOTS 64
+#define LOG_TEXT_MAX 240
+
+typedef struct {
+        int level;
+        char text[LOG_TEXT_MAX];
+} Log_Entry;
+
+// Single producer (its thread), single consumer (whoever holds
+// `g_drain_mutex`). Entries between `tail` and `head` are complete.
+// Once its thread exited the ring is `dead`, and the drain frees it
+// after emptying it.
+typedef struct Log_Ring {
+        struct Log_Ring *next;
+        atomic_int dead;
+        atomic_ulong head;
+        atomic_ulong tail;
+        atomic_ulong dropped;
+        Log_Entry entries[LOG_RING_SLOTS];
+} Log_Ring;
+
+atomic_int g_log_level = LEVEL_INFO;
+
+static pthread_mutex_t g_rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Log_Ring *g_rings;
+static __thread Log_Ring *t_ring;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+static atomic_int g_running;
+static atomic_int g_stop;
+static atomic_int g_pending; // Set by writers, cleared by the drain before it looks
+static sem_t g_wake;
+static pthread_t g_thread;
+static int g_console;
+
+static const int syslog_prio[] = {
+        [LEVEL_ERROR] = LOG_ERR,
+        [LEVEL_WARN] = LOG_WARNING,
+        [LEVEL_INFO] = LOG_INFO,
+        [LEVEL_DEBUG] = LOG_DEBUG,
+};
+
+static const char *level_names[] = {
+        [LEVEL_ERROR] = "error",
+        [LEVEL_WARN] = "warn",
+        [LEVEL_INFO] = "info",
+        [LEVEL_DEBUG] = "debug",
+};
+
+static void emit(int level, const char *text) {
+        syslog(syslog_prio[level], "%s", text);
+        if (g_console) {
+                FILE *f = level <= LEVEL_WARN ? stderr : stdout;
+                fprintf(f, "%s\n", text);
+                fflush(f);
+        }
+}
+
+// Runs as a thread exits. A destructor running after this one that
+// still logs gets a new ring.
+static void ring_release(void *arg) {
+        Log_Ring *ring = (Log_Ring *)arg;
+        t_ring = NULL;
+        atomic_store_explicit(&ring->dead, 1, memory_order_release);
+        if (!atomic_exchange(&g_pending, 1)) {
+                sem_post(&g_wake);
+        }
+}
+
+static void create_ring_key(void) {
+        pthread_key_create(&g_ring_key, ring_release);
+}
+
+static Log_Ring *thread_ring(void) {
+        if (t_ring) return t_ring;
+        pthread_once(&g_ring_key_once, create_ring_key);
+        Log_Ring *ring = (Log_Ring *)calloc(1, sizeof(Log_Ring));
+        if (!ring) return NULL;
+        if (pthread_setspecific(g_ring_key, ring) != 0) {
+                free(ring);
+                return NULL;
+        }
+        pthread_mutex_lock(&g_rings_mutex);
+        ring->next = g_rings;
+        g_rings = ring;
+        pthread_mutex_unlock(&g_rings_mutex);
+        t_ring = ring;
+        return ring;
+}
+
+// Expects `g_drain_mutex` to be held, which keeps the list from
+// changing anywhere but at its head.
+static void unlink_ring(Log_Ring *ring) {
+        pthread_mutex_lock(&g_rings_mutex);
+        for (Log_Ring **p = &g_rings; *p; p = &(*p)->next) {
+                if (*p == ring) {
+                        *p = ring->next;
+                        break;
+                }
+        }
+        pthread_mutex_unlock(&g_rings_mutex);
+        free(ring);
+}
+
+void log_write(Log_Level level, const char *fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        Log_Ring *ring = atomic_load(&g_running) ? thread_ring() : NULL;
+        if (!ring) {
+                char text[LOG_TEXT_MAX];
+                vsnprintf(text, sizeof(text), fmt, ap);
+                va_end(ap);
+                emit(level, text);
+                return;
+        }
+        unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - tail >= LOG_RING_SLOTS) {
+                va_end(ap);
+                atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+                return;
+        }
+        Log_Entry *e = &ring->entries[head % LOG_RING_SLOTS];
+        e->level = level;
+        vsnprintf(e->text, sizeof(e->text), fmt, ap);
+        va_end(ap);
+        size_t len = strlen(e->text);
+        if (len && e->text[len - 1] == '\n') e->text[len - 1] = '\0';
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+        // Only the first message after a drain pays for the wakeup
+        if (!atomic_exchange(&g_pending, 1)) {
+                sem_post(&g_wake);
+        }
+}
+
+int log_ratelimit(atomic_long *next_us, long interval_us) {
+        long now = get_time_us();
+        long next = atomic_load_explicit(next_us, memory_order_relaxed);
+        return now >= next && atomic_compare_exchange_strong_explicit(next_us, &next, now + interval_us,
+                                                                      memory_order_relaxed, memory_order_relaxed);
+}
+
+int log_parse_level(const char *name) {
+        for (int i = 0; i < (int)(sizeof(level_names) / sizeof(*level_names)); i++) {
+                if (!strcmp(name, level_names[i])) return i;
+        }
+        return -1;
+}
+
+static void drain(void) {
+        pthread_mutex_lock(&g_drain_mutex);
+        pthread_mutex_lock(&g_rings_mutex);
+        Log_Ring *rings = g_rings;
+        pthread_mutex_unlock(&g_rings_mutex);
+        // Rings are only prepended by writers and unlinked by the drain, so
+        // the list from `rings` on is stable while `g_drain_mutex` is held
+        Log_Ring *next;
+        for (Log_Ring *ring = rings; ring; ring = next) {
+                next = ring->next;
+                int dead = atomic_load_explicit(&ring->dead, memory_order_acquire);
+                unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+                unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+                for (; tail != head; tail++) {
+                        Log_Entry *e = &ring->entries[tail % LOG_RING_SLOTS];
+                        emit(e->level, e->text);
+                        atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+                }
+                unsigned long dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+                if (dropped) {
+                        char text[64];
+                        snprintf(text, sizeof(text), "Log: dropped %lu message(s), ring full", dropped);
+                        emit(LEVEL_WARN, text);
+                }
+                // Its thread wrote nothing after `dead`, so this is all of it
+                if (dead) unlink_ring(ring);
+        }
+        pthread_mutex_unlock(&g_drain_mutex);
+}
+
+static void *log_thread(void *arg) {
+        (void)arg;
+        stats_thread_start("log");
+        while (!atomic_load(&g_stop)) {
+                while (sem_wait(&g_wake) < 0) {
+                        // EINTR, try again
+                }
+                atomic_store(&g_pending, 0);
+                drain();
+        }
+        return NULL;
+}
+
+int log_start(int console) {
+        g_console = console;
+        if (sem_init(&g_wake, 0, 0) < 0) {
+                return -1;
+        }
+        atomic_store(&g_stop, 0);
+        atomic_store(&g_running, 1);
+        if (pthread_create(&g_thread, NULL, log_thread, NULL) != 0) {
+                atomic_store(&g_running, 0);
+                sem_destroy(&g_wake);
+                return -1;
+        }
+        return 0;
+}
+
+void log_stop(void) {
+        if (!atomic_load(&g_running)) return;
+        atomic_store(&g_running, 0);
+        atomic_store(&g_stop, 1);
+        sem_post(&g_wake);
+        pthread_join(g_thread, NULL);
+        drain();
+        // `g_wake` stays valid, a late writer may still post to it
+}
@@ -36,6 +36,9 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 
 // FFmpeg
 #include <libavcodec/avcodec.h>
@@ -51,6 +54,22 @@
 
 // Local
 #include "AnimX-context.h"
+#include "AnimX-session.h"
+#include "AnimX-blend.h"
+#include "AnimX-playlist.h"
+#include "AnimX-ipc.h"
+#include "AnimX-playback.h"
+#include "AnimX-occlusion.h"
+#include "AnimX-power.h"
+#include "AnimX-hotplug.h"
+#include "AnimX-present.h"
+#include "AnimX-tiles.h"
+#include "AnimX-stats.h"
+#include "AnimX-bench.h"
+#include "AnimX-trace.h"
+#include "AnimX-log.h"
+#include "AnimX-memory.h"
+#include "AnimX-governor.h"
 #include "AnimX-flag.h"
 #include "AnimX-utils.h"
 #include "AnimX-io.h"
@@ -60,10 +79,20 @@
 #include "config.h"
 #include "AnimX-copying.h"
 
-#define FIFO_PATH "/tmp/AnimX.fifo"
 #define LOG_PATH "/tmp/log/AnimX.log"
 #define PID_PATH "/tmp/AnimX.pid"
 
+// How far ahead of its slot the next playlist entry starts preparing
+#define PLAYLIST_PREFETCH_US (10L * 1000000L)
+
+// Maximum number of simultaneously connected control clients
+#define CONTROL_MAX_CLIENTS 32
+
+// The daemon runs one pipeline per --mon value: each output up to
+// MAX_OUTPUTS, plus combined (-1) and mirror (-2).
+#define MAX_OUTPUTS 16
+#define NUM_SLOTS (MAX_OUTPUTS + 2)
+
 enum {
         MODE_LOAD = 0,
         MODE_STREAM,
@@ -76,6 +105,14 @@ struct {
         int mode; // uses Mode_Type
         double maxmem;
         int fps;
+        char *playlist; // directory or list file
+        int interval; // seconds between playlist entries
+        int order; // uses Order_Type
+        int fade; // crossfade length in milliseconds
+        int occlusion; // pause while the wallpaper is covered
+        int idle; // seconds without input before idle_fps applies, 0 = never
+        int idle_fps; // fps while idle, 0 = freeze
+        int backend; // uses Backend_Type
 } g_config = {
         .flags = 0x00000000,
         .wp = NULL,
@@ -83,6 +120,14 @@ struct {
         .mode = MODE_STREAM,
         .maxmem = 999.f,
         .fps = 30,
+        .playlist = NULL,
+        .interval = 300,
+        .order = ORDER_SEQUENTIAL,
+        .fade = 0,
+        .occlusion = 1,
+        .idle = 300,
+        .idle_fps = 0,
+        .backend = BACKEND_ROOT,
 };
 
 typedef struct {
@@ -93,12 +138,41 @@ typedef struct {
 
 static int g_pid_fd;
 
+// fps and pause state when running without the daemon, daemon
+// pipelines each have their own, see AnimX-playback.h
+static Playback g_playback;
+
+// Batches the root updates of every pipeline, see AnimX-present.h
+static Presenter g_presenter = PRESENTER_INIT;
+
+// Which monitors are not covered by windows, daemon only
+static Occlusion g_occlusion = OCCLUSION_INIT;
+
+// Where frames go, --sink. The daemon always uses SINK_X11.
+static Sink g_sink = SINK_INIT;
+
+// User idle and display power state, daemon only
+static Power g_power = POWER_INIT;
+
+// RandR notifies, daemon only
+static Hotplug g_hotplug = HOTPLUG_INIT;
+
+// Memory pressure, daemon only
+static Memwatch g_memwatch = MEMWATCH_INIT;
+
+// Seconds between per-thread usage logs, --threadstats, 0 for none
+static int g_threadstats = 0;
+
+// Percent of one core AnimX is held to, --cpu-budget, 0 for no limit
+static double g_cpu_budget = 0;
+
 // Thread-specific key for Worker_Data
 static pthread_key_t worker_data_key;
 
 // Threading data for streaming mode
 typedef struct {
         Context *ctx;
+        Playback *pb;    // fps and pause state of the owning pipeline
         Image *buffer;   // Circular buffer for frames
         int buffer_size; // Number of frames in buffer
         int write_idx;   // Where producer writes
@@ -110,25 +184,69 @@ typedef struct {
                 pthread_cond_t not_empty;
         } threading;
         int done;        // Flag to signal threads to exit
+        int resync;      // Ring was dropped, producer restarts at the next keyframe
+        int relayout;    // Set by the consumer, cleared by the producer once relaid out
 } Thread_Data;
 
-typedef struct {
+typedef struct Worker_Data {
         pthread_t thread;        // Worker thread handle
         pthread_mutex_t mutex;   // Mutex for worker state
         pthread_cond_t cond;     // Condition variable for signaling worker start/stop
         int running;             // Flag indicating if worker is running
         int stop;                // Flag to signal worker to stop
+        int ready;               // Set once the first frames are ready to present
         char *wp;                // Current wallpaper path
         int mon;                 // Current monitor index
         int mode;                // Current mode
         double maxmem;           // Current max memory
         int fps;                 // Current fps
         Thread_Data *td;         // Thread_Data for run_stream
+        Display_Session *ds;     // Daemon-lifetime X session shared by all workers
+        Playback pb;             // fps and pause state of this pipeline
+        struct Worker_Data *prev[NUM_SLOTS]; // Workers still presenting until this one is ready
+        int num_prev;
+        long swap_at_us;         // Do not take over before this time (0 = as soon as ready)
+        int shed;                // Memory pressure: give up the loaded frames and stream instead
+        int interrupt;           // Set along with `stop` or `shed`, ends a paused load mode wait
 } Worker_Data;
 
-int run_stream(int monitor_index, const char *video_mp4);
-int run_load_all(int monitor_index, const char *video_mp4);
-static void parse_daemon_sender_msg(const char *msg);
+// Daemon-level state shared by the control socket, the playlist and the workers.
+typedef struct {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;     // Wakes the playlist thread
+        int listen_fd;           // Control socket
+        int stop_fd[2];          // Written to on SIGTERM, ends the control thread
+        Display_Session *ds;
+        Worker_Data *slots[NUM_SLOTS]; // Newest worker for each --mon value, see slot_index()
+        unsigned pause_mask;     // Pause reasons that apply to every pipeline
+        int fps_cap;             // fps cap from the power policy, 0 for none
+        Playlist playlist;
+        int playlist_mon;        // Output the playlist rotates on
+        long next_switch_us;     // When the next playlist entry takes over (0 = now)
+        long paused_at_us;       // When the playlist clock was stopped (0 = running)
+} Daemon_State;
+
+// What a daemon message changed, see parse_daemon_args()
+enum {
+        MSG_WP = 1 << 0,
+        MSG_PLAYLIST = 1 << 1,
+        MSG_PAUSE = 1 << 2,
+        MSG_RESUME = 1 << 3,
+        MSG_STEP = 1 << 4,
+        MSG_FPS = 1 << 5,
+        MSG_MON = 1 << 6,
+        MSG_MODE = 1 << 7,
+        MSG_MAXMEM = 1 << 8,
+        MSG_BACKEND = 1 << 9,
+};
+
+// run_load_all() gave its frames up under memory pressure, see memory_pressure()
+#define LOAD_SHED 2
+
+int run_stream(Display_Session *ds, int monitor_index, const char *video_mp4);
+int run_load_all(Display_Session *ds, int monitor_index, const char *video_mp4);
+static void capture_fade_source(Context *ctx);
+static int parse_daemon_args(int argc, char **argv, const char *cwd, int apply, int *steps, char *err, size_t errlen);
 
 static void init_thread_specific(void) {
         pthread_key_create(&worker_data_key, NULL);
@@ -182,15 +300,22 @@ static int is_single_frame(Context *ctx) {
 static void init_worker_data(Worker_Data *wd) {
         wd->thread = 0;
         pthread_mutex_init(&wd->mutex, NULL);
-        pthread_cond_init(&wd->cond, NULL);
+        init_monotonic_cond(&wd->cond);
         wd->running = 0;
         wd->stop = 0;
+        wd->ready = 0;
         wd->wp = NULL;
         wd->mon = -1;
         wd->mode = MODE_STREAM;
         wd->maxmem = 0.f;
         wd->td = NULL;
         wd->fps = 30;
+        wd->ds = NULL;
+        playback_init(&wd->pb, wd->fps);
+        wd->num_prev = 0;
+        wd->swap_at_us = 0;
+        wd->shed = 0;
+        wd->interrupt = 0;
 }
 
 static void cleanup_worker_data(Worker_Data *wd) {
@@ -200,149 +325,795 @@ static void cleanup_worker_data(Worker_Data *wd) {
         wd->td = NULL; // Thread_Data is cleaned up in run_stream
 }
 
+static Worker_Data* get_worker_data(void) {
+        return (Worker_Data*)pthread_getspecific(worker_data_key);
+}
+
+static void stop_worker(Worker_Data *wd) {
+        pthread_mutex_lock(&wd->mutex);
+        wd->stop = 1;
+        wd->interrupt = 1;
+        pthread_cond_broadcast(&wd->cond);
+        if (wd->td) {
+                pthread_mutex_lock(&wd->td->threading.mutex);
+                wd->td->done = 1;
+                pthread_cond_broadcast(&wd->td->threading.not_empty);
+                pthread_cond_broadcast(&wd->td->threading.not_full);
+                pthread_mutex_unlock(&wd->td->threading.mutex);
+        }
+        pthread_mutex_unlock(&wd->mutex);
+        playback_wake(&wd->pb); // A paused presenter has to see `stop`
+}
+
+// Stops `wd`, waits for it and frees it. A worker that never became
+// ready still owns the workers it was meant to replace, so those are
+// retired as well.
+static void retire_worker(Worker_Data *wd) {
+        if (!wd) return;
+        stop_worker(wd);
+        if (wd->thread) {
+                pthread_join(wd->thread, NULL);
+                wd->thread = 0;
+        }
+        for (int i = 0; i < wd->num_prev; i++) {
+                retire_worker(wd->prev[i]);
+        }
+        cleanup_worker_data(wd);
+        free(wd);
+}
+
+// Called by a worker once its first frames are decoded and scaled.
+// The worker it replaces keeps presenting until this point, so the
+// desktop never blanks while a new wallpaper is being prepared.
+// Prefetched playlist entries additionally wait for their slot.
+// Returns -1 when the worker was stopped meanwhile and must not present.
+static int worker_ready(Context *ctx) {
+        Worker_Data *wd = get_worker_data();
+        if (!wd) return 0;
+
+        pthread_mutex_lock(&wd->mutex);
+        while (wd->swap_at_us && !wd->stop) {
+                if (get_time_us() >= wd->swap_at_us) break;
+                struct timespec ts = us_to_timespec(wd->swap_at_us);
+                pthread_cond_timedwait(&wd->cond, &wd->mutex, &ts);
+        }
+        if (wd->stop) {
+                // Superseded while waiting, the successor retires `prev`
+                pthread_mutex_unlock(&wd->mutex);
+                return -1;
+        }
+        Worker_Data *prev[NUM_SLOTS];
+        int num_prev = wd->num_prev;
+        memcpy(prev, wd->prev, num_prev * sizeof(*prev));
+        wd->num_prev = 0;
+        wd->ready = 1;
+        pthread_mutex_unlock(&wd->mutex);
+
+        if (num_prev) {
+                log_info("Worker: %s is ready, retiring %d previous worker(s)", wd->wp, num_prev);
+                for (int i = 0; i < num_prev; i++) {
+                        retire_worker(prev[i]);
+                }
+                // A fade would freeze half way while paused
+                if (g_config.fade > 0 && !playback_paused(&wd->pb)) {
+                        capture_fade_source(ctx);
+                }
+        }
+        return 0;
+}
+
 void *worker_thread(void *arg) {
         Worker_Data *wd = (Worker_Data *)arg;
         pthread_setspecific(worker_data_key, wd); // Set thread-specific data
-        while (1) {
-                pthread_mutex_lock(&wd->mutex);
-                while (!wd->running && !wd->stop) {
-                        pthread_cond_wait(&wd->cond, &wd->mutex);
-                }
-                if (wd->stop) {
-                        wd->running = 0;
+        stats_thread_start("worker");
+        trace_thread_name("worker");
+        long trace_begin = trace_start();
+
+        char *wp = NULL;
+        int mon;
+        int mode;
+        double maxmem;
+        int fps;
+        pthread_mutex_lock(&wd->mutex);
+        if (wd->wp) wp = strdup(wd->wp);
+        mon = wd->mon;
+        mode = wd->mode;
+        maxmem = wd->maxmem;
+        fps = wd->fps;
+        pthread_mutex_unlock(&wd->mutex);
+
+        int result = -1;
+        if (mode == MODE_STREAM) {
+                log_info("Worker: Starting run_stream with wp=%s, mon=%d", wp ? wp : "(null)", mon);
+                result = run_stream(wd->ds, mon, wp);
+        } else if (mode == MODE_LOAD) {
+                log_info("Worker: Starting run_load_all with wp=%s, mon=%d, maxmem=%f, fps=%d", wp ? wp : "(null)", mon, maxmem, fps);
+                result = run_load_all(wd->ds, mon, wp);
+                if (result == LOAD_SHED) {
+                        log_warn("Worker: memory pressure, streaming %s instead of keeping its frames", wp ? wp : "(null)");
+                        pthread_mutex_lock(&wd->mutex);
+                        wd->mode = MODE_STREAM;
                         pthread_mutex_unlock(&wd->mutex);
-                        break;
+                        result = run_stream(wd->ds, mon, wp);
                 }
-                pthread_mutex_unlock(&wd->mutex);
+        }
+        if (result < 0) {
+                log_error("Worker: Failed to prepare %s, keeping previous wallpaper", wp ? wp : "(null)");
+        }
+        trace_end(TRACE_WORKER, trace_begin, mon);
+
+        free(wp);
+
+        pthread_mutex_lock(&wd->mutex);
+        wd->running = 0;
+        pthread_cond_signal(&wd->cond);
+        pthread_mutex_unlock(&wd->mutex);
+        return NULL;
+}
+
+// Slot of a --mon value in `Daemon_State.slots`, -1 if out of range.
+static int slot_index(int mon) {
+        return mon >= -2 && mon < MAX_OUTPUTS ? mon + 2 : -1;
+}
+
+// Newest worker for `mon`, NULL if there is none.
+static Worker_Data *slot_worker(Daemon_State *st, int mon) {
+        int idx = slot_index(mon);
+        return idx >= 0 ? st->slots[idx] : NULL;
+}
+
+// Combined and mirror cover every output, an output only itself.
+static int slots_overlap(int mon_a, int mon_b) {
+        return mon_a == mon_b || mon_a < 0 || mon_b < 0;
+}
+
+static void set_worker_fps(Worker_Data *wd, int fps) {
+        pthread_mutex_lock(&wd->mutex);
+        wd->fps = fps;
+        pthread_mutex_unlock(&wd->mutex);
+        playback_set_fps(&wd->pb, fps);
+}
+
+// Stops the playlist clock while playback is paused everywhere or the
+// playlist's own output is covered, and continues it where it left off.
+// Expects `st->mutex` to be held.
+static void update_playlist_clock(Daemon_State *st) {
+        Worker_Data *wd = slot_worker(st, st->playlist_mon);
+        int paused = st->pause_mask || (wd && (playback_paused(&wd->pb) & PAUSE_OCCLUDED));
+        if (paused && !st->paused_at_us) {
+                st->paused_at_us = get_time_us();
+        } else if (!paused && st->paused_at_us) {
+                if (st->next_switch_us) {
+                        st->next_switch_us += get_time_us() - st->paused_at_us;
+                }
+                st->paused_at_us = 0;
+                pthread_cond_broadcast(&st->cond);
+        }
+}
+
+// Sets or clears a pause reason on every pipeline. New pipelines start
+// with the reasons that are set. Expects `st->mutex` to be held.
+static void set_paused(Daemon_State *st, unsigned reason, int paused) {
+        if (paused) {
+                st->pause_mask |= reason;
+        } else {
+                st->pause_mask &= ~reason;
+        }
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                Worker_Data *wd = st->slots[i];
+                if (!wd) continue;
+                if (paused) {
+                        playback_pause(&wd->pb, reason);
+                } else {
+                        playback_resume(&wd->pb, reason);
+                }
+        }
+        update_playlist_clock(st);
+}
+
+// Pauses each pipeline while every monitor it draws on is covered by
+// windows. Expects `st->mutex` to be held.
+static void apply_occlusion(Daemon_State *st) {
+        unsigned long visible = occlusion_visible(&g_occlusion);
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                Worker_Data *wd = st->slots[i];
+                if (!wd) continue;
+                int hidden = 0;
+                if (g_config.occlusion) {
+                        if (wd->mon >= 0) {
+                                int m = session_monitor_of_output(st->ds, wd->mon);
+                                hidden = m >= 0 && m < (int)(sizeof(visible) * 8) && !(visible & (1UL << m));
+                        } else {
+                                hidden = visible == 0; // Combined and mirror use every monitor
+                        }
+                }
+                if (hidden == !!(playback_paused(&wd->pb) & PAUSE_OCCLUDED)) continue;
+                log_info("Occlusion: output %d is %s", wd->mon, hidden ? "covered, pausing" : "visible, resuming");
+                if (hidden) {
+                        playback_pause(&wd->pb, PAUSE_OCCLUDED);
+                } else {
+                        playback_resume(&wd->pb, PAUSE_OCCLUDED);
+                }
+        }
+        update_playlist_clock(st);
+}
 
-                char *wp = NULL;
-                int mon;
-                int mode;
-                double maxmem;
-                int fps;
+static void occlusion_changed(unsigned long visible, void *user) {
+        Daemon_State *st = (Daemon_State *)user;
+        (void)visible;
+        pthread_mutex_lock(&st->mutex);
+        apply_occlusion(st);
+        pthread_mutex_unlock(&st->mutex);
+}
+
+// Starts watching for covered monitors the first time it is needed.
+// Expects `st->mutex` to be held.
+static void ensure_occlusion(Daemon_State *st) {
+        if (!g_config.occlusion || g_occlusion.display) return;
+        if (occlusion_start(&g_occlusion, st->ds, occlusion_changed, st) < 0) {
+                log_error("Occlusion: watcher unavailable, playing regardless of covering windows");
+        }
+}
+
+// Maps the power state onto playback: idle drops to --idlefps (or
+// freezes), a blanked or powered off display stops everything.
+// Expects `st->mutex` to be held.
+static void apply_power(Daemon_State *st) {
+        Power_State state = power_state(&g_power);
+        int idle = state == POWER_IDLE && g_config.idle > 0;
+        st->fps_cap = idle ? g_config.idle_fps : 0;
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                if (st->slots[i]) playback_set_cap(&st->slots[i]->pb, st->fps_cap);
+        }
+        set_paused(st, PAUSE_IDLE, idle && g_config.idle_fps == 0);
+        set_paused(st, PAUSE_BLANKED, state == POWER_OFF);
+}
+
+static void power_changed(Power_State state, void *user) {
+        Daemon_State *st = (Daemon_State *)user;
+        (void)state;
+        pthread_mutex_lock(&st->mutex);
+        apply_power(st);
+        pthread_mutex_unlock(&st->mutex);
+}
+
+// Starts following idle time and DPMS the first time it is needed.
+// Expects `st->mutex` to be held.
+static void ensure_power(Daemon_State *st) {
+        if (g_power.display) return;
+        if (power_start(&g_power, g_config.idle, power_changed, st) < 0) {
+                log_error("Power: watcher unavailable, playing at full rate regardless of idle time");
+        }
+}
+
+// Asks a load mode worker to drop its frames. Expects `wd->mutex` held.
+static void shed_frames(Worker_Data *wd) {
+        if (wd->mode == MODE_LOAD) {
+                wd->shed = wd->interrupt = 1;
+                playback_wake(&wd->pb);
+        }
+}
+
+// Runs on the memwatch thread. Load mode keeps every frame in memory,
+// so those pipelines let go of them and stream instead; streaming ones
+// only hold a few frames and are left alone. That includes the workers
+// still showing until their successors in `prev` are ready.
+static void memory_pressure(void *user) {
+        Daemon_State *st = (Daemon_State *)user;
+        pthread_mutex_lock(&st->mutex);
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                Worker_Data *wd = st->slots[i];
+                if (!wd) continue;
+                // worker_ready() empties `prev` under this lock before it
+                // retires them, so the ones listed here are still alive
                 pthread_mutex_lock(&wd->mutex);
-                if (wd->wp) wp = strdup(wd->wp);
-                mon = wd->mon;
-                mode = wd->mode;
-                maxmem = wd->maxmem;
-                fps = wd->fps;
+                shed_frames(wd);
+                for (int j = 0; j < wd->num_prev; j++) {
+                        pthread_mutex_lock(&wd->prev[j]->mutex);
+                        shed_frames(wd->prev[j]);
+                        pthread_mutex_unlock(&wd->prev[j]->mutex);
+                }
                 pthread_mutex_unlock(&wd->mutex);
+        }
+        pthread_mutex_unlock(&st->mutex);
+}
 
-                if (mode == MODE_STREAM) {
-                        syslog(LOG_INFO, "Worker: Starting run_stream with wp=%s, mon=%d", wp ? wp : "(null)", mon);
-                        run_stream(mon, wp);
-                } else if (mode == MODE_LOAD) {
-                        syslog(LOG_INFO, "Worker: Starting run_load_all with wp=%s, mon=%d, maxmem=%f, fps=%d", wp ? wp : "(null)", mon, maxmem, fps);
-                        run_load_all(mon, wp);
-                }
+// Runs on the governor thread when --cpu-budget changed the share of
+// their frame rate the pipelines get.
+static void governor_changed(int fps_percent, void *user) {
+        Daemon_State *st = (Daemon_State *)user;
+        pthread_mutex_lock(&st->mutex);
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                if (st->slots[i]) playback_set_percent(&st->slots[i]->pb, fps_percent);
+        }
+        pthread_mutex_unlock(&st->mutex);
+}
+
+// A local run only has `g_playback`
+static void governor_changed_local(int fps_percent, void *user) {
+        (void)user;
+        playback_set_percent(&g_playback, fps_percent);
+}
 
-                free(wp);
+static int start_worker(Daemon_State *st, const char *wp, int mon, long swap_at_us);
 
+// Runs on the hotplug thread. Re-reads the monitors once; running
+// pipelines notice the new layout generation and relayout in place.
+static void hotplug_changed(void *user) {
+        Daemon_State *st = (Daemon_State *)user;
+        long start = get_time_us();
+        if (session_refresh(st->ds) < 0) {
+                log_error("Hotplug: no usable monitors right now");
+        }
+        occlusion_refresh(&g_occlusion);
+
+        pthread_mutex_lock(&st->mutex);
+        Worker_Data *stale[NUM_SLOTS];
+        int num_stale = 0;
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                Worker_Data *wd = st->slots[i];
+                if (!wd) continue;
                 pthread_mutex_lock(&wd->mutex);
-                wd->running = 0;
-                pthread_cond_signal(&wd->cond);
+                int running = wd->running;
                 pthread_mutex_unlock(&wd->mutex);
+                if (!running) stale[num_stale++] = wd;
         }
-        return NULL;
+        for (int i = 0; i < num_stale; i++) {
+                // Still images are presented once and have no pipeline left
+                start_worker(st, stale[i]->wp, stale[i]->mon, 0);
+        }
+        apply_occlusion(st);
+        pthread_mutex_unlock(&st->mutex);
+        log_info("Hotplug: session refreshed in %ld us", get_time_us() - start);
 }
 
-long get_time_us(void) {
-        struct timespec ts;
-        clock_gettime(CLOCK_MONOTONIC, &ts);
-        return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L; // Microseconds
+// Starts listening for RandR changes the first time it is needed.
+// Expects `st->mutex` to be held.
+static void ensure_hotplug(Daemon_State *st) {
+        if (g_hotplug.display) return;
+        if (hotplug_start(&g_hotplug, hotplug_changed, st) < 0) {
+                log_error("Hotplug: watcher unavailable, monitor changes need a restart");
+        }
 }
 
-int display_frame(Context *ctx, uint8_t *data, int width, int height, int frame_count) {
-        uint8_t *ximage_buffer = (uint8_t *)malloc(ctx->bgra_size);
-        if (!ximage_buffer) {
-                syslog(LOG_ERR, "Failed to allocate XImage buffer for frame %d\n", frame_count);
-                fprintf(stderr, "Failed to allocate XImage buffer for frame %d\n", frame_count);
+// Starts a pipeline for `wp` on output `mon` with the current mode, fps
+// and maxmem from g_config. Pipelines on other outputs keep running;
+// the ones this replaces keep presenting until the new one has its
+// first frames ready and `swap_at_us` has passed. Returns -1 if no
+// worker could be started. Expects `st->mutex` to be held.
+static int start_worker(Daemon_State *st, const char *wp, int mon, long swap_at_us) {
+        int idx = slot_index(mon);
+        if (idx < 0) {
+                log_error("Monitor %d is out of range, at most %d outputs are supported", mon, MAX_OUTPUTS);
                 return -1;
         }
-        memcpy(ximage_buffer, data, ctx->bgra_size);
+        Worker_Data *wd = (Worker_Data *)malloc(sizeof(Worker_Data));
+        if (!wd) {
+                log_error("Failed to allocate worker data");
+                return -1;
+        }
+        init_worker_data(wd);
+        wd->wp = strdup(wp);
+        wd->mon = mon;
+        wd->mode = g_config.mode;
+        wd->maxmem = g_config.maxmem;
+        wd->fps = g_config.fps;
+        wd->ds = st->ds;
+        wd->swap_at_us = swap_at_us;
+        wd->running = 1;
+        playback_set_fps(&wd->pb, wd->fps);
+        playback_set_cap(&wd->pb, st->fps_cap);
+        playback_set_percent(&wd->pb, governor_fps_percent());
+        if (st->pause_mask) playback_pause(&wd->pb, st->pause_mask);
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                if (st->slots[i] && slots_overlap(i - 2, mon)) {
+                        wd->prev[wd->num_prev++] = st->slots[i];
+                }
+        }
 
-        XImage *ximage = XCreateImage(ctx->display, ctx->visual, ctx->depth, ZPixmap, 0, (char *)ximage_buffer,
-                                      width, height, 32, width * 4);
-        if (!ximage) {
-                syslog(LOG_ERR, "Failed to create XImage for frame %d\n", frame_count);
-                fprintf(stderr, "Failed to create XImage for frame %d\n", frame_count);
-                free(ximage_buffer);
+        if (pthread_create(&wd->thread, NULL, worker_thread, wd) != 0) {
+                log_error("Failed to create worker thread");
+                wd->num_prev = 0;
+                cleanup_worker_data(wd);
+                free(wd);
                 return -1;
         }
-        ximage->byte_order = ImageByteOrder(ctx->display);
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                if (st->slots[i] && slots_overlap(i - 2, mon)) st->slots[i] = NULL;
+        }
+        st->slots[idx] = wd;
+        log_info("Started new worker with wp=%s, mon=%d, mode=%d", wd->wp, wd->mon, (int)wd->mode);
+        ensure_occlusion(st);
+        apply_occlusion(st);
+        ensure_power(st);
+        ensure_hotplug(st);
+        return 0;
+}
+
+// The libav calls of the decode loops, timed for AnimX-stats.h
+static int read_packet_timed(Context *ctx) {
+        long start = get_time_us();
+        int ret = av_read_frame(ctx->fmt_ctx, ctx->packet);
+        stats_record(STAGE_DEMUX, get_time_us() - start);
+        trace_end(TRACE_DEMUX, start, ctx->packet->size);
+        return ret;
+}
 
-        if (ctx->mirror_mode) {
-                // Mirror mode: apply the same frame to each monitor
-                for (int i = 0; i < ctx->num_monitors; i++) {
-                        Pixmap pixmap = ctx->monitor_pixmaps[i];
-                        GC gc = ctx->monitor_gcs[i];
+static int send_packet_timed(Context *ctx, long *decode_us) {
+        long start = get_time_us();
+        int ret = avcodec_send_packet(ctx->codec_ctx, ctx->packet);
+        *decode_us += get_time_us() - start;
+        trace_end(TRACE_DECODE, start, ctx->packet->size);
+        return ret;
+}
 
-                        if (XPutImage(ctx->display, pixmap, gc, ximage, 0, 0, 0, 0, width, height) != Success) {
-                                syslog(LOG_ERR, "XPutImage failed for monitor %d, frame %d\n", i, frame_count);
-                                fprintf(stderr, "XPutImage failed for monitor %d, frame %d\n", i, frame_count);
-                                XDestroyImage(ximage);
-                                return -1;
-                        }
+static int receive_frame_timed(Context *ctx, long *decode_us) {
+        long start = get_time_us();
+        int ret = avcodec_receive_frame(ctx->codec_ctx, ctx->frame);
+        *decode_us += get_time_us() - start;
+        trace_end(TRACE_DECODE, start, ret);
+        return ret;
+}
 
-                        // Copy to root pixmap at monitor's position
-                        XCopyArea(ctx->display, pixmap, ctx->root_pixmap, ctx->root_gc, 0, 0, width, height,
-                                  ctx->crtc_infos[i]->x, ctx->crtc_infos[i]->y);
+// Counts a frame that took longer than its period to reach the screen
+static void check_late(Playback *pb, long start_us) {
+        if (get_time_us() - start_us > 1000000L / playback_fps(pb)) {
+                stats_count(COUNT_LATE, 1);
+        }
+}
+
+// Drops what display_frame() remembers about the last frame, the next
+// one is uploaded in full.
+static void forget_last_frame(Context *ctx) {
+        ctx->last_frame = NULL;
+}
+
+// `dirty` optionally gives the tiles in which `data` differs from the
+// frame shown before it, as worked out ahead of time by the caller. It
+// is only trusted when that frame is exactly what was shown last.
+int display_frame(Context *ctx, uint8_t *data, const uint8_t *dirty, int frame_count) {
+        Display_Session *ds = ctx->ds;
+        long start = get_time_us();
+        if (ctx->sink && ctx->sink->type != SINK_X11) {
+                // Headless contexts have a single surface at offset 0
+                if (sink_frame(ctx->sink, data, ctx->surfaces[0].width, ctx->surfaces[0].height) < 0) {
+                        return -1;
                 }
+                stats_record(STAGE_PRESENT, get_time_us() - start);
+                stats_count(COUNT_PRESENTED, 1);
+                trace_end(TRACE_PRESENT, start, frame_count);
+                return 0;
+        }
+        uint8_t *ximage_buffer = upload_acquire(&ctx->upload, ds, ctx->bgra_size);
+        if (!ximage_buffer) {
+                log_every(LEVEL_ERROR, 1000000L, "Failed to get an upload buffer for frame %d", frame_count);
+                forget_last_frame(ctx);
+                return -1;
+        }
+        int blended = ctx->fade_from && ctx->fade_step < ctx->fade_steps;
+        if (blended) {
+                int alpha = (ctx->fade_step + 1) * 256 / (ctx->fade_steps + 1);
+                blend_bgra(ximage_buffer, data, ctx->fade_from, alpha, ctx->bgra_size);
+                ctx->fade_step++;
         } else {
-                // Single or combined mode
-                Pixmap pixmap = XCreatePixmap(ctx->display, ctx->root, width, height, ctx->depth);
-                if (!pixmap) {
-                        syslog(LOG_ERR, "Failed to create pixmap for frame %d\n", frame_count);
-                        fprintf(stderr, "Failed to create pixmap for frame %d\n", frame_count);
-                        XDestroyImage(ximage);
-                        return -1;
+                memcpy(ximage_buffer, data, ctx->bgra_size);
+        }
+
+        // Only tiles that changed since the last frame are uploaded. A
+        // monitor that was hidden missed those updates, so any change in
+        // visibility uploads everything.
+        unsigned long visible = ctx->mirror_mode && g_config.occlusion ? occlusion_visible(&g_occlusion) : ~0UL;
+        int full = !ctx->last_frame || (ctx->mirror_mode && visible != ctx->last_visible);
+        if (!full && (!dirty || blended || ctx->last_blended)) {
+                tiles_diff(ctx, ctx->last_frame, ximage_buffer, ctx->tile_mask);
+                dirty = ctx->tile_mask;
+        }
+
+        pthread_mutex_lock(&ds->lock);
+        if (ctx->layout_gen != ds->layout_gen) {
+                // Monitors changed under us, the owner relayouts before the next frame
+                pthread_mutex_unlock(&ds->lock);
+                forget_last_frame(ctx);
+                return 0;
+        }
+        if (!blended && (full || ctx->last_blended)) {
+                // A new wallpaper (or layout) has settled, point the root
+                // properties at it again, see session_set_backend()
+                ds->root_published = 0;
+        }
+
+        for (int s = 0; s < ctx->num_surfaces; s++) {
+                Surface *sf = &ctx->surfaces[s];
+                if (ctx->mirror_mode) {
+                        int shown = 0;
+                        for (int j = 0; j < sf->num_monitors; j++) {
+                                int i = sf->monitors[j];
+                                shown |= i >= (int)(sizeof(visible) * 8) || (visible & (1UL << i));
+                        }
+                        if (!shown) continue;
                 }
 
-                GC gc = XCreateGC(ctx->display, pixmap, 0, NULL);
-                if (!gc) {
-                        syslog(LOG_ERR, "Failed to create GC for frame %d\n", frame_count);
-                        fprintf(stderr, "Failed to create GC for frame %d\n", frame_count);
-                        XFreePixmap(ctx->display, pixmap);
-                        XDestroyImage(ximage);
-                        return -1;
+                XRectangle *rects = ctx->tile_rects;
+                int num_rects = 1;
+                if (full) {
+                        rects[0] = (XRectangle){ .x = 0, .y = 0, .width = sf->width, .height = sf->height };
+                } else {
+                        num_rects = tiles_rects(ctx, s, dirty, rects);
+                        if (num_rects == 0) continue;
                 }
 
-                if (XPutImage(ctx->display, pixmap, gc, ximage, 0, 0, 0, 0, width, height) != Success) {
-                        syslog(LOG_ERR, "XPutImage failed for frame %d\n", frame_count);
-                        fprintf(stderr, "XPutImage failed for frame %d\n", frame_count);
-                        XFreeGC(ctx->display, gc);
-                        XFreePixmap(ctx->display, pixmap);
-                        XDestroyImage(ximage);
+                // Mirror mode uploads each resolution once and lets the
+                // server copy it to every visible monitor of that size,
+                // everything else goes straight into the root pixmap.
+                Pixmap target = ctx->mirror_mode ? sf->pixmap : ds->root_pixmap;
+                GC gc = ctx->mirror_mode ? sf->gc : ds->root_gc;
+                int tx = ctx->mirror_mode ? 0 : (int)sf->x, ty = ctx->mirror_mode ? 0 : (int)sf->y;
+                int put = 0;
+                for (int r = 0; r < num_rects && put == 0; r++) {
+                        put = upload_put(&ctx->upload, ds, target, gc, sf->offset, sf->width, sf->height,
+                                         &rects[r], tx + rects[r].x, ty + rects[r].y);
+                }
+                if (put < 0) {
+                        log_every(LEVEL_ERROR, 1000000L, "Upload failed for %dx%d surface, frame %d", sf->width, sf->height, frame_count);
+                        pthread_mutex_unlock(&ds->lock);
+                        forget_last_frame(ctx);
                         return -1;
                 }
 
-                XCopyArea(ctx->display, pixmap, ctx->root_pixmap, ctx->root_gc, 0, 0, width, height, ctx->monitor_x, ctx->monitor_y);
-                XFreeGC(ctx->display, gc);
-                XFreePixmap(ctx->display, pixmap);
+                // The root window itself is updated by the presenter, once
+                // per refresh for all pipelines together
+                if (!ctx->mirror_mode) {
+                        for (int r = 0; r < num_rects; r++) {
+                                presenter_damage(&g_presenter, tx + rects[r].x, ty + rects[r].y,
+                                                 rects[r].width, rects[r].height);
+                        }
+                        continue;
+                }
+                for (int j = 0; j < sf->num_monitors; j++) {
+                        int i = sf->monitors[j];
+                        if (i < (int)(sizeof(visible) * 8) && !(visible & (1UL << i))) {
+                                continue;
+                        }
+                        for (int r = 0; r < num_rects; r++) {
+                                int x = ds->crtc_infos[i]->x + rects[r].x, y = ds->crtc_infos[i]->y + rects[r].y;
+                                XCopyArea(ds->display, sf->pixmap, ds->root_pixmap, ds->root_gc,
+                                          rects[r].x, rects[r].y, rects[r].width, rects[r].height, x, y);
+                                presenter_damage(&g_presenter, x, y, rects[r].width, rects[r].height);
+                        }
+                }
+        }
+        pthread_mutex_unlock(&ds->lock);
+        stats_record(STAGE_UPLOAD, get_time_us() - start);
+        stats_count(COUNT_PRESENTED, 1);
+        trace_end(TRACE_UPLOAD, start, frame_count);
+        presenter_flush(&g_presenter, ds);
+
+        ctx->last_frame = ximage_buffer;
+        ctx->last_blended = blended;
+        ctx->last_visible = visible;
+        return 0;
+}
+
+// Copies what is currently on screen under this context's area so the
+// first frames of the new wallpaper can crossfade from it.
+static void capture_fade_source(Context *ctx) {
+        Display_Session *ds = ctx->ds;
+        int steps = (int)((double)g_config.fade / 1000.0 / ctx->frame_interval);
+        if (steps <= 0) return;
+
+        uint8_t *snapshot = (uint8_t *)av_malloc(ctx->bgra_size);
+        if (!snapshot) {
+                log_error("Failed to allocate crossfade buffer");
+                return;
         }
 
-        // Update root window properties
-        XSetWindowBackgroundPixmap(ctx->display, ctx->root, ctx->root_pixmap);
-        XChangeProperty(ctx->display, ctx->root, ctx->xrootpmap_id, XA_PIXMAP, 32, PropModeReplace,
-                        (unsigned char *)&ctx->root_pixmap, 1);
-        XChangeProperty(ctx->display, ctx->root, ctx->esetroot_pmap_id, XA_PIXMAP, 32, PropModeReplace,
-                        (unsigned char *)&ctx->root_pixmap, 1);
-        XClearWindow(ctx->display, ctx->root);
-        XFlush(ctx->display);
+        // Each surface fades from what its (first) monitor shows
+        for (int s = 0; s < ctx->num_surfaces; s++) {
+                Surface *sf = &ctx->surfaces[s];
+                pthread_mutex_lock(&ds->lock);
+                XImage *ximage = XGetImage(ds->display, ds->root_pixmap, sf->x, sf->y,
+                                           sf->width, sf->height, AllPlanes, ZPixmap);
+                pthread_mutex_unlock(&ds->lock);
+                if (!ximage || ximage->bits_per_pixel != 32) {
+                        log_error("Failed to capture previous wallpaper for crossfade");
+                        if (ximage) XDestroyImage(ximage);
+                        av_free(snapshot);
+                        return;
+                }
 
-        XDestroyImage(ximage); // Frees ximage_buffer
-        return 0;
+                size_t row = (size_t)sf->width * 4;
+                for (long y = 0; y < sf->height; y++) {
+                        memcpy(snapshot + sf->offset + y * row, ximage->data + y * ximage->bytes_per_line, row);
+                }
+                XDestroyImage(ximage);
+        }
+
+        if (ctx->fade_from) av_free(ctx->fade_from);
+        ctx->fade_from = snapshot;
+        ctx->fade_step = 0;
+        ctx->fade_steps = steps;
 }
 
-static Worker_Data* get_worker_data(void) {
-        return (Worker_Data*)pthread_getspecific(worker_data_key);
+static void present_single_frame(Context *ctx, int frame_count) {
+        if (worker_ready(ctx) < 0) return;
+
+        // Play out the crossfade before settling on the image
+        long target_time = (long)(ctx->frame_interval * 1000000.0);
+        while (ctx->fade_from && ctx->fade_step < ctx->fade_steps) {
+                if (display_frame(ctx, ctx->bgra_buffer, NULL, frame_count) < 0) {
+                        break;
+                }
+                usleep(target_time);
+        }
+
+        if (display_frame(ctx, ctx->bgra_buffer, NULL, frame_count) < 0) {
+                log_error("Failed to display single frame");
+        } else {
+                log_info("Displayed single frame");
+        }
+}
+
+// Rescales frames that were already loaded to a new layout, which is
+// much cheaper than decoding the whole video again. The old surfaces are
+// put back together into the picture they were cut from (the largest
+// one in mirror mode), and each new surface is scaled from its part.
+static int relayout_loaded_frames(Context *ctx, Image *images, int image_count) {
+        int old_num = ctx->num_surfaces, old_size = ctx->bgra_size, mirror = ctx->mirror_mode;
+        long old_x = ctx->monitor_x, old_y = ctx->monitor_y;
+        long old_width = ctx->monitor_width, old_height = ctx->monitor_height;
+        // Only the geometry is used after the relayout
+        Surface *old = (Surface *)malloc((old_num + 1) * sizeof(Surface));
+        if (!old) {
+                return -1;
+        }
+        memcpy(old, ctx->surfaces, old_num * sizeof(Surface));
+        if (context_relayout(ctx) < 0) {
+                free(old);
+                return -1;
+        }
+
+        int same = ctx->num_surfaces == old_num && ctx->bgra_size == old_size
+                && ctx->monitor_width == old_width && ctx->monitor_height == old_height;
+        for (int s = 0; same && s < old_num; s++) {
+                Surface *sf = &ctx->surfaces[s];
+                same = sf->width == old[s].width && sf->height == old[s].height
+                        && (mirror || (sf->x - ctx->monitor_x == old[s].x - old_x && sf->y - ctx->monitor_y == old[s].y - old_y));
+        }
+        if (same) {
+                free(old);
+                return 0;
+        }
+
+        // The picture the old surfaces show: one of them as is, or the
+        // bounding box rebuilt from the cropped ones of combined mode
+        int assemble = !mirror && (old_num != 1 || old[0].cropped);
+        int canvas_width = old[0].width, canvas_height = old[0].height, canvas_offset = old[0].offset;
+        for (int s = 1; mirror && s < old_num; s++) {
+                if ((long)old[s].width * old[s].height > (long)canvas_width * canvas_height) {
+                        canvas_width = old[s].width;
+                        canvas_height = old[s].height;
+                        canvas_offset = old[s].offset;
+                }
+        }
+        uint8_t *canvas_buf = NULL;
+        if (assemble) {
+                canvas_width = (int)old_width;
+                canvas_height = (int)old_height;
+                canvas_buf = (uint8_t *)calloc((size_t)canvas_width * canvas_height, 4);
+                if (!canvas_buf) {
+                        free(old);
+                        return -1;
+                }
+        }
+
+        struct SwsContext **sws = (struct SwsContext **)calloc(ctx->num_surfaces, sizeof(*sws));
+        int (*src_rect)[4] = (int (*)[4])malloc(ctx->num_surfaces * sizeof(*src_rect));
+        if (!sws || !src_rect) {
+                free(sws);
+                free(src_rect);
+                free(canvas_buf);
+                free(old);
+                return -1;
+        }
+        int flags = ctx->quality & QUALITY_FAST_SCALER ? SWS_FAST_BILINEAR : CONTEXT_SWS_FLAGS;
+        for (int s = 0; s < ctx->num_surfaces; s++) {
+                Surface *sf = &ctx->surfaces[s];
+                int *r = src_rect[s];
+                if (sf->cropped) {
+                        r[0] = (int)((sf->x - ctx->monitor_x) * canvas_width / ctx->monitor_width);
+                        r[1] = (int)((sf->y - ctx->monitor_y) * canvas_height / ctx->monitor_height);
+                        r[2] = (int)((sf->width * (long)canvas_width + ctx->monitor_width - 1) / ctx->monitor_width);
+                        r[3] = (int)((sf->height * (long)canvas_height + ctx->monitor_height - 1) / ctx->monitor_height);
+                        if (r[0] + r[2] > canvas_width) r[2] = canvas_width - r[0];
+                        if (r[1] + r[3] > canvas_height) r[3] = canvas_height - r[1];
+                } else {
+                        r[0] = r[1] = 0;
+                        r[2] = canvas_width;
+                        r[3] = canvas_height;
+                }
+                sws[s] = r[2] > 0 && r[3] > 0
+                        ? sws_getContext(r[2], r[3], AV_PIX_FMT_BGRA, sf->width, sf->height, AV_PIX_FMT_BGRA,
+                                         flags, NULL, NULL, NULL)
+                        : NULL;
+        }
+
+        int ret = 0;
+        for (int i = 0; i < image_count && ret == 0; i++) {
+                Image *img = &images[i];
+                uint8_t *data = (uint8_t *)malloc(ctx->bgra_size);
+                if (!data) {
+                        ret = -1;
+                        break;
+                }
+                const uint8_t *canvas = img->data ? img->data + canvas_offset : NULL;
+                if (assemble && img->data) {
+                        for (int s = 0; s < old_num; s++) {
+                                long cx = old[s].x - old_x, cy = old[s].y - old_y;
+                                for (long y = 0; y < old[s].height && cy + y < canvas_height; y++) {
+                                        long row = old[s].width;
+                                        if (cx + row > canvas_width) row = canvas_width - cx;
+                                        memcpy(canvas_buf + ((cy + y) * canvas_width + cx) * 4,
+                                               img->data + old[s].offset + y * old[s].width * 4, row * 4);
+                                }
+                        }
+                        canvas = canvas_buf;
+                }
+                for (int s = 0; s < ctx->num_surfaces && canvas; s++) {
+                        if (!sws[s]) {
+                                ret = -1;
+                                break;
+                        }
+                        const uint8_t *src[1] = { canvas + ((size_t)src_rect[s][1] * canvas_width + src_rect[s][0]) * 4 };
+                        int src_stride[1] = { canvas_width * 4 };
+                        uint8_t *dst[1] = { data + ctx->surfaces[s].offset };
+                        int dst_stride[1] = { ctx->surfaces[s].width * 4 };
+                        sws_scale(sws[s], src, src_stride, 0, src_rect[s][3], dst, dst_stride);
+                }
+                free(img->data);
+                img->data = data;
+                img->width = (int)ctx->monitor_width;
+                img->height = (int)ctx->monitor_height;
+                img->size = ctx->bgra_size;
+        }
+        for (int s = 0; s < ctx->num_surfaces; s++) {
+                if (sws[s]) sws_freeContext(sws[s]);
+        }
+        free(sws);
+        free(src_rect);
+        free(canvas_buf);
+        free(old);
+        return ret;
 }
 
-int run_load_all(int monitor_index, const char *video_mp4) {
+// Works out once which tiles of every loaded frame differ from the frame
+// before it (the last one for frame 0), so playback that walks through
+// the frames in order only pays for what really changes. Returns NULL if
+// there is no memory for it, frames are then compared as they are shown.
+static uint8_t *diff_loaded_frames(Context *ctx, Image *images, int image_count) {
+        uint8_t *masks = (uint8_t *)malloc((size_t)image_count * ctx->num_tiles);
+        if (!masks) {
+                log_error("Failed to allocate tile masks for %d frames", image_count);
+                return NULL;
+        }
+        for (int i = 0; i < image_count; i++) {
+                const uint8_t *prev = images[(i + image_count - 1) % image_count].data;
+                uint8_t *mask = masks + (size_t)i * ctx->num_tiles;
+                if (prev && images[i].data) {
+                        tiles_diff(ctx, prev, images[i].data, mask);
+                } else {
+                        memset(mask, 1, ctx->num_tiles);
+                }
+        }
+        return masks;
+}
+
+int run_load_all(Display_Session *ds, int monitor_index, const char *video_mp4) {
         Worker_Data *wd = get_worker_data(); // May be NULL in non-daemon mode
         int is_daemon = g_config.flags & FT_DAEMON;
+        Playback *pb = wd ? &wd->pb : &g_playback;
         Context ctx = {0};
-        if (init_context(&ctx, monitor_index, video_mp4) < 0) {
+        ctx.sink = &g_sink;
+        if (init_context(&ctx, ds, monitor_index, video_mp4) < 0) {
                 cleanup_context(&ctx);
                 return -1;
         }
@@ -356,14 +1127,8 @@ int run_load_all(int monitor_index, const char *video_mp4) {
                         if (ctx.packet->stream_index == ctx.video_stream_idx) {
                                 if (avcodec_send_packet(ctx.codec_ctx, ctx.packet) >= 0) {
                                         while (avcodec_receive_frame(ctx.codec_ctx, ctx.frame) >= 0) {
-                                                sws_scale(ctx.sws_ctx, (const uint8_t * const *)ctx.frame->data, ctx.frame->linesize, 0, ctx.codec_ctx->height,
-                                                          ctx.bgra_frame->data, ctx.bgra_frame->linesize);
-                                                if (display_frame(&ctx, ctx.bgra_buffer, ctx.monitor_width, ctx.monitor_height, frame_count) < 0) {
-                                                        syslog(LOG_ERR, "Failed to display single frame");
-                                                        fprintf(stderr, "Failed to display single frame\n");
-                                                } else {
-                                                        printf("Displayed single frame\n");
-                                                }
+                                                context_scale_frame(&ctx);
+                                                present_single_frame(&ctx, frame_count);
                                                 frame_count++;
                                                 break; // Only process one frame
                                         }
@@ -379,15 +1144,14 @@ int run_load_all(int monitor_index, const char *video_mp4) {
         dyn_array(Image, images);
         int image_count = 0;
         int64_t next_pts = 0;
-        const char loading[] = {'|', '/', '-', '\\', '|'};
-        size_t loading_len = sizeof(loading)/sizeof(*loading);
-        size_t loading_i = 0;
-        double mem_usage = 0;
+        size_t store_bytes = 0; // What malloc() set aside for the frames, slack included
+        int shed = 0;
 
-        while (av_read_frame(ctx.fmt_ctx, ctx.packet) >= 0) {
+        while (read_packet_timed(&ctx) >= 0) {
                 if (is_daemon && wd) {
                         pthread_mutex_lock(&wd->mutex);
-                        if (wd->stop) {
+                        shed = wd->shed && !wd->stop;
+                        if (wd->stop || shed) {
                                 pthread_mutex_unlock(&wd->mutex);
                                 av_packet_unref(ctx.packet);
                                 break;
@@ -396,98 +1160,137 @@ int run_load_all(int monitor_index, const char *video_mp4) {
                 }
 
                 if (ctx.packet->stream_index == ctx.video_stream_idx) {
-                        if (avcodec_send_packet(ctx.codec_ctx, ctx.packet) >= 0) {
-                                while (avcodec_receive_frame(ctx.codec_ctx, ctx.frame) >= 0) {
+                        long decode_us = 0;
+                        if (send_packet_timed(&ctx, &decode_us) >= 0) {
+                                while (receive_frame_timed(&ctx, &decode_us) >= 0) {
                                         if (ctx.frame->pts >= next_pts) {
+                                                // Only what this pipeline holds: the frames, the array
+                                                // holding them and its own buffers and decoder. Other
+                                                // outputs loading at the same time are not charged here.
+                                                double mem_usage = (double)store_bytes + (double)images.cap * sizeof(Image)
+                                                        + (double)context_footprint(&ctx);
                                                 double GBs = mem_usage / (1024.0 * 1024.0 * 1024.0);
                                                 if ((g_config.flags & FT_MAXMEM) && GBs >= g_config.maxmem) {
-                                                        fflush(stdout);
-                                                        printf("maximum memory allowed (%f) has been exceeded, stopping image generation...\n", g_config.maxmem);
+                                                        log_warn("maximum memory allowed (%f) has been exceeded, stopping image generation...", g_config.maxmem);
                                                         goto done;
                                                 }
-                                                sws_scale(ctx.sws_ctx, (const uint8_t * const *)ctx.frame->data, ctx.frame->linesize, 0, ctx.codec_ctx->height,
-                                                          ctx.bgra_frame->data, ctx.bgra_frame->linesize);
+                                                context_scale_frame(&ctx);
                                                 Image img = (Image){
                                                         .data = (uint8_t *)malloc(ctx.bgra_size),
                                                         .width = (int)ctx.monitor_width,
                                                         .height = (int)ctx.monitor_height,
                                                 };
-                                                mem_usage += (double)ctx.bgra_size;
+                                                store_bytes += mem_block_size(img.data);
                                                 if (!img.data) {
-                                                        syslog(LOG_ERR, "Failed to allocate image data\n");
-                                                        fprintf(stderr, "Failed to allocate image data\n");
+                                                        log_error("Failed to allocate image data");
                                                         break;
                                                 }
                                                 memcpy(img.data, ctx.bgra_buffer, ctx.bgra_size);
                                                 image_count++;
                                                 next_pts += ctx.frame_duration;
-                                                printf("Loading Frames... [%d], mem=%fGB %c\n", image_count, GBs, loading[loading_i]);
-                                                fflush(stdout);
-                                                printf("\033[A");
-                                                printf("\033[2K");
-                                                if (image_count%5 == 0) {
-                                                        loading_i = (loading_i + 1)%loading_len;
-                                                }
+                                                log_every(LEVEL_INFO, 1000000L, "Loading Frames... [%d], mem=%fGB", image_count, GBs);
                                                 dyn_array_append(images, img);
+                                        } else {
+                                                stats_count(COUNT_DISCARDED, 1);
                                         }
                                 }
                         }
+                        stats_record(STAGE_DECODE, decode_us);
                 }
                 av_packet_unref(ctx.packet);
         }
 
  done:
-        printf("Loaded %d frames at %ldx%ld (BGRA)\n", image_count, ctx.monitor_width, ctx.monitor_height);
-        sleep(1);
-
+        if (shed) {
+                for (int i = 0; i < image_count; i++) {
+                        free(images.data[i].data);
+                }
+                dyn_array_free(images);
+                cleanup_context(&ctx);
+                return LOAD_SHED;
+        }
+        log_info("Loaded %d frames at %ldx%ld (BGRA), %zu KB", image_count, ctx.monitor_width, ctx.monitor_height,
+                 (store_bytes + images.cap * sizeof(Image)) / 1024);
+        if (image_count == 0) {
+                dyn_array_free(images);
+                cleanup_context(&ctx);
+                return -1;
+        }
+        worker_ready(&ctx); // A stopped worker leaves the loop below before presenting
+        uint8_t *masks = diff_loaded_frames(&ctx, images.data, image_count);
+        int shown = -1; // Frame that was displayed last, -1 if unknown
+
+        // Frames were sampled at the fps the context was created with. A
+        // later fps change only alters how fast we walk through them.
+        int never_stop = 0;
+        const int *stop = is_daemon && wd ? &wd->interrupt : &never_stop;
+        double load_fps = 1.0 / ctx.frame_interval;
+        double pos = 0.0;
         int i = 0;
         while (1) {
                 if (is_daemon && wd) {
                         pthread_mutex_lock(&wd->mutex);
-                        if (wd->stop) {
+                        shed = wd->shed && !wd->stop;
+                        if (wd->stop || shed) {
                                 pthread_mutex_unlock(&wd->mutex);
                                 break;
                         }
                         pthread_mutex_unlock(&wd->mutex);
                 }
 
-                Image *img = &images.data[i];
-                if (!img->data) {
-                        syslog(LOG_ERR, "Null image data for frame %d\n", i);
-                        fprintf(stderr, "Null image data for frame %d\n", i);
-                        i = (i + 1) % image_count;
-                        continue;
+                if (context_layout_stale(&ctx)) {
+                        if (relayout_loaded_frames(&ctx, images.data, image_count) < 0) {
+                                log_error("Failed to relayout loaded frames, stopping");
+                                break;
+                        }
+                        free(masks);
+                        masks = diff_loaded_frames(&ctx, images.data, image_count);
                 }
 
+                Image *img = &images.data[i];
                 long start_time = get_time_us();
-                if (display_frame(&ctx, img->data, img->width, img->height, i) < 0) {
-                        i = (i + 1) % image_count;
-                        continue;
+                if (shown == i) {
+                        stats_count(COUNT_DUPLICATED, 1);
                 }
-
-                long end_time = get_time_us();
-                long processing_time = end_time - start_time;
-                long target_time = (long)(1.0 / g_config.fps * 1000000.0); // fps
-                long sleep_time = target_time - processing_time;
-
-                if (sleep_time > 0) {
-                        usleep(sleep_time);
+                const uint8_t *dirty = NULL;
+                if (masks && shown == (i + image_count - 1) % image_count) {
+                        dirty = masks + (size_t)i * ctx.num_tiles;
+                }
+                shown = -1;
+                if (!img->data) {
+                        log_every(LEVEL_ERROR, 1000000L, "Null image data for frame %d", i);
+                } else if (display_frame(&ctx, img->data, dirty, i) == 0) {
+                        shown = i;
+                        check_late(pb, start_time);
+                        log_every(LEVEL_DEBUG, 1000000L, "Displayed frame %d (processing: %ld us)", i + 1, get_time_us() - start_time);
+                }
+                if (sink_done(&g_sink)) {
+                        break;
                 }
 
-                printf("Displayed frame %d (processing: %ld us, sleep: %ld us)\n",
-                       i + 1, processing_time, sleep_time > 0 ? sleep_time : 0);
-                fflush(stdout);
-                printf("\033[A");
-                printf("\033[2K");
-                i = (i + 1) % image_count;
+                long sleep_start = trace_start();
+                int woke = playback_wait(pb, start_time, stop);
+                trace_end(TRACE_SLEEP, sleep_start, i);
+                if (woke < 0) {
+                        break;
+                }
+                pos += load_fps / playback_fps(pb);
+                while (pos >= image_count) pos -= image_count;
+                i = (int)pos;
         }
 
         for (int i = 0; i < image_count; i++) {
                 if (images.data[i].data) free(images.data[i].data);
         }
+        free(masks);
         dyn_array_free(images);
         cleanup_context(&ctx);
-        return 0; // Multi-frame case
+        if (is_daemon && wd) {
+                pthread_mutex_lock(&wd->mutex);
+                shed = wd->shed && !wd->stop; // May have ended a paused wait
+                pthread_mutex_unlock(&wd->mutex);
+        }
+        return shed ? LOAD_SHED : 0; // Multi-frame case
 }
 
 // Producer thread: decodes and scales frames
@@ -496,28 +1299,60 @@ void *producer_thread(void *arg) {
         Context *ctx = td->ctx;
         int64_t next_pts = 0;
         int frame_count = 0;
+        int fps = (int)(1.0 / ctx->frame_interval + 0.5);
+        int skip_to_key = 0;
+        unsigned quality = 0;
+        stats_thread_start("producer");
+        trace_thread_name("producer");
 
         while (!td->done) {
                 pthread_mutex_lock(&td->threading.mutex);
                 // Wait if buffer is full
+                long wait_start = trace_start();
                 while (td->count == td->buffer_size && !td->done) {
                         pthread_cond_wait(&td->threading.not_full, &td->threading.mutex);
                 }
+                trace_end(TRACE_RING_WAIT, wait_start, td->count);
                 if (td->done) {
                         pthread_mutex_unlock(&td->threading.mutex);
                         break;
                 }
+                if (td->resync) {
+                        // Nothing that was missed while hidden gets decoded
+                        td->resync = 0;
+                        avcodec_flush_buffers(ctx->codec_ctx);
+                        skip_to_key = 1;
+                }
+                if (td->relayout) {
+                        // The consumer is parked and the ring is empty, so
+                        // the scaler and frame buffers can be swapped out.
+                        for (int i = 0; i < td->buffer_size; i++) {
+                                free(td->buffer[i].data);
+                                td->buffer[i].data = NULL;
+                        }
+                        if (context_relayout(ctx) < 0) {
+                                td->done = 1;
+                        }
+                        td->relayout = 0;
+                        pthread_cond_broadcast(&td->threading.not_empty);
+                        if (td->done) {
+                                pthread_mutex_unlock(&td->threading.mutex);
+                                break;
+                        }
+                }
                 pthread_mutex_unlock(&td->threading.mutex);
 
-                int ret = av_read_frame(ctx->fmt_ctx, ctx->packet);
+                int ret = read_packet_timed(ctx);
                 if (ret < 0 || td->done) {
                         pthread_mutex_lock(&td->threading.mutex);
                         av_packet_unref(ctx->packet);
                         if (!td->done) {
+                                long seek_start = trace_start();
                                 avcodec_flush_buffers(ctx->codec_ctx);
-                                if (avformat_seek_file(ctx->fmt_ctx, ctx->video_stream_idx, INT64_MIN, 0, INT64_MAX, 0) < 0) {
-                                        syslog(LOG_ERR, "Failed to seek to start of video\n");
-                                        fprintf(stderr, "Failed to seek to start of video\n");
+                                int seeked = avformat_seek_file(ctx->fmt_ctx, ctx->video_stream_idx, INT64_MIN, 0, INT64_MAX, 0);
+                                trace_end(TRACE_SEEK, seek_start, frame_count);
+                                if (seeked < 0) {
+                                        log_error("Failed to seek to start of video");
                                         td->done = 1;
                                 } else {
                                         next_pts = 0;
@@ -529,14 +1364,47 @@ void *producer_thread(void *arg) {
                         if (td->done) break;
                         continue;
                 }
+                if (skip_to_key && ctx->packet->stream_index == ctx->video_stream_idx) {
+                        if (!(ctx->packet->flags & AV_PKT_FLAG_KEY)) {
+                                av_packet_unref(ctx->packet);
+                                continue;
+                        }
+                        skip_to_key = 0;
+                        if (ctx->packet->pts != AV_NOPTS_VALUE) next_pts = ctx->packet->pts;
+                }
+                // Follow live fps changes, the next sampled frame uses the new step
+                int live_fps = playback_fps(td->pb);
+                if (live_fps != fps) {
+                        context_set_fps(ctx, live_fps);
+                        fps = live_fps;
+                }
+                // And how much the CPU governor lets it spend on a frame
+                unsigned live_quality = governor_quality();
+                if (live_quality != quality) {
+                        if (context_set_quality(ctx, live_quality) < 0) {
+                                log_error("Failed to change decoding quality");
+                                av_packet_unref(ctx->packet);
+                                pthread_mutex_lock(&td->threading.mutex);
+                                td->done = 1;
+                                pthread_cond_broadcast(&td->threading.not_empty);
+                                pthread_mutex_unlock(&td->threading.mutex);
+                                break;
+                        }
+                        quality = live_quality;
+                }
                 if (ctx->packet->stream_index == ctx->video_stream_idx) {
-                        if (avcodec_send_packet(ctx->codec_ctx, ctx->packet) >= 0) {
-                                while (avcodec_receive_frame(ctx->codec_ctx, ctx->frame) >= 0) {
+                        long decode_us = 0;
+                        if (send_packet_timed(ctx, &decode_us) >= 0) {
+                                while (receive_frame_timed(ctx, &decode_us) >= 0) {
                                         if (ctx->frame->pts >= next_pts) {
-                                                sws_scale(ctx->sws_ctx, (const uint8_t * const *)ctx->frame->data, ctx->frame->linesize, 0,
-                                                          ctx->codec_ctx->height, ctx->bgra_frame->data, ctx->bgra_frame->linesize);
+                                                context_scale_frame(ctx);
 
                                                 pthread_mutex_lock(&td->threading.mutex);
+                                                if (td->resync || td->relayout) {
+                                                        pthread_mutex_unlock(&td->threading.mutex);
+                                                        stats_count(COUNT_DROPPED, 1);
+                                                        continue;
+                                                }
                                                 Image *img = &td->buffer[td->write_idx];
                                                 img->width = ctx->monitor_width;
                                                 img->height = ctx->monitor_height;
@@ -544,8 +1412,7 @@ void *producer_thread(void *arg) {
                                                 if (!img->data) {
                                                         img->data = (uint8_t *)malloc(ctx->bgra_size);
                                                         if (!img->data) {
-                                                                syslog(LOG_ERR, "Failed to allocate buffer frame %d\n", frame_count);
-                                                                fprintf(stderr, "Failed to allocate buffer frame %d\n", frame_count);
+                                                                log_every(LEVEL_ERROR, 1000000L, "Failed to allocate buffer frame %d", frame_count);
                                                                 td->done = 1;
                                                                 pthread_cond_broadcast(&td->threading.not_empty);
                                                                 pthread_mutex_unlock(&td->threading.mutex);
@@ -559,9 +1426,12 @@ void *producer_thread(void *arg) {
                                                 next_pts += ctx->frame_duration;
                                                 pthread_cond_signal(&td->threading.not_empty);
                                                 pthread_mutex_unlock(&td->threading.mutex);
+                                        } else {
+                                                stats_count(COUNT_DISCARDED, 1);
                                         }
                                 }
                         }
+                        stats_record(STAGE_DECODE, decode_us);
                 }
                 av_packet_unref(ctx->packet);
         }
@@ -573,14 +1443,35 @@ void *consumer_thread(void *arg) {
         Thread_Data *td = (Thread_Data *)arg;
         Context *ctx = td->ctx;
         int frame_count = 0;
+        unsigned resync = playback_resync(td->pb);
+        stats_thread_start("consumer");
+        trace_thread_name("consumer");
 
         while (!td->done) {
                 long start_time = get_time_us();
 
+                if (context_layout_stale(ctx)) {
+                        // Hand the context to the producer between two
+                        // frames and wait until it is laid out again.
+                        pthread_mutex_lock(&td->threading.mutex);
+                        stats_count(COUNT_DROPPED, td->count);
+                        td->read_idx = td->write_idx;
+                        td->count = 0;
+                        td->relayout = 1;
+                        pthread_cond_signal(&td->threading.not_full);
+                        while (td->relayout && !td->done) {
+                                pthread_cond_wait(&td->threading.not_empty, &td->threading.mutex);
+                        }
+                        pthread_mutex_unlock(&td->threading.mutex);
+                        continue;
+                }
+
                 pthread_mutex_lock(&td->threading.mutex);
+                long wait_start = trace_start();
                 while (td->count == 0 && !td->done) {
                         pthread_cond_wait(&td->threading.not_empty, &td->threading.mutex);
                 }
+                trace_end(TRACE_RING_WAIT, wait_start, td->count);
                 if (td->count == 0 && td->done) {
                         pthread_mutex_unlock(&td->threading.mutex);
                         break;
@@ -591,96 +1482,416 @@ void *consumer_thread(void *arg) {
                 pthread_cond_signal(&td->threading.not_full);
                 pthread_mutex_unlock(&td->threading.mutex);
 
-                if (display_frame(ctx, img->data, img->width, img->height, frame_count) < 0) {
+                if (display_frame(ctx, img->data, NULL, frame_count) == 0) {
+                        frame_count++;
+                        check_late(td->pb, start_time);
+                        log_every(LEVEL_DEBUG, 1000000L, "Displayed frame %d (processing: %ld us)", frame_count, get_time_us() - start_time);
+                }
+                if (sink_done(&g_sink)) {
+                        pthread_mutex_lock(&td->threading.mutex);
+                        td->done = 1;
+                        pthread_cond_broadcast(&td->threading.not_full);
+                        pthread_mutex_unlock(&td->threading.mutex);
+                        break;
+                }
+
+                // While paused this parks without a timeout, and the
+                // producer parks on `not_full` behind it.
+                long sleep_start = trace_start();
+                int woke = playback_wait(td->pb, start_time, &td->done);
+                trace_end(TRACE_SLEEP, sleep_start, frame_count);
+                if (woke < 0) {
+                        break;
+                }
+
+                // Coming back from being covered: whatever is buffered is
+                // stale, drop it and let the producer resync.
+                unsigned now_resync = playback_resync(td->pb);
+                if (now_resync != resync) {
+                        resync = now_resync;
+                        pthread_mutex_lock(&td->threading.mutex);
+                        stats_count(COUNT_DROPPED, td->count);
+                        td->read_idx = td->write_idx;
+                        td->count = 0;
+                        td->resync = 1;
+                        pthread_cond_signal(&td->threading.not_full);
+                        pthread_mutex_unlock(&td->threading.mutex);
+                }
+        }
+        return NULL;
+}
+
+// Loads g_config.playlist and lets the playlist thread present its
+// first entry on the current --mon. Expects `st->mutex` to be held.
+static void restart_playlist(Daemon_State *st) {
+        if (!g_config.playlist) return;
+        if (playlist_load(&st->playlist, g_config.playlist, g_config.order) <= 0) {
+                log_error("Playlist %s has no usable entries", g_config.playlist);
+                return;
+        }
+        st->playlist_mon = g_config.mon;
+        st->next_switch_us = 0;
+        pthread_cond_broadcast(&st->cond);
+}
+
+static void stop_playlist(Daemon_State *st) {
+        playlist_free(&st->playlist);
+        st->next_switch_us = 0;
+        if (g_config.playlist) {
+                free(g_config.playlist);
+                g_config.playlist = NULL;
+        }
+}
+
+// Hands the next playlist entry to a new worker that takes over at
+// `swap_at_us`. Expects `st->mutex` to be held.
+static void advance_playlist(Daemon_State *st, long swap_at_us) {
+        const char *next = playlist_next(&st->playlist);
+        if (!next) return;
+        Worker_Data *wd = slot_worker(st, st->playlist_mon);
+        if (st->playlist.items.len == 1 && wd && !strcmp(wd->wp, next)) {
+                return; // Nothing to rotate to
+        }
+        if (g_config.wp) free(g_config.wp);
+        g_config.wp = strdup(next);
+        log_info("Playlist: prefetching %s for output %d", g_config.wp, st->playlist_mon);
+        start_worker(st, g_config.wp, st->playlist_mon, swap_at_us);
+}
+
+void *playlist_thread(void *arg) {
+        Daemon_State *st = (Daemon_State *)arg;
+        stats_thread_start("playlist");
+        pthread_mutex_lock(&st->mutex);
+        while (1) {
+                // Paused playlists keep their remaining time, see set_paused()
+                if (st->playlist.items.len == 0 || (st->paused_at_us && st->next_switch_us)) {
+                        pthread_cond_wait(&st->cond, &st->mutex);
+                        continue;
+                }
+
+                long now = get_time_us();
+                long interval = (long)g_config.interval * 1000000L;
+                if (interval <= 0) interval = 1000000L;
+
+                if (st->next_switch_us == 0) {
+                        // Fresh playlist: present the first entry right away
+                        advance_playlist(st, 0);
+                        st->next_switch_us = now + interval;
+                        continue;
+                }
+
+                // Start preparing the next entry ahead of its slot so it is
+                // decoded and scaled by the time it has to be presented.
+                long lead = interval / 2 < PLAYLIST_PREFETCH_US ? interval / 2 : PLAYLIST_PREFETCH_US;
+                long prefetch_at = st->next_switch_us - lead;
+                if (now < prefetch_at) {
+                        struct timespec ts = us_to_timespec(prefetch_at);
+                        pthread_cond_timedwait(&st->cond, &st->mutex, &ts);
                         continue;
                 }
 
-                frame_count++;
-                long end_time = get_time_us();
-                long processing_time = end_time - start_time;
-                long target_time =(long)(1.0 / g_config.fps * 1000000.0); // fps
-                long sleep_time = target_time - processing_time;
+                advance_playlist(st, st->next_switch_us);
+                st->next_switch_us += interval;
+                if (st->next_switch_us < now) {
+                        st->next_switch_us = now + interval;
+                }
+        }
+        pthread_mutex_unlock(&st->mutex);
+        return NULL;
+}
+
+// Applies a client's flags to the pipeline on --mon. Only a new source
+// or geometry rebuilds that pipeline, fps is applied to the running one
+// and pause/resume/step to all of them. Expects `st->mutex` to be held.
+static int handle_set(Daemon_State *st, int argc, char **argv, char *reply, size_t replylen) {
+        const char *cwd = argc > 0 ? argv[0] : NULL;
+        int steps = 0;
+        if (parse_daemon_args(argc - 1, argv + 1, cwd, 0, &steps, reply, replylen) < 0) {
+                return -1;
+        }
+        int old_idle = g_config.idle;
+        double old_budget = g_cpu_budget;
+        int changed = parse_daemon_args(argc - 1, argv + 1, cwd, 1, &steps, reply, replylen);
+        Worker_Data *wd = slot_worker(st, g_config.mon);
+
+        if (g_config.idle != old_idle) {
+                power_set_idle(&g_power, g_config.idle);
+        }
+        if (g_cpu_budget != old_budget) {
+                governor_set_budget(g_cpu_budget, governor_changed, st);
+        }
+        apply_power(st);
+        if (changed & MSG_FPS) {
+                // Without a pipeline of its own on --mon every pipeline is retimed
+                for (int i = 0; i < NUM_SLOTS; i++) {
+                        if (st->slots[i] && (!wd || st->slots[i] == wd)) set_worker_fps(st->slots[i], g_config.fps);
+                }
+                write_config_file();
+        }
+        if (changed & MSG_BACKEND) {
+                session_set_backend(st->ds, g_config.backend);
+                occlusion_refresh(&g_occlusion);
+                write_config_file();
+        }
+        ensure_occlusion(st);
+        apply_occlusion(st);
+        if (changed & MSG_RESUME) {
+                set_paused(st, PAUSE_USER, 0);
+        }
+        if (changed & MSG_PAUSE) {
+                set_paused(st, PAUSE_USER, 1);
+        }
+        if (changed & MSG_STEP) {
+                if (!(st->pause_mask & PAUSE_USER)) {
+                        set_paused(st, PAUSE_USER, 1);
+                }
+                for (int i = 0; i < NUM_SLOTS; i++) {
+                        if (st->slots[i]) playback_step(&st->slots[i]->pb, steps);
+                }
+        }
+
+        if (changed & MSG_WP) {
+                // An explicit wallpaper ends a playlist on the same output
+                if (st->playlist.items.len && slots_overlap(st->playlist_mon, g_config.mon)) {
+                        stop_playlist(st);
+                }
+        } else if (changed & MSG_PLAYLIST) {
+                restart_playlist(st);
+                write_config_file();
+                snprintf(reply, replylen, "playlist %s (%zu entries) on output %d",
+                         g_config.playlist ? g_config.playlist : "(null)", st->playlist.items.len, st->playlist_mon);
+                return st->playlist.items.len ? 0 : -1;
+        }
+
+        // A message without a wallpaper rebuilds the pipeline on --mon with
+        // its own wallpaper, or moves the last one to an output that has none.
+        const char *wp = (changed & MSG_WP) || !wd ? g_config.wp : wd->wp;
+        int rebuild = 0;
+        if (wp && (changed & MSG_WP)) {
+                rebuild = !wd || strcmp(wp, wd->wp) != 0 || g_config.mode != wd->mode
+                        || (g_config.mode == MODE_LOAD && g_config.maxmem != wd->maxmem);
+        } else if (wp && wd) {
+                rebuild = ((changed & MSG_MODE) && g_config.mode != wd->mode)
+                        || ((changed & MSG_MAXMEM) && g_config.mode == MODE_LOAD && g_config.maxmem != wd->maxmem);
+        } else if (wp) {
+                rebuild = (changed & MSG_MON) != 0;
+        }
+        if (rebuild) {
+                char *path = strdup(wp); // `wd` may be retired from here on
+                if (start_worker(st, path, g_config.mon, 0) < 0) {
+                        snprintf(reply, replylen, "failed to start worker for %s", path);
+                        free(path);
+                        return -1;
+                }
+                write_config_file();
+                snprintf(reply, replylen, "switching output %d to %s", g_config.mon, path);
+                free(path);
+                return 0;
+        }
+        if (wd) {
+                snprintf(reply, replylen, "output %d %s at %d fps", wd->mon,
+                         playback_paused(&wd->pb) ? "paused" : "playing", playback_fps(&wd->pb));
+        } else {
+                snprintf(reply, replylen, "%s, no wallpaper on output %d", st->pause_mask ? "paused" : "playing", g_config.mon);
+        }
+        return 0;
+}
+
+// Writes the daemon state as `key=value` lines, followed by one
+// `output.<mon>.*` block per pipeline. The top-level keys describe the
+// pipeline on --mon. Expects `st->mutex` to be held.
+static void handle_status(Daemon_State *st, char *reply, size_t replylen) {
+        Worker_Data *wd = slot_worker(st, g_config.mon);
+        int ready = 0;
+        if (wd) {
+                pthread_mutex_lock(&wd->mutex);
+                ready = wd->ready;
+                pthread_mutex_unlock(&wd->mutex);
+        }
+        int num_pipelines = 0;
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                num_pipelines += st->slots[i] != NULL;
+        }
+        pthread_mutex_lock(&g_presenter.mutex);
+        unsigned long updates = g_presenter.updates, damages = g_presenter.damages;
+        pthread_mutex_unlock(&g_presenter.mutex);
+
+        int n = snprintf(reply, replylen,
+                 "pid=%d\n"
+                 "wp=%s\n"
+                 "mon=%d\n"
+                 "mode=%s\n"
+                 "fps=%d\n"
+                 "live_fps=%d\n"
+                 "maxmem=%f\n"
+                 "playlist=%s\n"
+                 "playlist_entries=%zu\n"
+                 "playlist_mon=%d\n"
+                 "interval=%d\n"
+                 "order=%s\n"
+                 "fade=%d\n"
+                 "paused=%u\n"
+                 "occlusion=%s\n"
+                 "visible=0x%lx\n"
+                 "backend=%s\n"
+                 "power=%s\n"
+                 "ready=%d\n"
+                 "pipelines=%d\n"
+                 "present_period_us=%ld\n"
+                 "present_updates=%lu\n"
+                 "present_damages=%lu\n"
+                 "rss_kb=%ld\n"
+                 "memwatch=%s\n"
+                 "memory_pressure=%lu\n"
+                 "cpu_budget=%.1f\n"
+                 "quality=0x%x\n"
+                 "fps_percent=%d\n",
+                 (int)getpid(),
+                 wd && wd->wp ? wd->wp : "",
+                 wd ? wd->mon : g_config.mon,
+                 (wd ? wd->mode : g_config.mode) == MODE_LOAD ? "load" : "stream",
+                 wd ? wd->fps : g_config.fps,
+                 wd ? playback_fps(&wd->pb) : 0,
+                 g_config.maxmem,
+                 g_config.playlist ? g_config.playlist : "",
+                 st->playlist.items.len,
+                 st->playlist_mon,
+                 g_config.interval,
+                 g_config.order == ORDER_SHUFFLE ? "shuffle" : "sequential",
+                 g_config.fade,
+                 wd ? playback_paused(&wd->pb) : st->pause_mask,
+                 g_config.occlusion ? "on" : "off",
+                 occlusion_visible(&g_occlusion),
+                 g_config.backend == BACKEND_WINDOW ? "window" : "root",
+                 power_state_name(power_state(&g_power)),
+                 ready,
+                 num_pipelines,
+                 session_frame_period_us(st->ds),
+                 updates,
+                 damages,
+                 mem_rss_bytes() / 1024,
+                 memwatch_source_name(&g_memwatch),
+                 memwatch_events(&g_memwatch),
+                 governor_budget(),
+                 governor_quality(),
+                 governor_fps_percent());
+
+        for (int i = 0; i < NUM_SLOTS && n > 0 && (size_t)n < replylen; i++) {
+                Worker_Data *p = st->slots[i];
+                if (!p) continue;
+                n += snprintf(reply + n, replylen - n,
+                              "output.%d.wp=%s\n"
+                              "output.%d.mode=%s\n"
+                              "output.%d.fps=%d\n"
+                              "output.%d.live_fps=%d\n"
+                              "output.%d.paused=%u\n",
+                              p->mon, p->wp ? p->wp : "",
+                              p->mon, p->mode == MODE_LOAD ? "load" : "stream",
+                              p->mon, p->fps,
+                              p->mon, playback_fps(&p->pb),
+                              p->mon, playback_paused(&p->pb));
+        }
+}
 
-                if (sleep_time > 0) {
-                        usleep(sleep_time);
+static void handle_client_msg(Daemon_State *st, int fd, Ipc_Msg *msg) {
+        static char reply[IPC_MAX_PAYLOAD];
+        char *argv[IPC_MAX_ARGS];
+        int status = 0;
+
+        reply[0] = '\0';
+        pthread_mutex_lock(&st->mutex);
+        switch (msg->hdr.type) {
+        case IPC_CMD_SET: {
+                int argc = ipc_split_args(msg, argv, IPC_MAX_ARGS);
+                if (argc < 0) {
+                        snprintf(reply, sizeof(reply), "too many arguments, at most %d are accepted", IPC_MAX_ARGS - 1);
+                        log_error("Control: rejected SET with more than %d arguments", IPC_MAX_ARGS - 1);
+                        status = 1;
+                        break;
                 }
+                log_info("Control: SET with %d argument(s)", argc > 0 ? argc - 1 : 0);
+                status = handle_set(st, argc, argv, reply, sizeof(reply)) < 0;
+        } break;
+        case IPC_CMD_STATUS:
+                handle_status(st, reply, sizeof(reply));
+                break;
+        case IPC_CMD_STATS:
+                stats_format(reply, sizeof(reply));
+                if (!strcmp(msg->payload, "reset")) {
+                        stats_reset();
+                }
+                break;
+        default:
+                snprintf(reply, sizeof(reply), "unknown command %u", (unsigned)msg->hdr.type);
+                status = 1;
+                break;
+        }
+        pthread_mutex_unlock(&st->mutex);
 
-                printf("Displayed frame %d (processing: %ld us, sleep: %ld us)\n",
-                       frame_count, processing_time, sleep_time > 0 ? sleep_time : 0);
-                fflush(stdout);
-                printf("\033[A");
-                printf("\033[2K");
-
+        if (ipc_send(fd, IPC_REPLY, (uint16_t)status, reply, strlen(reply)) < 0) {
+                log_error("Control: failed to reply: %s", strerror(errno));
         }
-        return NULL;
 }
 
-void *fifo_reader_thread(void *arg) {
-        Worker_Data *wd = (Worker_Data *)arg;
-        FILE *fifo = fopen(FIFO_PATH, "r");
-        if (!fifo) {
-                syslog(LOG_ERR, "Failed to open FIFO %s for reading: %s", FIFO_PATH, strerror(errno));
-                exit(EXIT_FAILURE);
+// Serves the control socket. Every client may send any number of
+// requests and gets exactly one reply per request.
+void *control_thread(void *arg) {
+        Daemon_State *st = (Daemon_State *)arg;
+        stats_thread_start("control");
+        Ipc_Msg *msg = (Ipc_Msg *)malloc(sizeof(Ipc_Msg));
+        if (!msg) {
+                log_error("Control: failed to allocate message buffer");
+                return NULL;
         }
 
-        char buf[256];
+        // The socket, the stop pipe, then the clients
+        struct pollfd fds[CONTROL_MAX_CLIENTS + 2];
+        int nfds = 2;
+        fds[0].fd = st->listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = st->stop_fd[0];
+        fds[1].events = POLLIN;
+
         while (1) {
-                if (fgets(buf, sizeof(buf), fifo)) {
-                        syslog(LOG_INFO, "FIFO reader: Received message: %s", buf);
-                        parse_daemon_sender_msg(buf);
+                if (poll(fds, nfds, -1) < 0) {
+                        if (errno == EINTR) continue;
+                        log_error("Control: poll(): %s", strerror(errno));
+                        break;
+                }
 
-                        pthread_mutex_lock(&wd->mutex);
-                        if (g_config.wp && (!wd->wp || strcmp(g_config.wp, wd->wp) != 0 || g_config.mon != wd->mon || g_config.mode != wd->mode || g_config.maxmem != wd->maxmem || g_config.fps != wd->fps)) {
-                                if (wd->running) {
-                                        syslog(LOG_INFO, "FIFO reader: Stopping existing worker");
-                                        wd->stop = 1;
-                                        if (wd->mode == MODE_STREAM && wd->td) {
-                                                pthread_mutex_lock(&wd->td->threading.mutex);
-                                                wd->td->done = 1;
-                                                pthread_cond_broadcast(&wd->td->threading.not_empty);
-                                                pthread_cond_broadcast(&wd->td->threading.not_full);
-                                                pthread_mutex_unlock(&wd->td->threading.mutex);
-                                        }
-                                        while (wd->running) {
-                                                pthread_cond_wait(&wd->cond, &wd->mutex);
-                                        }
-                                        if (wd->thread) {
-                                                pthread_join(wd->thread, NULL);
-                                                wd->thread = 0;
-                                        }
-                                }
+                if (fds[1].revents) break;
 
-                                // Update worker configuration
-                                if (wd->wp) free(wd->wp);
-                                wd->wp = g_config.wp ? strdup(resolve(g_config.wp)) : NULL;
-                                wd->mon = g_config.mon;
-                                wd->mode = g_config.mode;
-                                wd->maxmem = g_config.maxmem;
-                                wd->stop = 0;
-
-                                if (wd->wp) {
-                                        wd->running = 1;
-                                        if (pthread_create(&wd->thread, NULL, worker_thread, wd) != 0) {
-                                                syslog(LOG_ERR, "Failed to create worker thread");
-                                                wd->running = 0;
-                                        } else {
-                                                syslog(LOG_INFO, "FIFO reader: Started new worker with wp=%s, mon=%d, mode=%d", wd->wp, wd->mon, (int)wd->mode);
-                                                write_config_file();
-                                        }
-                                }
+                for (int i = nfds - 1; i >= 2; --i) {
+                        if (!fds[i].revents) continue;
+                        int r = (fds[i].revents & POLLIN) ? ipc_recv(fds[i].fd, msg) : 0;
+                        if (r > 0) {
+                                handle_client_msg(st, fds[i].fd, msg);
+                        } else {
+                                close(fds[i].fd);
+                                fds[i] = fds[--nfds];
                         }
-                        pthread_mutex_unlock(&wd->mutex);
-                } else {
-                        fclose(fifo);
-                        fifo = fopen(FIFO_PATH, "r");
-                        if (!fifo) {
-                                syslog(LOG_ERR, "Failed to reopen FIFO %s: %s", FIFO_PATH, strerror(errno));
-                                exit(EXIT_FAILURE);
+                }
+
+                if (fds[0].revents & POLLIN) {
+                        int fd = accept(st->listen_fd, NULL, NULL);
+                        if (fd < 0) {
+                                log_error("Control: accept(): %s", strerror(errno));
+                        } else if (nfds > CONTROL_MAX_CLIENTS + 1) {
+                                log_error("Control: too many clients, dropping one");
+                                close(fd);
+                        } else {
+                                fds[nfds].fd = fd;
+                                fds[nfds].events = POLLIN;
+                                fds[nfds].revents = 0;
+                                nfds++;
                         }
                 }
         }
 
-        fclose(fifo);
+        for (int i = 2; i < nfds; ++i) {
+                close(fds[i].fd);
+        }
+        free(msg);
         return NULL;
 }
 
@@ -694,13 +1905,14 @@ static void cleanup_thread_data(Thread_Data *td) {
         pthread_cond_destroy(&td->threading.not_empty);
 }
 
-int run_stream(int monitor_index, const char *video_mp4) {
+int run_stream(Display_Session *ds, int monitor_index, const char *video_mp4) {
         Worker_Data *wd = get_worker_data(); // May be NULL in non-daemon mode
         int is_daemon = g_config.flags | FT_DAEMON;
-        syslog(LOG_INFO, "run_stream()\n");
+        log_info("run_stream()");
         Context ctx = {0};
-        if (init_context(&ctx, monitor_index, video_mp4) < 0) {
-                syslog(LOG_ERR, "init context failed");
+        ctx.sink = &g_sink;
+        if (init_context(&ctx, ds, monitor_index, video_mp4) < 0) {
+                log_error("init context failed");
                 cleanup_context(&ctx);
                 return -1;
         }
@@ -714,14 +1926,8 @@ int run_stream(int monitor_index, const char *video_mp4) {
                         if (ctx.packet->stream_index == ctx.video_stream_idx) {
                                 if (avcodec_send_packet(ctx.codec_ctx, ctx.packet) >= 0) {
                                         while (avcodec_receive_frame(ctx.codec_ctx, ctx.frame) >= 0) {
-                                                sws_scale(ctx.sws_ctx, (const uint8_t * const *)ctx.frame->data, ctx.frame->linesize, 0, ctx.codec_ctx->height,
-                                                          ctx.bgra_frame->data, ctx.bgra_frame->linesize);
-                                                if (display_frame(&ctx, ctx.bgra_buffer, ctx.monitor_width, ctx.monitor_height, frame_count) < 0) {
-                                                        syslog(LOG_ERR, "Failed to display single frame");
-                                                        fprintf(stderr, "Failed to display single frame\n");
-                                                } else {
-                                                        printf("Displayed single frame\n");
-                                                }
+                                                context_scale_frame(&ctx);
+                                                present_single_frame(&ctx, frame_count);
                                                 frame_count++;
                                                 break; // Only process one frame
                                         }
@@ -736,11 +1942,11 @@ int run_stream(int monitor_index, const char *video_mp4) {
         // Multi-frame logic
         Thread_Data td = {0};
         td.ctx = &ctx;
+        td.pb = wd ? &wd->pb : &g_playback;
         td.buffer_size = 2;
         td.buffer = (Image *)malloc(td.buffer_size * sizeof(Image));
         if (!td.buffer) {
-                syslog(LOG_ERR, "Failed to allocate thread buffer\n");
-                fprintf(stderr, "Failed to allocate thread buffer\n");
+                log_error("Failed to allocate thread buffer");
                 cleanup_context(&ctx);
                 return -1;
         }
@@ -756,13 +1962,35 @@ int run_stream(int monitor_index, const char *video_mp4) {
         if (is_daemon && wd) {
                 pthread_mutex_lock(&wd->mutex);
                 wd->td = &td;
+                td.done = wd->stop;
                 pthread_mutex_unlock(&wd->mutex);
         }
 
         pthread_t producer, consumer;
         if (pthread_create(&producer, NULL, producer_thread, &td) != 0) {
-                syslog(LOG_ERR, "Failed to create producer thread\n");
-                fprintf(stderr, "Failed to create producer thread\n");
+                log_error("Failed to create producer thread");
+                if (is_daemon && wd) {
+                        pthread_mutex_lock(&wd->mutex);
+                        wd->td = NULL;
+                        pthread_mutex_unlock(&wd->mutex);
+                }
+                cleanup_thread_data(&td);
+                cleanup_context(&ctx);
+                return -1;
+        }
+
+        // Pre-roll: let the producer fill the ring before anything is
+        // presented, so the previous worker stays on screen meanwhile.
+        pthread_mutex_lock(&td.threading.mutex);
+        while (td.count < td.buffer_size && !td.done) {
+                pthread_cond_wait(&td.threading.not_empty, &td.threading.mutex);
+        }
+        int preroll_ok = td.count > 0;
+        td.done |= !preroll_ok;
+        pthread_cond_broadcast(&td.threading.not_full);
+        pthread_mutex_unlock(&td.threading.mutex);
+        if (!preroll_ok) {
+                pthread_join(producer, NULL);
                 if (is_daemon && wd) {
                         pthread_mutex_lock(&wd->mutex);
                         wd->td = NULL;
@@ -772,9 +2000,12 @@ int run_stream(int monitor_index, const char *video_mp4) {
                 cleanup_context(&ctx);
                 return -1;
         }
-        if (pthread_create(&consumer, NULL, consumer_thread, &td) != 0) {
-                syslog(LOG_ERR, "Failed to create consumer thread\n");
-                fprintf(stderr, "Failed to create consumer thread\n");
+        int ready = worker_ready(&ctx);
+
+        if (ready < 0 || pthread_create(&consumer, NULL, consumer_thread, &td) != 0) {
+                if (ready == 0) {
+                        log_error("Failed to create consumer thread");
+                }
                 td.done = 1;
                 pthread_cond_broadcast(&td.threading.not_empty);
                 pthread_join(producer, NULL);
@@ -785,7 +2016,7 @@ int run_stream(int monitor_index, const char *video_mp4) {
                 }
                 cleanup_thread_data(&td);
                 cleanup_context(&ctx);
-                return -1;
+                return ready < 0 ? 0 : -1;
         }
 
         pthread_join(producer, NULL);
@@ -802,6 +2033,113 @@ int run_stream(int monitor_index, const char *video_mp4) {
         return 0; // Multi-frame case
 }
 
+// Moves the bench source on by one unit of work: a video packet when
+// only demuxing, a decoded frame otherwise. Starts over at the end of
+// the file, and gives up if a whole pass yields nothing.
+static int bench_advance(Context *ctx, unsigned stages) {
+        long decode_us = 0;
+        if ((stages & BENCH_DECODE) && receive_frame_timed(ctx, &decode_us) >= 0) {
+                stats_record(STAGE_DECODE, decode_us);
+                return 0;
+        }
+        int rewinds = 0;
+        for (;;) {
+                if (read_packet_timed(ctx) < 0) {
+                        av_packet_unref(ctx->packet);
+                        avcodec_flush_buffers(ctx->codec_ctx);
+                        if (++rewinds > 1
+                            || avformat_seek_file(ctx->fmt_ctx, ctx->video_stream_idx, INT64_MIN, 0, INT64_MAX, 0) < 0) {
+                                fprintf(stderr, "No video %s left to benchmark\n", stages & BENCH_DECODE ? "frames" : "packets");
+                                return -1;
+                        }
+                        continue;
+                }
+                if (ctx->packet->stream_index != ctx->video_stream_idx) {
+                        av_packet_unref(ctx->packet);
+                        continue;
+                }
+                if (!(stages & BENCH_DECODE)) {
+                        av_packet_unref(ctx->packet);
+                        return 0;
+                }
+                int sent = send_packet_timed(ctx, &decode_us);
+                av_packet_unref(ctx->packet);
+                if (sent >= 0 && receive_frame_timed(ctx, &decode_us) >= 0) {
+                        stats_record(STAGE_DECODE, decode_us);
+                        return 0;
+                }
+        }
+}
+
+// --bench: runs the enabled stages back to back, or paced at `opts->fps`,
+// for `opts->seconds` and reports on `out`. BENCH_PRESENT hands frames
+// to --sink, only SINK_X11 opens a display.
+static int run_bench(Display_Session *ds, const Bench_Options *opts, FILE *out) {
+        Bench_Result res = {0};
+        res.launch_us = get_time_us();
+        Context ctx = {0};
+        ctx.sink = &g_sink;
+        int present = opts->stages & BENCH_PRESENT;
+        int rc = present ? init_context(&ctx, ds, g_config.mon, opts->file)
+                         : init_context_headless(&ctx, g_sink.width, g_sink.height, opts->file);
+        if (rc < 0) {
+                cleanup_context(&ctx);
+                return -1;
+        }
+
+        // Stages that are off produce their output once, up front
+        unsigned once = 0;
+        if (opts->stages & (BENCH_SCALE | BENCH_PRESENT)) once |= BENCH_DEMUX | BENCH_DECODE;
+        if (opts->stages & BENCH_PRESENT) once |= BENCH_SCALE;
+        once &= ~opts->stages;
+        if ((once & BENCH_DECODE) && bench_advance(&ctx, BENCH_DEMUX | BENCH_DECODE) < 0) {
+                cleanup_context(&ctx);
+                return -1;
+        }
+        if (once & BENCH_SCALE) {
+                context_scale_frame(&ctx);
+        }
+
+        Playback pb;
+        playback_init(&pb, opts->fps > 0 ? opts->fps : 1);
+        int done = 0;
+
+        res.width = ctx.surfaces[0].width;
+        res.height = ctx.surfaces[0].height;
+        bench_begin(&res);
+        long end_us = res.start_us + opts->seconds * 1000000L;
+        while (get_time_us() < end_us) {
+                long start_time = get_time_us();
+                if ((opts->stages & BENCH_DEMUX) && bench_advance(&ctx, opts->stages) < 0) {
+                        rc = -1;
+                        break;
+                }
+                if (opts->stages & BENCH_SCALE) {
+                        context_scale_frame(&ctx);
+                } else if (present) {
+                        forget_last_frame(&ctx); // The same frame again, upload it in full
+                }
+                if (present && display_frame(&ctx, ctx.bgra_buffer, NULL, (int)res.frames) < 0) {
+                        rc = -1;
+                        break;
+                }
+                bench_frame_done(&res, start_time);
+                if (opts->fps > 0) {
+                        check_late(&pb, start_time);
+                        long sleep_start = trace_start();
+                        playback_wait(&pb, start_time, &done);
+                        trace_end(TRACE_SLEEP, sleep_start, (long)res.frames);
+                }
+        }
+        bench_end(&res);
+
+        cleanup_context(&ctx);
+        if (rc == 0) {
+                bench_report(out, opts, &res);
+        }
+        return rc;
+}
+
 static void daemonize(void) {
         pid_t pid, sid;
 
@@ -881,21 +2219,50 @@ static void daemonize(void) {
         // Note: don't close pid_fd; keep it open to hold the lock
 }
 
-static void signal_handler(int sig) {
-        if (sig == SIGTERM) {
-                syslog(LOG_INFO, "Received SIGTERM, shutting down.");
-                syslog(LOG_INFO, "Writing config file.");
-                write_config_file();
-                closelog();
+// Signals are taken by a thread of their own instead of a handler, so
+// shutting down may take locks and wait for other threads. The signal
+// is blocked with block_signal() before the first thread is created,
+// and every thread inherits that.
+static sigset_t g_signals;
+
+static void block_signal(int sig) {
+        sigemptyset(&g_signals);
+        sigaddset(&g_signals, sig);
+        pthread_sigmask(SIG_BLOCK, &g_signals, NULL);
+}
 
-                unlink(PID_PATH);
-                unlink(FIFO_PATH);
-                if (g_pid_fd >= 0) {
-                        close(g_pid_fd);
+// With the daemon's state it only ends the control thread, the daemon
+// then shuts down in daemon_loop(). Without, it ends a traced run.
+static void *signal_thread(void *arg) {
+        Daemon_State *st = (Daemon_State *)arg;
+        stats_thread_start("signals");
+        int sig;
+        while (sigwait(&g_signals, &sig) != 0) {
+                // Only fails for an invalid set
+        }
+        if (st) {
+                log_info("Received SIGTERM, shutting down");
+                if (write(st->stop_fd[1], "x", 1) < 0) {
+                        log_error("Failed to stop the control thread: %s", strerror(errno));
                 }
+                return NULL;
+        }
+        // Nothing decodes or presents once paused, so the trace is quiet
+        playback_pause(&g_playback, PAUSE_USER);
+        trace_close();
+        stats_threads_log_stop();
+        log_stop();
+        exit(0);
+}
 
-                exit(0);
+static int start_signal_thread(Daemon_State *st) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, signal_thread, st) != 0) {
+                log_error("Failed to create the signal thread");
+                return -1;
         }
+        pthread_detach(thread);
+        return 0;
 }
 
 static void stop_daemon(void) {
@@ -951,190 +2318,330 @@ static void usage(void) {
         printf("    -%c, --%s              show version information\n", FLAG_1HY_VERSION, FLAG_2HY_VERSION);
         printf("    -%c, --%s               start the daemon\n", FLAG_1HY_DAEMON, FLAG_2HY_DAEMON);
         printf("        --%s=<int>            set the display monitor or (-1) to combine all monitors, or (-2) to mirror on all monitors\n", FLAG_2HY_MON);
+        printf("                             the daemon keeps a separate wallpaper, fps and mode per monitor\n");
         printf("        --%s=<stream|load>   set the frame generation mode\n", FLAG_2HY_MODE);
         printf("        --%s=<float>       set a maximum memory limit for --mode=load\n", FLAG_2HY_MAXMEM);
         printf("        --%s=<int>            set the FPS\n", FLAG_2HY_FPS);
         printf("        --%s                 stop the running the daemon\n", FLAG_2HY_STOP);
+        printf("        --%s               print what the running daemon is doing\n", FLAG_2HY_STATUS);
+        printf("        --%s[=reset]        print per-stage latency percentiles, frame counters and per-thread CPU use\n", FLAG_2HY_STATS);
+        printf("        --%s=<int>    log per-thread CPU time, context switches and page faults every <int> seconds\n", FLAG_2HY_THREADSTATS);
+        printf("        --%s=<float>   hold CPU use to this percent of one core by lowering quality, then fps\n", FLAG_2HY_CPUBUDGET);
+        printf("        --%s[=<int>]        run the pipeline for this many seconds (default 10) and print JSON results\n", FLAG_2HY_BENCH);
+        printf("        --%s=<list>        stages --bench runs: demux,decode,scale,present (default demux,decode,scale)\n", FLAG_2HY_STAGES);
+        printf("        --%s=<x11|null|dump:<dir>[:<n>,...]>  send frames to the screen, nowhere, or to PPM files\n", FLAG_2HY_SINK);
+        printf("        --%s=<level>     error, warn, info (default) or debug; per-frame messages are debug\n", FLAG_2HY_LOGLEVEL);
+        printf("        --%s=<file>         record what every thread does as a Chrome/Perfetto trace\n", FLAG_2HY_TRACE);
+        printf("        --%s=<w>x<h>         size frames are scaled to without a display (default the video size)\n", FLAG_2HY_SIZE);
+        printf("        --%s                freeze the wallpaper (daemon only)\n", FLAG_2HY_PAUSE);
+        printf("        --%s               continue after --pause\n", FLAG_2HY_RESUME);
+        printf("        --%s[=<int>]         show the next frame(s) while paused\n", FLAG_2HY_STEP);
+        printf("        --%s=<on|off>   pause while windows cover the wallpaper (daemon only, default on)\n", FLAG_2HY_OCCLUSION);
+        printf("        --%s=<int>           seconds without input before --idlefps applies, 0 to disable (daemon only)\n", FLAG_2HY_IDLE);
+        printf("        --%s=<int>        fps while idle, 0 freezes the current frame\n", FLAG_2HY_IDLEFPS);
+        printf("        --%s=<root|window> draw on the root background or on desktop windows (compositor friendly)\n", FLAG_2HY_BACKEND);
         printf("        --%s              restore the last configuration used\n", FLAG_2HY_RESTORE);
         printf("        --%s              see COPYING information\n", FLAG_2HY_COPYING);
+        printf("        --%s=<dir|file>  rotate through a playlist (daemon only)\n", FLAG_2HY_PLAYLIST);
+        printf("        --%s=<int>       set the seconds each playlist entry is shown\n", FLAG_2HY_INTERVAL);
+        printf("        --%s=<sequential|shuffle>  set the playlist order\n", FLAG_2HY_ORDER);
+        printf("        --%s=<int>           crossfade between wallpapers for this many milliseconds\n", FLAG_2HY_FADE);
+}
+
+// Resolves `path` relative to the client's working directory.
+static char *resolve_from(const char *cwd, const char *path) {
+        if (path[0] == '/' || !cwd || !cwd[0]) {
+                return resolve(path);
+        }
+        char fp[PATH_MAX] = {0};
+        snprintf(fp, sizeof(fp), "%s/%s", cwd, path);
+        return resolve(fp);
 }
 
-static void parse_daemon_sender_msg(const char *msg) {
-        while (*msg) {
-                if (*msg == ' ' || *msg == '\n') {
-                        ++msg;
+#define DAEMON_ARG_ERR(...)                                             \
+        do {                                                            \
+                snprintf(err, errlen, __VA_ARGS__);                     \
+                syslog(LOG_ERR, "%s", err);                             \
+                return -1;                                              \
+        } while (0)
+
+// Applies the flags a client sent to the daemon. With `apply` unset the
+// arguments are only validated, so a bad message never leaves g_config
+// half-updated and never takes the daemon down. Returns a mask of MSG_*
+// or -1 with a description in `err`.
+static int parse_daemon_args(int argc, char **argv, const char *cwd, int apply, int *steps, char *err, size_t errlen) {
+        int changed = 0;
+        for (int i = 0; i < argc; ++i) {
+                const char *arg = argv[i];
+                if (arg[0] != '-') {
+                        char *rp = resolve_from(cwd, arg);
+                        if (!rp[0]) {
+                                DAEMON_ARG_ERR("cannot resolve wallpaper `%s`", arg);
+                        }
+                        if (apply) {
+                                if (g_config.wp) free(g_config.wp);
+                                g_config.wp = strdup(rp);
+                                syslog(LOG_INFO, "fp: %s", g_config.wp);
+                        }
+                        changed |= MSG_WP;
                         continue;
                 }
-                if (*msg == '-' && msg[1] == '-') {
-                        msg += 2;
-                        char buf[256] = {0};
-                        size_t blen = 0;
-                        while (*msg && *msg != ' ' && *msg != '\n' && blen < sizeof(buf) - 1) {
-                                buf[blen++] = *msg++;
-                        }
-                        buf[blen] = '\0';
-                        char cmd[256] = {0};
-                        size_t cmd_end = 0;
-                        int iseq = 0;
-                        for (cmd_end = 0; cmd_end < blen; ++cmd_end) {
-                                if (buf[cmd_end] == '=' || buf[cmd_end] == ' ') {
-                                        iseq = buf[cmd_end] == '=';
-                                        break;
-                                }
+
+                const char *cmd_start = arg + (arg[1] == '-' ? 2 : 1);
+                const char *eq = strchr(cmd_start, '=');
+                char cmd[64] = {0};
+                size_t cmd_len = eq ? (size_t)(eq - cmd_start) : strlen(cmd_start);
+                if (cmd_len >= sizeof(cmd)) cmd_len = sizeof(cmd) - 1;
+                memcpy(cmd, cmd_start, cmd_len);
+                const char *rest = eq ? eq + 1 : NULL;
+
+                if (!strcmp(cmd, FLAG_2HY_DAEMON) || (arg[1] != '-' && cmd[0] == FLAG_1HY_DAEMON && !cmd[1])) {
+                        continue; // Already running
+                } else if (!strcmp(cmd, FLAG_2HY_RESTORE)) {
+                        continue; // The client applied the saved config itself
+                } else if (!strcmp(cmd, FLAG_2HY_PAUSE)) {
+                        changed |= MSG_PAUSE;
+                        continue;
+                } else if (!strcmp(cmd, FLAG_2HY_RESUME)) {
+                        changed |= MSG_RESUME;
+                        continue;
+                } else if (!strcmp(cmd, FLAG_2HY_STEP)) {
+                        if (rest && (!str_isdigit(rest) || atoi(rest) <= 0)) {
+                                DAEMON_ARG_ERR("option `%s` expects a positive number, got `%s`", cmd, rest);
                         }
-                        memcpy(cmd, buf, cmd_end);
-                        cmd[cmd_end] = '\0';
-                        char *rest = &buf[cmd_end + (iseq ? 1 : 0)];
-                        // Trim trailing spaces from rest
-                        size_t rest_len = strlen(rest);
-                        while (rest_len > 0 && rest[rest_len - 1] == ' ') {
-                                rest[--rest_len] = '\0';
-                        }
-                        syslog(LOG_INFO, "cmd: %s", cmd);
-                        syslog(LOG_INFO, "rest: %s", rest);
-                        if (!strcmp(cmd, "mode")) {
-                                if (!iseq) {
-                                        syslog(LOG_ERR, "option `%s` requires equals (=)", cmd);
-                                        err_wargs("option `%s` requires equals (=)", cmd);
-                                }
-                                if (!strcmp(rest, "stream")) {
-                                        g_config.mode = MODE_STREAM;
-                                        syslog(LOG_INFO, "set mode to STREAM %s", cmd);
-                                } else if (!strcmp(rest, "load")) {
-                                        g_config.mode = MODE_LOAD;
-                                        syslog(LOG_INFO, "set mode to LOAD %s", cmd);
-                                } else {
-                                        syslog(LOG_ERR, "unknown mode `%s`", rest);
-                                        err_wargs("unknown mode `%s`", rest);
-                                }
-                        } else if (!strcmp(cmd, "mon")) {
-                                if (!iseq) {
-                                        syslog(LOG_ERR, "option `%s` requires equals (=)", cmd);
-                                        err_wargs("option `%s` requires equals (=)", cmd);
-                                }
-                                if (!str_isdigit(rest)) {
-                                        syslog(LOG_ERR, "option `%s` expects a number, got `%s`", cmd, rest);
-                                        err_wargs("option `%s` expects a number, got `%s`", cmd, rest);
-                                }
-                                g_config.mon = atoi(rest);
-                                syslog(LOG_INFO, "set monitor to %d", g_config.mon);
-                        } else if (!strcmp(cmd, "fps")) {
-                                if (!iseq) {
-                                        syslog(LOG_ERR, "option `%s` requires equals (=)", cmd);
-                                        err_wargs("option `%s` requires equals (=)", cmd);
-                                }
-                                if (!str_isdigit(rest)) {
-                                        syslog(LOG_ERR, "option `%s` expects a number, got `%s`", cmd, rest);
-                                        err_wargs("option `%s` expects a number, got `%s`", cmd, rest);
-                                }
-                                g_config.fps = atoi(rest);
-                                syslog(LOG_INFO, "set fps to %d", g_config.fps);
-                        } else if (!strcmp(cmd, "maxmem")) {
-                                if (!iseq) {
-                                        syslog(LOG_ERR, "option `%s` requires equals (=)", cmd);
-                                        err_wargs("option `%s` requires equals (=)", cmd);
-                                }
-                                if (!str_isdigit(rest)) {
-                                        syslog(LOG_ERR, "option `%s` expects a number, got `%s`", cmd, rest);
-                                        err_wargs("option `%s` expects a float, got `%s`", cmd, rest);
-                                }
+                        if (apply) *steps += rest ? atoi(rest) : 1;
+                        changed |= MSG_STEP;
+                        continue;
+                }
+
+                if (!rest) {
+                        DAEMON_ARG_ERR("option `%s` requires equals (=)", cmd);
+                }
+
+                if (!strcmp(cmd, FLAG_2HY_MODE)) {
+                        int mode;
+                        if (!strcmp(rest, "stream")) {
+                                mode = MODE_STREAM;
+                        } else if (!strcmp(rest, "load")) {
+                                mode = MODE_LOAD;
+                        } else {
+                                DAEMON_ARG_ERR("unknown mode `%s`", rest);
+                        }
+                        if (apply) g_config.mode = mode;
+                        changed |= MSG_MODE;
+                } else if (!strcmp(cmd, FLAG_2HY_MON)) {
+                        if (!str_isdigit(rest) || slot_index(atoi(rest)) < 0) {
+                                DAEMON_ARG_ERR("option `%s` expects -2, -1 or an output below %d, got `%s`", cmd, MAX_OUTPUTS, rest);
+                        }
+                        if (apply) g_config.mon = atoi(rest);
+                        changed |= MSG_MON;
+                } else if (!strcmp(cmd, FLAG_2HY_FPS)) {
+                        if (!str_isdigit(rest) || atoi(rest) <= 0) {
+                                DAEMON_ARG_ERR("option `%s` expects a positive number, got `%s`", cmd, rest);
+                        }
+                        if (apply) g_config.fps = atoi(rest);
+                        changed |= MSG_FPS;
+                } else if (!strcmp(cmd, FLAG_2HY_MAXMEM)) {
+                        if (!str_isdigit(rest)) {
+                                DAEMON_ARG_ERR("option `%s` expects a float, got `%s`", cmd, rest);
+                        }
+                        if (apply) {
                                 g_config.maxmem = strtod(rest, NULL);
                                 g_config.flags |= FT_MAXMEM;
-                                syslog(LOG_INFO, "set fps to %f", g_config.maxmem);
                         }
-                        else {
-                                syslog(LOG_ERR, "Unknown option: %s", cmd);
-                                err_wargs("Unknown  option: %s", cmd);
+                        changed |= MSG_MAXMEM;
+                } else if (!strcmp(cmd, FLAG_2HY_PLAYLIST)) {
+                        char *rp = resolve_from(cwd, rest);
+                        if (!rp[0]) {
+                                DAEMON_ARG_ERR("cannot resolve playlist `%s`", rest);
                         }
-                } else {
-                        char buf[256] = {0};
-                        size_t blen = 0;
-                        while (*msg && *msg != ' ' && *msg != '\n' && blen < sizeof(buf) - 1) {
-                                buf[blen++] = *msg++;
+                        if (apply) {
+                                if (g_config.playlist) free(g_config.playlist);
+                                g_config.playlist = strdup(rp);
                         }
-                        buf[blen] = '\0';
-                        // Trim trailing spaces from buf
-                        while (blen > 0 && buf[blen - 1] == ' ') {
-                                buf[--blen] = '\0';
+                        changed |= MSG_PLAYLIST;
+                } else if (!strcmp(cmd, FLAG_2HY_INTERVAL)) {
+                        if (!str_isdigit(rest) || atoi(rest) <= 0) {
+                                DAEMON_ARG_ERR("option `%s` expects a positive number, got `%s`", cmd, rest);
                         }
-                        if (g_config.wp) {
-                                free(g_config.wp);
+                        if (apply) g_config.interval = atoi(rest);
+                } else if (!strcmp(cmd, FLAG_2HY_ORDER)) {
+                        int order;
+                        if (!strcmp(rest, "sequential")) {
+                                order = ORDER_SEQUENTIAL;
+                        } else if (!strcmp(rest, "shuffle")) {
+                                order = ORDER_SHUFFLE;
+                        } else {
+                                DAEMON_ARG_ERR("unknown order `%s`", rest);
+                        }
+                        if (apply) g_config.order = order;
+                        if (g_config.playlist) changed |= MSG_PLAYLIST;
+                } else if (!strcmp(cmd, FLAG_2HY_FADE)) {
+                        if (!str_isdigit(rest) || atoi(rest) < 0) {
+                                DAEMON_ARG_ERR("option `%s` expects a number, got `%s`", cmd, rest);
+                        }
+                        if (apply) g_config.fade = atoi(rest);
+                } else if (!strcmp(cmd, FLAG_2HY_OCCLUSION)) {
+                        int occlusion;
+                        if (!strcmp(rest, "on")) {
+                                occlusion = 1;
+                        } else if (!strcmp(rest, "off")) {
+                                occlusion = 0;
+                        } else {
+                                DAEMON_ARG_ERR("option `%s` expects either `on` or `off`, got `%s`", cmd, rest);
+                        }
+                        if (apply) g_config.occlusion = occlusion;
+                } else if (!strcmp(cmd, FLAG_2HY_IDLE)) {
+                        if (!str_isdigit(rest) || atoi(rest) < 0) {
+                                DAEMON_ARG_ERR("option `%s` expects a number of seconds, got `%s`", cmd, rest);
+                        }
+                        if (apply) g_config.idle = atoi(rest);
+                } else if (!strcmp(cmd, FLAG_2HY_IDLEFPS)) {
+                        if (!str_isdigit(rest) || atoi(rest) < 0) {
+                                DAEMON_ARG_ERR("option `%s` expects a number, got `%s`", cmd, rest);
+                        }
+                        if (apply) g_config.idle_fps = atoi(rest);
+                } else if (!strcmp(cmd, FLAG_2HY_BACKEND)) {
+                        int backend;
+                        if (!strcmp(rest, "root")) {
+                                backend = BACKEND_ROOT;
+                        } else if (!strcmp(rest, "window")) {
+                                backend = BACKEND_WINDOW;
+                        } else {
+                                DAEMON_ARG_ERR("option `%s` expects either `root` or `window`, got `%s`", cmd, rest);
                         }
-                        g_config.wp = strdup(resolve(buf));
-                        syslog(LOG_INFO, "fp: %s", g_config.wp ? g_config.wp : "(null)");
+                        if (apply) g_config.backend = backend;
+                        changed |= MSG_BACKEND;
+                } else if (!strcmp(cmd, FLAG_2HY_THREADSTATS)) {
+                        if (!str_isdigit(rest) || atoi(rest) < 0) {
+                                DAEMON_ARG_ERR("option `%s` expects a number of seconds, got `%s`", cmd, rest);
+                        }
+                        if (apply) {
+                                g_threadstats = atoi(rest);
+                                stats_threads_log_stop();
+                                if (g_threadstats > 0) stats_threads_log_start(g_threadstats);
+                        }
+                } else if (!strcmp(cmd, FLAG_2HY_CPUBUDGET)) {
+                        double budget;
+                        if (governor_parse_budget(rest, &budget) < 0) {
+                                DAEMON_ARG_ERR("option `%s` expects a percentage of one core, got `%s`", cmd, rest);
+                        }
+                        if (apply) g_cpu_budget = budget;
+                } else {
+                        DAEMON_ARG_ERR("unknown option `%s`", cmd);
                 }
+                if (apply) syslog(LOG_INFO, "set %s to %s", cmd, rest);
         }
+        return changed;
 }
 
+#undef DAEMON_ARG_ERR
+
 static void daemon_loop(void) {
         printf("starting daemon, do `tail -f /var/log/syslog` to see logging\n");
 
         daemonize();
         openlog("AnimX", LOG_PID | LOG_CONS, LOG_DAEMON);
-        signal(SIGTERM, signal_handler);
+        block_signal(SIGTERM);
+        log_start(0);
+        stats_thread_start("main");
+        if (g_threadstats > 0) stats_threads_log_start(g_threadstats);
+
+        init_thread_specific();
+        static Display_Session ds = DISPLAY_SESSION_INIT;
+        static Daemon_State st = {
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .ds = &ds,
+                .slots = {NULL},
+                .pause_mask = 0,
+                .fps_cap = 0,
+                .playlist_mon = -2,
+                .next_switch_us = 0,
+                .paused_at_us = 0,
+        };
+        init_monotonic_cond(&st.cond);
+
+        st.listen_fd = ipc_listen(IPC_SOCK_PATH);
+        if (st.listen_fd < 0) {
+                log_error("Failed to create control socket %s: %s", IPC_SOCK_PATH, strerror(errno));
+                log_stop();
+                closelog();
+                exit(EXIT_FAILURE);
+        }
 
-        unlink(FIFO_PATH);
-        if (mkfifo(FIFO_PATH, 0666) < 0) {
-                syslog(LOG_ERR, "Failed to create FIFO %s: %s", FIFO_PATH, strerror(errno));
+        if (memwatch_start(&g_memwatch, memory_pressure, &st) < 0) {
+                log_info("Memwatch: unavailable, load mode keeps its frames under memory pressure");
         }
+        if (g_cpu_budget > 0) governor_set_budget(g_cpu_budget, governor_changed, &st);
 
-        init_thread_specific();
-        Worker_Data wd;
-        init_worker_data(&wd);
+        session_set_backend(&ds, g_config.backend);
+        if (init_display_session(&ds) < 0 || presenter_start(&g_presenter, &ds) < 0) {
+                log_error("Presenter unavailable, every frame updates the root on its own");
+        }
 
         // Apply initial configuration if available
-        pthread_mutex_lock(&wd.mutex);
-        if (g_config.wp) {
-                wd.wp = strdup(resolve(g_config.wp));
-                wd.mon = g_config.mon;
-                wd.mode = g_config.mode;
-                wd.maxmem = g_config.maxmem;
-                wd.running = 1;
-                if (pthread_create(&wd.thread, NULL, worker_thread, &wd) != 0) {
-                        syslog(LOG_ERR, "Failed to create initial worker thread");
-                        wd.running = 0;
-                } else {
-                        syslog(LOG_INFO, "Started initial worker with wp=%s, mon=%d, mode=%d", wd.wp, wd.mon, (int)wd.mode);
-                }
+        pthread_mutex_lock(&st.mutex);
+        if (g_config.playlist) {
+                restart_playlist(&st);
+        } else if (g_config.wp) {
+                start_worker(&st, g_config.wp, g_config.mon, 0);
+        }
+        pthread_mutex_unlock(&st.mutex);
+
+        pthread_t playlist;
+        if (pthread_create(&playlist, NULL, playlist_thread, &st) != 0) {
+                log_error("Failed to create playlist thread");
+        } else {
+                pthread_detach(playlist);
         }
-        pthread_mutex_unlock(&wd.mutex);
 
-        pthread_t fifo_reader;
-        if (pthread_create(&fifo_reader, NULL, fifo_reader_thread, &wd) != 0) {
-                syslog(LOG_ERR, "Failed to create FIFO reader thread");
-                cleanup_worker_data(&wd);
-                unlink(FIFO_PATH);
+        pthread_t control;
+        if (pipe(st.stop_fd) < 0 || start_signal_thread(&st) < 0
+            || pthread_create(&control, NULL, control_thread, &st) != 0) {
+                log_error("Failed to create control thread");
+                for (int i = 0; i < NUM_SLOTS; i++) {
+                        retire_worker(st.slots[i]);
+                }
+                presenter_stop(&g_presenter);
+                cleanup_display_session(&ds);
+                close(st.listen_fd);
+                unlink(IPC_SOCK_PATH);
+                log_stop();
                 closelog();
                 exit(EXIT_FAILURE);
         }
 
-        pthread_join(fifo_reader, NULL);
+        pthread_join(control, NULL);
 
         // Cleanup
-        pthread_mutex_lock(&wd.mutex);
-        if (wd.running) {
-                wd.stop = 1;
-                if (wd.mode == MODE_STREAM && wd.td) {
-                        pthread_mutex_lock(&wd.td->threading.mutex);
-                        wd.td->done = 1;
-                        pthread_cond_broadcast(&wd.td->threading.not_empty);
-                        pthread_cond_broadcast(&wd.td->threading.not_full);
-                        pthread_mutex_unlock(&wd.td->threading.mutex);
-                }
-                while (wd.running) {
-                        pthread_cond_wait(&wd.cond, &wd.mutex);
-                }
-                if (wd.thread) {
-                        pthread_join(wd.thread, NULL);
-                        wd.thread = 0;
-                }
+        log_info("Writing config file");
+        write_config_file();
+        governor_stop();
+        memwatch_stop(&g_memwatch);
+        hotplug_stop(&g_hotplug); // Its callback refreshes occlusion
+        occlusion_stop(&g_occlusion);
+        power_stop(&g_power);
+        pthread_mutex_lock(&st.mutex);
+        for (int i = 0; i < NUM_SLOTS; i++) {
+                retire_worker(st.slots[i]);
+                st.slots[i] = NULL;
         }
-        pthread_mutex_unlock(&wd.mutex);
+        playlist_free(&st.playlist);
+        pthread_mutex_unlock(&st.mutex);
 
-        cleanup_worker_data(&wd);
+        presenter_stop(&g_presenter);
+        cleanup_display_session(&ds);
         free(g_config.wp);
-        unlink(FIFO_PATH);
+        close(st.listen_fd);
+        close(st.stop_fd[0]);
+        close(st.stop_fd[1]);
+        unlink(IPC_SOCK_PATH);
+        trace_close();
+        stats_threads_log_stop();
+        log_stop();
         closelog();
+        unlink(PID_PATH);
+        close(g_pid_fd);
 }
 
 static int daemon_running(void) {
@@ -1154,44 +2661,69 @@ static int daemon_running(void) {
         return kill(pid, 0) == 0;
 }
 
-void send_msg(char **msg, size_t len) {
+// Sends a request to the daemon and prints its reply.
+// Returns 0 if the daemon accepted the request.
+static int send_msg(uint16_t type, char **msg, size_t len) {
         dyn_array(char, buf);
-        for (size_t i = 0; i < len; ++i) {
-                for (size_t j = 0; msg[i][j]; ++j) {
-                        dyn_array_append(buf, msg[i][j]);
+
+        if (type == IPC_CMD_SET) {
+                // Relative paths are resolved by the daemon against our cwd
+                char cwd[PATH_MAX] = {0};
+                if (!getcwd(cwd, sizeof(cwd))) {
+                        cwd[0] = '\0';
+                }
+                for (size_t j = 0; cwd[j]; ++j) {
+                        dyn_array_append(buf, cwd[j]);
+                }
+                dyn_array_append(buf, '\0');
+                for (size_t i = 0; i < len; ++i) {
+                        for (size_t j = 0; msg[i][j]; ++j) {
+                                dyn_array_append(buf, msg[i][j]);
+                        }
+                        dyn_array_append(buf, '\0');
                 }
-                if (i != len - 1) {
-                        dyn_array_append(buf, ' ');
+        } else if (type == IPC_CMD_STATS && len > 0) {
+                for (size_t j = 0; msg[0][j]; ++j) {
+                        dyn_array_append(buf, msg[0][j]);
                 }
+                dyn_array_append(buf, '\0');
         }
-        dyn_array_append(buf, '\0');
 
-        // Open FIFO in non-blocking mode
-        int fd = open(FIFO_PATH, O_WRONLY | O_NONBLOCK);
+        int fd = ipc_connect(IPC_SOCK_PATH);
         if (fd < 0) {
-                if (errno == ENXIO) {
-                        syslog(LOG_ERR, "No process is reading from FIFO %s\n", FIFO_PATH);
-                        fprintf(stderr, "No process is reading from FIFO %s\n", FIFO_PATH);
-                } else {
-                        perror("open");
-                }
+                fprintf(stderr, "Failed to connect to daemon at %s: %s\n", IPC_SOCK_PATH, strerror(errno));
                 dyn_array_free(buf);
-                return;
+                return -1;
         }
 
-        // Convert file descriptor to FILE stream
-        FILE *f = fdopen(fd, "w");
-        if (!f) {
-                perror("fdopen");
+        struct timeval tv = { .tv_sec = 5, .tv_usec = 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        if (ipc_send(fd, type, 0, buf.data, buf.len) < 0) {
+                fprintf(stderr, "Failed to send request to daemon: %s\n", strerror(errno));
                 close(fd);
                 dyn_array_free(buf);
-                return;
+                return -1;
         }
-
-        // Write message
-        fprintf(f, "%s\n", buf.data);
-        fclose(f); // Closes fd as well
         dyn_array_free(buf);
+
+        Ipc_Msg *reply = (Ipc_Msg *)malloc(sizeof(Ipc_Msg));
+        if (!reply) {
+                close(fd);
+                return -1;
+        }
+        int ret = -1;
+        if (ipc_recv(fd, reply) <= 0 || reply->hdr.type != IPC_REPLY) {
+                fprintf(stderr, "No reply from daemon: %s\n", strerror(errno));
+        } else if (reply->hdr.status != 0) {
+                fprintf(stderr, "daemon: %s\n", reply->payload);
+        } else {
+                printf("%s%s", reply->payload, type == IPC_CMD_SET ? "\n" : "");
+                ret = 0;
+        }
+        free(reply);
+        close(fd);
+        return ret;
 }
 
 static void version(void) {
@@ -1219,6 +2751,11 @@ int main(int argc, char *argv[]) {
         clap_init(argc, argv);
 
 
+        int live_control = 0; // --pause, --resume or --step were given
+        int fps_given = 0;
+        const char *trace_path = NULL;
+        Bench_Options bench = { .seconds = 0, .stages = BENCH_DEFAULT_STAGES };
+
         Clap_Arg arg = {0};
         while (clap_next(&arg)) {
                 if (arg.hyphc == 1 && arg.start[0] == FLAG_1HY_HELP) {
@@ -1248,6 +2785,9 @@ int main(int argc, char *argv[]) {
                         if (!str_isdigit(arg.eq)) {
                                 err_wargs("--mon expects a number, not `%s`\n", arg.eq);
                         }
+                        if (atoi(arg.eq) < -2 || atoi(arg.eq) >= MAX_OUTPUTS) {
+                                err_wargs("--mon expects -2, -1 or an output below %d, not `%s`\n", MAX_OUTPUTS, arg.eq);
+                        }
                         g_config.mon = atoi(arg.eq);
                 } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_MODE)) {
                         if (!arg.eq) {
@@ -1268,8 +2808,75 @@ int main(int argc, char *argv[]) {
                                 err_wargs("--fps expects an integer, not `%s`\n", arg.eq);
                         }
                         g_config.fps = atoi(arg.eq);
+                        fps_given = 1;
                 } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_STOP)) {
                         stop_daemon();
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_STATUS)) {
+                        exit(send_msg(IPC_CMD_STATUS, NULL, 0) < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_STATS)) {
+                        if (arg.eq && strcmp(arg.eq, "reset") != 0) {
+                                err_wargs("--stats only takes `reset`, not `%s`\n", arg.eq);
+                        }
+                        char *what[] = { arg.eq };
+                        exit(send_msg(IPC_CMD_STATS, what, arg.eq ? 1 : 0) < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_BENCH)) {
+                        if (arg.eq && (!str_isdigit(arg.eq) || atoi(arg.eq) <= 0)) {
+                                err_wargs("--bench expects a positive number of seconds, not `%s`\n", arg.eq);
+                        }
+                        bench.seconds = arg.eq ? atoi(arg.eq) : 10;
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_STAGES)) {
+                        if (!arg.eq) {
+                                err("--stages expects a value after equals (=)\n");
+                        }
+                        if (bench_parse_stages(arg.eq, &bench.stages) < 0) {
+                                err_wargs("--stages expects a list of demux, decode, scale and present (decode needs demux), not `%s`\n", arg.eq);
+                        }
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_SIZE)) {
+                        if (!arg.eq) {
+                                err("--size expects a value after equals (=)\n");
+                        }
+                        char x;
+                        if (sscanf(arg.eq, "%d%c%d", &g_sink.width, &x, &g_sink.height) != 3 || x != 'x'
+                            || g_sink.width <= 0 || g_sink.height <= 0) {
+                                err_wargs("--size expects <width>x<height>, not `%s`\n", arg.eq);
+                        }
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_SINK)) {
+                        if (!arg.eq) {
+                                err("--sink expects a value after equals (=)\n");
+                        }
+                        sink_cleanup(&g_sink);
+                        if (sink_parse(&g_sink, arg.eq) < 0) {
+                                err_wargs("--sink expects `x11`, `null` or `dump:<dir>[:<n>,...]`, not `%s`\n", arg.eq);
+                        }
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_LOGLEVEL)) {
+                        if (!arg.eq) {
+                                err("--loglevel expects a value after equals (=)\n");
+                        }
+                        int level = log_parse_level(arg.eq);
+                        if (level < 0) {
+                                err_wargs("--loglevel expects `error`, `warn`, `info` or `debug`, not `%s`", arg.eq);
+                        }
+                        atomic_store(&g_log_level, level);
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_THREADSTATS)) {
+                        if (!arg.eq) {
+                                err("--threadstats expects a value after equals (=)\n");
+                        }
+                        if (!str_isdigit(arg.eq) || atoi(arg.eq) < 0) {
+                                err_wargs("--threadstats expects a number of seconds, not `%s`\n", arg.eq);
+                        }
+                        g_threadstats = atoi(arg.eq);
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_CPUBUDGET)) {
+                        if (!arg.eq) {
+                                err("--cpu-budget expects a value after equals (=)\n");
+                        }
+                        if (governor_parse_budget(arg.eq, &g_cpu_budget) < 0) {
+                                err_wargs("--cpu-budget expects a percentage of one core, not `%s`\n", arg.eq);
+                        }
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_TRACE)) {
+                        if (!arg.eq) {
+                                err("--trace expects a value after equals (=)\n");
+                        }
+                        trace_path = arg.eq;
                 } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_MAXMEM)) {
                         if (!arg.eq) {
                                 err("--maxmem expects a value after equals (=)\n");
@@ -1285,6 +2892,83 @@ int main(int argc, char *argv[]) {
                         read_config_file();
                 } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_COPYING)) {
                         copying();
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_PLAYLIST)) {
+                        if (!arg.eq) {
+                                err("--playlist expects a value after equals (=)\n");
+                        }
+                        g_config.playlist = strdup(resolve(arg.eq));
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_INTERVAL)) {
+                        if (!arg.eq) {
+                                err("--interval expects a value after equals (=)\n");
+                        }
+                        if (!str_isdigit(arg.eq) || atoi(arg.eq) <= 0) {
+                                err_wargs("--interval expects a positive integer, not `%s`\n", arg.eq);
+                        }
+                        g_config.interval = atoi(arg.eq);
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_ORDER)) {
+                        if (!arg.eq) {
+                                err("--order expects a value after equals (=)\n");
+                        }
+                        if (!strcmp(arg.eq, "sequential")) {
+                                g_config.order = ORDER_SEQUENTIAL;
+                        } else if (!strcmp(arg.eq, "shuffle")) {
+                                g_config.order = ORDER_SHUFFLE;
+                        } else {
+                                err_wargs("--order expects either `sequential` or `shuffle`, not `%s`", arg.eq);
+                        }
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_FADE)) {
+                        if (!arg.eq) {
+                                err("--fade expects a value after equals (=)\n");
+                        }
+                        if (!str_isdigit(arg.eq) || atoi(arg.eq) < 0) {
+                                err_wargs("--fade expects a number of milliseconds, not `%s`\n", arg.eq);
+                        }
+                        g_config.fade = atoi(arg.eq);
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_IDLE)) {
+                        if (!arg.eq) {
+                                err("--idle expects a value after equals (=)\n");
+                        }
+                        if (!str_isdigit(arg.eq) || atoi(arg.eq) < 0) {
+                                err_wargs("--idle expects a number of seconds, not `%s`\n", arg.eq);
+                        }
+                        g_config.idle = atoi(arg.eq);
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_IDLEFPS)) {
+                        if (!arg.eq) {
+                                err("--idlefps expects a value after equals (=)\n");
+                        }
+                        if (!str_isdigit(arg.eq) || atoi(arg.eq) < 0) {
+                                err_wargs("--idlefps expects an integer, not `%s`\n", arg.eq);
+                        }
+                        g_config.idle_fps = atoi(arg.eq);
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_OCCLUSION)) {
+                        if (!arg.eq) {
+                                err("--occlusion expects a value after equals (=)\n");
+                        }
+                        if (!strcmp(arg.eq, "on")) {
+                                g_config.occlusion = 1;
+                        } else if (!strcmp(arg.eq, "off")) {
+                                g_config.occlusion = 0;
+                        } else {
+                                err_wargs("--occlusion expects either `on` or `off`, not `%s`", arg.eq);
+                        }
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_BACKEND)) {
+                        if (!arg.eq) {
+                                err("--backend expects a value after equals (=)\n");
+                        }
+                        if (!strcmp(arg.eq, "root")) {
+                                g_config.backend = BACKEND_ROOT;
+                        } else if (!strcmp(arg.eq, "window")) {
+                                g_config.backend = BACKEND_WINDOW;
+                        } else {
+                                err_wargs("--backend expects either `root` or `window`, not `%s`", arg.eq);
+                        }
+                } else if (arg.hyphc == 2 && (!strcmp(arg.start, FLAG_2HY_PAUSE) || !strcmp(arg.start, FLAG_2HY_RESUME))) {
+                        live_control = 1;
+                } else if (arg.hyphc == 2 && !strcmp(arg.start, FLAG_2HY_STEP)) {
+                        if (arg.eq && (!str_isdigit(arg.eq) || atoi(arg.eq) <= 0)) {
+                                err_wargs("--step expects a positive integer, not `%s`\n", arg.eq);
+                        }
+                        live_control = 1;
                 }
                 else if (arg.hyphc == 0) {
                         if (g_config.wp) {
@@ -1295,16 +2979,75 @@ int main(int argc, char *argv[]) {
                         err_wargs("unknown option `%s`", arg.start);
                 }
         }
+        if (trace_path && !(g_config.flags & FT_DAEMON) && bench.seconds == 0
+            && g_sink.type == SINK_X11 && daemon_running()) {
+                err("--trace traces the process it is given to, start the daemon with it (-d --trace=<file>)");
+        }
+        if (trace_path) {
+                if (!(g_config.flags & FT_DAEMON)) {
+                        block_signal(SIGINT); // Before any thread, taken by signal_thread()
+                }
+                if (trace_open(trace_path) < 0) {
+                        exit(1);
+                }
+        }
         clap_destroy();
 
+        if (!(g_config.flags & FT_DAEMON)) {
+                log_start(1); // The daemon starts its own after forking
+                stats_thread_start("main");
+                // Only for a run of its own, a running daemon is sent the option instead
+                if (g_threadstats > 0 && (bench.seconds > 0 || g_sink.type != SINK_X11 || !daemon_running())) {
+                        stats_threads_log_start(g_threadstats);
+                }
+                if (trace_path && start_signal_thread(NULL) < 0) {
+                        exit(1);
+                }
+        }
+
+        if (bench.seconds > 0) {
+                if (!g_config.wp) {
+                        err("--bench needs a video file");
+                }
+                bench.file = g_config.wp;
+                bench.fps = fps_given ? g_config.fps : 0;
+                if (g_config.fps <= 0) {
+                        g_config.fps = 1; // Frame sampling is not used by --bench, only keep it finite
+                }
+                FILE *out = bench_report_stream();
+                if (!out) {
+                        err("--bench could not set up its report stream");
+                }
+                Display_Session ds = DISPLAY_SESSION_INIT;
+                session_set_backend(&ds, g_config.backend);
+                int result = run_bench(&ds, &bench, out);
+                cleanup_display_session(&ds);
+                fclose(out);
+                trace_close();
+                stats_threads_log_stop();
+                log_stop();
+                sink_cleanup(&g_sink);
+                free(g_config.wp);
+                return result < 0 ? 1 : 0;
+        }
+
+        playback_init(&g_playback, g_config.fps);
+
         if (g_config.flags & FT_DAEMON) {
                 if (daemon_running()) {
                         err("AnimX daemon is already running");
                 }
+                if (g_sink.type != SINK_X11) {
+                        err("--sink does not apply to the daemon");
+                }
 
                 printf("Wallpaper filepath: %s\n", g_config.wp);
                 printf("Monitor: %d %s\n", g_config.mon, g_config.mon == -1 ? "[Stretch]" : "");
                 printf("Mode: %s\n", g_config.mode == MODE_LOAD ? "load" : "stream");
+                if (g_config.playlist) {
+                        printf("Playlist: %s (every %ds, %s)\n", g_config.playlist, g_config.interval,
+                               g_config.order == ORDER_SHUFFLE ? "shuffle" : "sequential");
+                }
                 if (g_config.flags & FT_MAXMEM) {
                         if (g_config.maxmem < 0) {
                                 err_wargs("The maximum memory you entered (%f) must be > 0.0", g_config.maxmem);
@@ -1314,29 +3057,51 @@ int main(int argc, char *argv[]) {
 
                 daemon_loop();
         } else {
-                // Sending message
-                if (!daemon_running()) {
+                // Sending message, unless frames go somewhere else than the screen
+                if (!daemon_running() || g_sink.type != SINK_X11) {
+                        if (g_config.playlist) {
+                                err("--playlist requires the daemon, start it with -d");
+                        }
+                        if (live_control) {
+                                err("--pause, --resume and --step require the daemon, start it with -d");
+                        }
                         if (!g_config.wp) {
                                 err("Wallpaper filepath is not set");
                         }
 
+                        Display_Session ds = DISPLAY_SESSION_INIT;
+                        session_set_backend(&ds, g_config.backend);
+                        if (g_sink.type == SINK_X11 && init_display_session(&ds) == 0) {
+                                presenter_start(&g_presenter, &ds);
+                        }
+                        if (g_cpu_budget > 0) governor_set_budget(g_cpu_budget, governor_changed_local, NULL);
                         int result = 0;
                         if (g_config.mode == MODE_STREAM) {
-                                result = run_stream(g_config.mon, g_config.wp);
+                                result = run_stream(&ds, g_config.mon, g_config.wp);
                         } else if (g_config.mode == MODE_LOAD) {
-                                result = run_load_all(g_config.mon, g_config.wp);
+                                result = run_load_all(&ds, g_config.mon, g_config.wp);
                         }
+                        governor_stop();
+                        presenter_stop(&g_presenter); // Publishes the last frame
+                        cleanup_display_session(&ds);
 
                         // If single frame and not in daemon mode, exit
                         if (result == 1) {
                                 printf("Applied single-frame image, exiting\n");
                         }
-                        write_config_file();
+                        if (g_sink.type == SINK_X11) {
+                                write_config_file(); // Only what was on screen is worth restoring
+                        }
+                        trace_close();
+                        stats_threads_log_stop();
+                        log_stop();
+                        sink_cleanup(&g_sink);
                         free(g_config.wp);
                         return 0;
                 }
-                send_msg(orig_argv, orig_argc);
-                printf("sent configuration to daemon, applying changes...\n");
+                if (send_msg(IPC_CMD_SET, orig_argv, orig_argc) < 0) {
+                        return 1;
+                }
         }
 
         return 0;
@@ -0,0 +1,199 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "AnimX-log.h"
+#include "AnimX-memory.h"
+#include "AnimX-stats.h"
+#include "AnimX-utils.h"
+
+long mem_rss_bytes(void) {
+        FILE *f = fopen("/proc/self/statm", "r");
+        if (!f) return -1;
+        long size, resident;
+        int n = fscanf(f, "%ld %ld", &size, &resident);
+        fclose(f);
+        return n == 2 ? resident * sysconf(_SC_PAGESIZE) : -1;
+}
+
+size_t mem_block_size(void *ptr) {
+        return ptr ? malloc_usable_size(ptr) : 0;
+}
+
+static int open_psi(void) {
+        int fd = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) return -1;
+        char trigger[64];
+        int len = snprintf(trigger, sizeof(trigger), "some %d %d", MEMWATCH_STALL_US, MEMWATCH_WINDOW_US);
+        if (write(fd, trigger, (size_t)len + 1) < 0) {
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+// memory.events of the cgroup (v2) this process is in
+static int open_cgroup_events(void) {
+        FILE *f = fopen("/proc/self/cgroup", "r");
+        if (!f) return -1;
+        char line[512], path[600];
+        path[0] = '\0';
+        while (fgets(line, sizeof(line), f)) {
+                if (!strncmp(line, "0::", 3)) {
+                        line[strcspn(line, "\n")] = '\0';
+                        snprintf(path, sizeof(path), "/sys/fs/cgroup%s/memory.events", line + 3);
+                        break;
+                }
+        }
+        fclose(f);
+        return path[0] ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+}
+
+// Sum of the counters that mean the cgroup hit its limits
+static unsigned long read_cgroup_events(int fd) {
+        char buf[512];
+        ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+        if (n <= 0) return 0;
+        buf[n] = '\0';
+        unsigned long sum = 0;
+        for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+                char key[32];
+                unsigned long value;
+                if (sscanf(line, "%31s %lu", key, &value) == 2
+                    && (!strcmp(key, "high") || !strcmp(key, "max") || !strcmp(key, "oom"))) {
+                        sum += value;
+                }
+        }
+        return sum;
+}
+
+static void *memwatch_thread(void *arg) {
+        Memwatch *mw = (Memwatch *)arg;
+        stats_thread_start("memwatch");
+        // PSI and kernfs both report through POLLPRI
+        struct pollfd fds[2] = {
+                { .fd = mw->fd, .events = POLLPRI },
+                { .fd = mw->wake_fd[0], .events = POLLIN },
+        };
+        long last_us = 0;
+        while (1) {
+                if (poll(fds, 2, -1) < 0) {
+                        if (errno == EINTR) continue;
+                        log_error("Memwatch: poll(): %s", strerror(errno));
+                        break;
+                }
+                if (fds[1].revents & POLLIN) break;
+                if (fds[0].revents & POLLERR && mw->source == MEMWATCH_PSI) {
+                        log_error("Memwatch: PSI trigger went away");
+                        break;
+                }
+                if (!(fds[0].revents & (POLLPRI | POLLERR))) continue;
+
+                if (mw->source == MEMWATCH_CGROUP) {
+                        unsigned long sum = read_cgroup_events(mw->fd);
+                        pthread_mutex_lock(&mw->mutex);
+                        int grew = sum > mw->cg_events;
+                        mw->cg_events = sum;
+                        pthread_mutex_unlock(&mw->mutex);
+                        if (!grew) continue; // Some other counter, e.g. `low`
+                }
+                long now = get_time_us();
+                if (last_us && now - last_us < MEMWATCH_WINDOW_US) continue;
+                last_us = now;
+
+                pthread_mutex_lock(&mw->mutex);
+                mw->events++;
+                pthread_mutex_unlock(&mw->mutex);
+                log_warn("Memwatch: memory pressure (%s), resident %ld KB",
+                         memwatch_source_name(mw), mem_rss_bytes() / 1024);
+                if (mw->pressure) mw->pressure(mw->user);
+        }
+        return NULL;
+}
+
+int memwatch_start(Memwatch *mw, Memwatch_Pressure pressure, void *user) {
+        mw->fd = open_psi();
+        mw->source = MEMWATCH_PSI;
+        if (mw->fd < 0) {
+                mw->fd = open_cgroup_events();
+                mw->source = MEMWATCH_CGROUP;
+        }
+        if (mw->fd < 0) {
+                mw->source = MEMWATCH_NONE;
+                log_info("Memwatch: neither PSI nor cgroup memory.events is available");
+                return -1;
+        }
+        if (mw->source == MEMWATCH_CGROUP) {
+                mw->cg_events = read_cgroup_events(mw->fd);
+        }
+        mw->events = 0;
+        mw->pressure = pressure;
+        mw->user = user;
+
+        if (pipe(mw->wake_fd) < 0 || pthread_create(&mw->thread, NULL, memwatch_thread, mw) != 0) {
+                log_error("Memwatch: failed to start watcher thread");
+                memwatch_stop(mw);
+                return -1;
+        }
+        mw->started = 1;
+        log_info("Memwatch: watching %s", memwatch_source_name(mw));
+        return 0;
+}
+
+void memwatch_stop(Memwatch *mw) {
+        if (mw->started) {
+                if (write(mw->wake_fd[1], "x", 1) < 0) {
+                        log_error("Memwatch: failed to wake watcher: %s", strerror(errno));
+                }
+                pthread_join(mw->thread, NULL);
+                mw->started = 0;
+        }
+        for (int i = 0; i < 2; i++) {
+                if (mw->wake_fd[i] >= 0) close(mw->wake_fd[i]);
+                mw->wake_fd[i] = -1;
+        }
+        if (mw->fd >= 0) close(mw->fd);
+        mw->fd = -1;
+        mw->source = MEMWATCH_NONE;
+}
+
+unsigned long memwatch_events(Memwatch *mw) {
+        pthread_mutex_lock(&mw->mutex);
+        unsigned long events = mw->events;
+        pthread_mutex_unlock(&mw->mutex);
+        return events;
+}
+
+const char *memwatch_source_name(const Memwatch *mw) {
+        switch (mw->source) {
+        case MEMWATCH_PSI: return "psi";
+        case MEMWATCH_CGROUP: return "cgroup";
+        case MEMWATCH_NONE: break;
+        }
+        return "none";
+}
@@ -0,0 +1,286 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <X11/Xutil.h>
+
+#include "AnimX-occlusion.h"
+#include "AnimX-stats.h"
+#include "AnimX-utils.h"
+
+// Bursts of events (a window being dragged, a workspace switch) are
+// coalesced into one recomputation after things settle for this long.
+#define OCCLUSION_SETTLE_US (100L * 1000L)
+
+static Display *g_watch_display;
+static XErrorHandler g_prev_handler;
+
+// Windows can vanish between XQueryTree() and XGetWindowAttributes(),
+// which is expected here and must not take the daemon down.
+static int occlusion_error_handler(Display *display, XErrorEvent *ev) {
+        if (display == g_watch_display) {
+                return 0;
+        }
+        return g_prev_handler ? g_prev_handler(display, ev) : 0;
+}
+
+static unsigned long compute_visible(Occlusion *oc) {
+        Window root_ret, parent_ret, *children = NULL;
+        unsigned int nchildren = 0;
+        if (!XQueryTree(oc->display, oc->root, &root_ret, &parent_ret, &children, &nchildren)) {
+                return ~0UL;
+        }
+
+        // XQueryTree() lists children bottom to top, but any mapped
+        // opaque child hides the root no matter where it is stacked.
+        Region covered = XCreateRegion();
+        for (unsigned int i = 0; i < nchildren; i++) {
+                XWindowAttributes wa;
+                if (!XGetWindowAttributes(oc->display, children[i], &wa)) {
+                        continue;
+                }
+                if (wa.map_state != IsViewable || wa.class == InputOnly) {
+                        continue;
+                }
+                int own = 0;
+                for (int j = 0; j < oc->num_own_windows; j++) {
+                        own |= children[i] == oc->own_windows[j];
+                }
+                if (own) {
+                        continue; // Our own desktop windows show the wallpaper
+                }
+                if (wa.depth == 32) {
+                        continue; // ARGB windows may let the wallpaper through
+                }
+                XRectangle r = {
+                        .x = (short)wa.x,
+                        .y = (short)wa.y,
+                        .width = (unsigned short)(wa.width + 2 * wa.border_width),
+                        .height = (unsigned short)(wa.height + 2 * wa.border_width),
+                };
+                XUnionRectWithRegion(&r, covered, covered);
+        }
+        if (children) XFree(children);
+
+        unsigned long visible = 0;
+        for (int i = 0; i < oc->num_monitors && i < (int)(sizeof(visible) * 8); i++) {
+                Region rest = XCreateRegion();
+                XUnionRectWithRegion(&oc->monitors[i], rest, rest);
+                XSubtractRegion(rest, covered, rest);
+                if (!XEmptyRegion(rest)) {
+                        visible |= 1UL << i;
+                }
+                XDestroyRegion(rest);
+        }
+        XDestroyRegion(covered);
+        return visible;
+}
+
+static int is_stacking_event(Occlusion *oc, XEvent *ev) {
+        switch (ev->type) {
+        case ConfigureNotify:
+        case MapNotify:
+        case UnmapNotify:
+        case DestroyNotify:
+        case ReparentNotify:
+        case CirculateNotify:
+                return 1;
+        case PropertyNotify:
+                return ev->xproperty.atom == oc->client_list_stacking;
+        default:
+                return 0;
+        }
+}
+
+static void update_visible(Occlusion *oc) {
+        unsigned long visible = compute_visible(oc);
+
+        pthread_mutex_lock(&oc->mutex);
+        int changed = visible != oc->visible;
+        oc->visible = visible;
+        pthread_mutex_unlock(&oc->mutex);
+
+        if (changed) {
+                syslog(LOG_INFO, "Occlusion: visible monitors 0x%lx", visible);
+                if (oc->changed) oc->changed(visible, oc->user);
+        }
+}
+
+// Copies the monitor rectangles out of the session. Only called from
+// the watcher thread (and before it starts).
+static int load_monitors(Occlusion *oc) {
+        Display_Session *ds = oc->ds;
+        pthread_mutex_lock(&ds->lock);
+        free(oc->monitors);
+        oc->num_monitors = ds->num_monitors;
+        oc->monitors = (XRectangle *)malloc((oc->num_monitors ? oc->num_monitors : 1) * sizeof(XRectangle));
+        for (int i = 0; oc->monitors && i < oc->num_monitors; i++) {
+                oc->monitors[i].x = (short)ds->crtc_infos[i]->x;
+                oc->monitors[i].y = (short)ds->crtc_infos[i]->y;
+                oc->monitors[i].width = (unsigned short)ds->crtc_infos[i]->width;
+                oc->monitors[i].height = (unsigned short)ds->crtc_infos[i]->height;
+        }
+        free(oc->own_windows);
+        oc->num_own_windows = 0;
+        oc->own_windows = (Window *)malloc((ds->num_desktops ? ds->num_desktops : 1) * sizeof(Window));
+        for (int i = 0; oc->own_windows && i < ds->num_desktops; i++) {
+                oc->own_windows[oc->num_own_windows++] = ds->desktops[i].window;
+        }
+        pthread_mutex_unlock(&ds->lock);
+        if (!oc->monitors) {
+                oc->num_monitors = 0;
+                syslog(LOG_ERR, "Occlusion: failed to allocate monitor list");
+                return -1;
+        }
+        return 0;
+}
+
+static void *occlusion_thread(void *arg) {
+        Occlusion *oc = (Occlusion *)arg;
+        stats_thread_start("occlusion");
+        struct pollfd fds[2] = {
+                { .fd = ConnectionNumber(oc->display), .events = POLLIN },
+                { .fd = oc->wake_fd[0], .events = POLLIN },
+        };
+
+        update_visible(oc);
+
+        long settle_at = 0;
+        while (1) {
+                while (XPending(oc->display)) {
+                        XEvent ev;
+                        XNextEvent(oc->display, &ev);
+                        if (is_stacking_event(oc, &ev) && !settle_at) {
+                                settle_at = get_time_us() + OCCLUSION_SETTLE_US;
+                        }
+                }
+
+                int timeout = -1;
+                if (settle_at) {
+                        long left = settle_at - get_time_us();
+                        timeout = left > 0 ? (int)((left + 999) / 1000) : 0;
+                }
+                if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+                        syslog(LOG_ERR, "Occlusion: poll(): %s", strerror(errno));
+                        break;
+                }
+                if (fds[1].revents) {
+                        char cmd;
+                        if (read(oc->wake_fd[0], &cmd, 1) != 1 || cmd != 'r') {
+                                break;
+                        }
+                        load_monitors(oc);
+                        update_visible(oc);
+                }
+                if (settle_at && get_time_us() >= settle_at) {
+                        settle_at = 0;
+                        update_visible(oc);
+                }
+        }
+        return NULL;
+}
+
+int occlusion_start(Occlusion *oc, Display_Session *ds, Occlusion_Changed changed, void *user) {
+        if (init_display_session(ds) < 0) {
+                return -1;
+        }
+
+        oc->ds = ds;
+        if (load_monitors(oc) < 0) {
+                return -1;
+        }
+
+        oc->display = XOpenDisplay(NULL);
+        if (!oc->display) {
+                syslog(LOG_ERR, "Occlusion: cannot open X display");
+                free(oc->monitors);
+                oc->monitors = NULL;
+                free(oc->own_windows);
+                oc->own_windows = NULL;
+                oc->num_own_windows = 0;
+                return -1;
+        }
+        oc->root = DefaultRootWindow(oc->display);
+        oc->client_list_stacking = XInternAtom(oc->display, "_NET_CLIENT_LIST_STACKING", False);
+        oc->changed = changed;
+        oc->user = user;
+
+        g_watch_display = oc->display;
+        g_prev_handler = XSetErrorHandler(occlusion_error_handler);
+        XSelectInput(oc->display, oc->root, SubstructureNotifyMask | PropertyChangeMask);
+        XFlush(oc->display);
+
+        if (pipe(oc->wake_fd) < 0 || pthread_create(&oc->thread, NULL, occlusion_thread, oc) != 0) {
+                syslog(LOG_ERR, "Occlusion: failed to start watcher thread");
+                occlusion_stop(oc);
+                return -1;
+        }
+        oc->started = 1;
+        return 0;
+}
+
+void occlusion_stop(Occlusion *oc) {
+        if (oc->started) {
+                if (write(oc->wake_fd[1], "x", 1) < 0) {
+                        syslog(LOG_ERR, "Occlusion: failed to wake watcher: %s", strerror(errno));
+                }
+                pthread_join(oc->thread, NULL);
+                oc->started = 0;
+        }
+        for (int i = 0; i < 2; i++) {
+                if (oc->wake_fd[i] >= 0) close(oc->wake_fd[i]);
+                oc->wake_fd[i] = -1;
+        }
+        if (oc->display) {
+                XSetErrorHandler(g_prev_handler);
+                g_watch_display = NULL;
+                XCloseDisplay(oc->display);
+                oc->display = NULL;
+        }
+        free(oc->monitors);
+        oc->monitors = NULL;
+        oc->num_monitors = 0;
+        free(oc->own_windows);
+        oc->own_windows = NULL;
+        oc->num_own_windows = 0;
+
+        pthread_mutex_lock(&oc->mutex);
+        oc->visible = ~0UL;
+        pthread_mutex_unlock(&oc->mutex);
+}
+
+void occlusion_refresh(Occlusion *oc) {
+        if (oc->started && write(oc->wake_fd[1], "r", 1) < 0) {
+                syslog(LOG_ERR, "Occlusion: failed to wake watcher: %s", strerror(errno));
+        }
+}
+
+unsigned long occlusion_visible(Occlusion *oc) {
+        pthread_mutex_lock(&oc->mutex);
+        unsigned long visible = oc->visible;
+        pthread_mutex_unlock(&oc->mutex);
+        return visible;
+}
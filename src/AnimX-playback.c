@@ -0,0 +1,147 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "AnimX-playback.h"
+#include "AnimX-utils.h"
+
+void playback_init(Playback *pb, int fps) {
+        pthread_mutex_init(&pb->mutex, NULL);
+        init_monotonic_cond(&pb->cond);
+        pb->fps = fps > 0 ? fps : 30;
+        pb->fps_cap = 0;
+        pb->fps_percent = 100;
+        pb->pause_mask = 0;
+        pb->steps = 0;
+        pb->resync_pending = 0;
+        pb->resync = 0;
+}
+
+static int effective_fps(Playback *pb) {
+        int fps = pb->fps;
+        if (pb->fps_percent < 100) {
+                fps = fps * pb->fps_percent / 100;
+                if (fps < 1) fps = 1;
+        }
+        return pb->fps_cap > 0 && pb->fps_cap < fps ? pb->fps_cap : fps;
+}
+
+int playback_fps(Playback *pb) {
+        pthread_mutex_lock(&pb->mutex);
+        int fps = effective_fps(pb);
+        pthread_mutex_unlock(&pb->mutex);
+        return fps;
+}
+
+unsigned playback_paused(Playback *pb) {
+        pthread_mutex_lock(&pb->mutex);
+        unsigned mask = pb->pause_mask;
+        pthread_mutex_unlock(&pb->mutex);
+        return mask;
+}
+
+void playback_set_fps(Playback *pb, int fps) {
+        if (fps <= 0) return;
+        pthread_mutex_lock(&pb->mutex);
+        pb->fps = fps;
+        pthread_cond_broadcast(&pb->cond);
+        pthread_mutex_unlock(&pb->mutex);
+}
+
+void playback_set_cap(Playback *pb, int cap) {
+        pthread_mutex_lock(&pb->mutex);
+        pb->fps_cap = cap > 0 ? cap : 0;
+        pthread_cond_broadcast(&pb->cond);
+        pthread_mutex_unlock(&pb->mutex);
+}
+
+void playback_set_percent(Playback *pb, int percent) {
+        pthread_mutex_lock(&pb->mutex);
+        pb->fps_percent = percent > 0 && percent < 100 ? percent : 100;
+        pthread_cond_broadcast(&pb->cond);
+        pthread_mutex_unlock(&pb->mutex);
+}
+
+void playback_pause(Playback *pb, unsigned reason) {
+        pthread_mutex_lock(&pb->mutex);
+        pb->pause_mask |= reason;
+        if (reason & PAUSE_RESYNC) pb->resync_pending = 1;
+        pthread_cond_broadcast(&pb->cond);
+        pthread_mutex_unlock(&pb->mutex);
+}
+
+void playback_resume(Playback *pb, unsigned reason) {
+        pthread_mutex_lock(&pb->mutex);
+        pb->pause_mask &= ~reason;
+        if (!pb->pause_mask) {
+                pb->steps = 0;
+                if (pb->resync_pending) pb->resync++;
+                pb->resync_pending = 0;
+        }
+        pthread_cond_broadcast(&pb->cond);
+        pthread_mutex_unlock(&pb->mutex);
+}
+
+void playback_step(Playback *pb, int frames) {
+        pthread_mutex_lock(&pb->mutex);
+        if (pb->pause_mask && frames > 0) {
+                pb->steps += frames;
+                pthread_cond_broadcast(&pb->cond);
+        }
+        pthread_mutex_unlock(&pb->mutex);
+}
+
+unsigned playback_resync(Playback *pb) {
+        pthread_mutex_lock(&pb->mutex);
+        unsigned resync = pb->resync;
+        pthread_mutex_unlock(&pb->mutex);
+        return resync;
+}
+
+void playback_wake(Playback *pb) {
+        pthread_mutex_lock(&pb->mutex);
+        pthread_cond_broadcast(&pb->cond);
+        pthread_mutex_unlock(&pb->mutex);
+}
+
+int playback_wait(Playback *pb, long since_us, const int *done) {
+        int ret = -1;
+        pthread_mutex_lock(&pb->mutex);
+        while (!*done) {
+                if (pb->pause_mask) {
+                        if (pb->steps > 0) {
+                                pb->steps--;
+                                ret = 0;
+                                break;
+                        }
+                        pthread_cond_wait(&pb->cond, &pb->mutex);
+                        continue;
+                }
+                // Recomputed after every wakeup so a new fps applies to
+                // the frame that is currently being waited for.
+                long due = since_us + 1000000L / effective_fps(pb);
+                if (get_time_us() >= due) {
+                        ret = 0;
+                        break;
+                }
+                struct timespec ts = us_to_timespec(due);
+                pthread_cond_timedwait(&pb->cond, &pb->mutex, &ts);
+        }
+        pthread_mutex_unlock(&pb->mutex);
+        return ret;
+}
@@ -0,0 +1,152 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <syslog.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "AnimX-playlist.h"
+
+static int is_regular_file(const char *path) {
+        struct stat st;
+        return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static int cmp_items(const void *a, const void *b) {
+        return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void add_item(Playlist *pl, const char *path) {
+        char rp[PATH_MAX] = {0};
+        if (!realpath(path, rp) || !is_regular_file(rp)) {
+                syslog(LOG_ERR, "Playlist: skipping `%s`", path);
+                return;
+        }
+        dyn_array_append(pl->items, strdup(rp));
+}
+
+static int load_directory(Playlist *pl, const char *path) {
+        DIR *dir = opendir(path);
+        if (!dir) {
+                syslog(LOG_ERR, "Playlist: failed to open directory %s: %s", path, strerror(errno));
+                return -1;
+        }
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL) {
+                if (de->d_name[0] == '.') continue;
+                char fp[PATH_MAX] = {0};
+                snprintf(fp, sizeof(fp), "%s/%s", path, de->d_name);
+                if (is_regular_file(fp)) {
+                        add_item(pl, fp);
+                }
+        }
+        closedir(dir);
+        if (pl->items.len > 1) {
+                qsort(pl->items.data, pl->items.len, sizeof(char *), cmp_items);
+        }
+        return 0;
+}
+
+static int load_list_file(Playlist *pl, const char *path) {
+        FILE *f = fopen(path, "r");
+        if (!f) {
+                syslog(LOG_ERR, "Playlist: failed to open list %s: %s", path, strerror(errno));
+                return -1;
+        }
+        char line[PATH_MAX];
+        while (fgets(line, sizeof(line), f)) {
+                size_t n = strlen(line);
+                while (n > 0 && (line[n-1] == '\n' || line[n-1] == ' ' || line[n-1] == '\t')) {
+                        line[--n] = '\0';
+                }
+                char *s = line;
+                while (*s == ' ' || *s == '\t') ++s;
+                if (!*s || *s == '#' || (s[0] == '/' && s[1] == '/')) continue;
+                add_item(pl, s);
+        }
+        fclose(f);
+        return 0;
+}
+
+static void shuffle(Playlist *pl) {
+        for (size_t i = pl->items.len; i > 1; --i) {
+                size_t j = (size_t)rand_r(&pl->seed) % i;
+                char *tmp = pl->items.data[i-1];
+                pl->items.data[i-1] = pl->items.data[j];
+                pl->items.data[j] = tmp;
+        }
+}
+
+int playlist_load(Playlist *pl, const char *path, int order) {
+        playlist_free(pl);
+        pl->order = order;
+        pl->seed = (unsigned int)time(NULL);
+
+        struct stat st;
+        if (stat(path, &st) < 0) {
+                syslog(LOG_ERR, "Playlist: cannot stat %s: %s", path, strerror(errno));
+                return -1;
+        }
+        int ret = S_ISDIR(st.st_mode) ? load_directory(pl, path) : load_list_file(pl, path);
+        if (ret < 0) {
+                return -1;
+        }
+        if (pl->order == ORDER_SHUFFLE) {
+                shuffle(pl);
+        }
+        syslog(LOG_INFO, "Playlist: loaded %zu entries from %s", pl->items.len, path);
+        return (int)pl->items.len;
+}
+
+const char *playlist_next(Playlist *pl) {
+        if (pl->items.len == 0) {
+                return NULL;
+        }
+        if (pl->pos >= pl->items.len) {
+                pl->pos = 0;
+                if (pl->order == ORDER_SHUFFLE && pl->items.len > 2) {
+                        // Reshuffle every cycle without repeating the last entry
+                        char *last = pl->items.data[pl->items.len-1];
+                        shuffle(pl);
+                        if (pl->items.data[0] == last) {
+                                pl->items.data[0] = pl->items.data[1];
+                                pl->items.data[1] = last;
+                        }
+                }
+        }
+        return pl->items.data[pl->pos++];
+}
+
+void playlist_free(Playlist *pl) {
+        for (size_t i = 0; i < pl->items.len; ++i) {
+                free(pl->items.data[i]);
+        }
+        if (pl->items.data) {
+                dyn_array_free(pl->items);
+        }
+        pl->items.data = NULL;
+        pl->items.len = 0;
+        pl->pos = 0;
+}
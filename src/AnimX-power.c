@@ -0,0 +1,226 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <X11/extensions/scrnsaver.h>
+#include <X11/extensions/dpms.h>
+
+#include "AnimX-power.h"
+#include "AnimX-stats.h"
+
+// Idle time and DPMS have no event for "user came back", so while idle
+// or off the watcher looks again this often.
+#define POWER_POLL_MS 1000
+
+// Upper bound on how long an active watcher sleeps without looking.
+#define POWER_MAX_SLEEP_MS (60 * 1000)
+
+static long min_positive(long a, long b) {
+        if (a <= 0) return b;
+        if (b <= 0) return a;
+        return a < b ? a : b;
+}
+
+// Works out the current state and how long (in ms) it is certain to
+// stay that way, i.e. when the next threshold could be crossed.
+static Power_State query_state(Power *pw, int idle_s, long *next_ms) {
+        Window root = DefaultRootWindow(pw->display);
+        unsigned long idle_ms = 0;
+        long next = POWER_MAX_SLEEP_MS;
+
+        if (pw->have_saver) {
+                XScreenSaverInfo info;
+                if (XScreenSaverQueryInfo(pw->display, root, &info)) {
+                        if (info.state == ScreenSaverOn) {
+                                *next_ms = POWER_POLL_MS;
+                                return POWER_OFF;
+                        }
+                        idle_ms = info.idle;
+                        if (info.state == ScreenSaverOff) {
+                                next = min_positive(next, (long)info.til_or_since);
+                        }
+                }
+        }
+
+        if (pw->have_dpms) {
+                CARD16 level;
+                BOOL enabled;
+                if (DPMSInfo(pw->display, &level, &enabled) && enabled) {
+                        if (level != DPMSModeOn) {
+                                *next_ms = POWER_POLL_MS;
+                                return POWER_OFF;
+                        }
+                        CARD16 standby, suspend, off;
+                        if (DPMSGetTimeouts(pw->display, &standby, &suspend, &off)) {
+                                CARD16 t[3] = {standby, suspend, off};
+                                for (int i = 0; i < 3; i++) {
+                                        if (t[i] && (unsigned long)t[i] * 1000UL > idle_ms) {
+                                                next = min_positive(next, (long)((unsigned long)t[i] * 1000UL - idle_ms));
+                                        }
+                                }
+                        }
+                }
+        }
+
+        if (pw->have_saver && idle_s > 0) {
+                unsigned long threshold = (unsigned long)idle_s * 1000UL;
+                if (idle_ms >= threshold) {
+                        *next_ms = POWER_POLL_MS;
+                        return POWER_IDLE;
+                }
+                next = min_positive(next, (long)(threshold - idle_ms));
+        }
+
+        *next_ms = next < POWER_POLL_MS ? POWER_POLL_MS : next;
+        return POWER_ACTIVE;
+}
+
+static void *power_thread(void *arg) {
+        Power *pw = (Power *)arg;
+        stats_thread_start("power");
+        struct pollfd fds[2] = {
+                { .fd = ConnectionNumber(pw->display), .events = POLLIN },
+                { .fd = pw->wake_fd[0], .events = POLLIN },
+        };
+
+        while (1) {
+                pthread_mutex_lock(&pw->mutex);
+                int stop = pw->stop;
+                int idle_s = pw->idle_s;
+                pthread_mutex_unlock(&pw->mutex);
+                if (stop) break;
+
+                long next_ms;
+                Power_State state = query_state(pw, idle_s, &next_ms);
+
+                pthread_mutex_lock(&pw->mutex);
+                int changed = state != pw->state;
+                pw->state = state;
+                pthread_mutex_unlock(&pw->mutex);
+                if (changed) {
+                        syslog(LOG_INFO, "Power: %s", power_state_name(state));
+                        if (pw->changed) pw->changed(state, pw->user);
+                }
+
+                // Screensaver notifies only serve as an early wakeup
+                while (XPending(pw->display)) {
+                        XEvent ev;
+                        XNextEvent(pw->display, &ev);
+                }
+                if (poll(fds, 2, (int)next_ms) < 0 && errno != EINTR) {
+                        syslog(LOG_ERR, "Power: poll(): %s", strerror(errno));
+                        break;
+                }
+                if (fds[1].revents & POLLIN) {
+                        char buf[16];
+                        if (read(pw->wake_fd[0], buf, sizeof(buf)) < 0) {
+                                syslog(LOG_ERR, "Power: read(): %s", strerror(errno));
+                        }
+                }
+        }
+        return NULL;
+}
+
+static void wake(Power *pw) {
+        if (pw->wake_fd[1] >= 0 && write(pw->wake_fd[1], "x", 1) < 0) {
+                syslog(LOG_ERR, "Power: failed to wake watcher: %s", strerror(errno));
+        }
+}
+
+int power_start(Power *pw, int idle_s, Power_Changed changed, void *user) {
+        pw->display = XOpenDisplay(NULL);
+        if (!pw->display) {
+                syslog(LOG_ERR, "Power: cannot open X display");
+                return -1;
+        }
+
+        int error_base, dummy;
+        pw->have_saver = XScreenSaverQueryExtension(pw->display, &pw->saver_event_base, &error_base);
+        pw->have_dpms = DPMSQueryExtension(pw->display, &dummy, &error_base) && DPMSCapable(pw->display);
+        if (pw->have_saver) {
+                XScreenSaverSelectInput(pw->display, DefaultRootWindow(pw->display), ScreenSaverNotifyMask);
+        }
+        syslog(LOG_INFO, "Power: screensaver extension %s, DPMS %s",
+               pw->have_saver ? "available" : "missing", pw->have_dpms ? "available" : "missing");
+
+        pw->idle_s = idle_s;
+        pw->stop = 0;
+        pw->state = POWER_ACTIVE;
+        pw->changed = changed;
+        pw->user = user;
+
+        if (pipe(pw->wake_fd) < 0 || pthread_create(&pw->thread, NULL, power_thread, pw) != 0) {
+                syslog(LOG_ERR, "Power: failed to start watcher thread");
+                power_stop(pw);
+                return -1;
+        }
+        pw->started = 1;
+        return 0;
+}
+
+void power_stop(Power *pw) {
+        if (pw->started) {
+                pthread_mutex_lock(&pw->mutex);
+                pw->stop = 1;
+                pthread_mutex_unlock(&pw->mutex);
+                wake(pw);
+                pthread_join(pw->thread, NULL);
+                pw->started = 0;
+        }
+        for (int i = 0; i < 2; i++) {
+                if (pw->wake_fd[i] >= 0) close(pw->wake_fd[i]);
+                pw->wake_fd[i] = -1;
+        }
+        if (pw->display) {
+                XCloseDisplay(pw->display);
+                pw->display = NULL;
+        }
+        pthread_mutex_lock(&pw->mutex);
+        pw->state = POWER_ACTIVE;
+        pthread_mutex_unlock(&pw->mutex);
+}
+
+void power_set_idle(Power *pw, int idle_s) {
+        pthread_mutex_lock(&pw->mutex);
+        pw->idle_s = idle_s;
+        pthread_mutex_unlock(&pw->mutex);
+        wake(pw);
+}
+
+Power_State power_state(Power *pw) {
+        pthread_mutex_lock(&pw->mutex);
+        Power_State state = pw->state;
+        pthread_mutex_unlock(&pw->mutex);
+        return state;
+}
+
+const char *power_state_name(Power_State state) {
+        switch (state) {
+        case POWER_ACTIVE: return "active";
+        case POWER_IDLE: return "idle";
+        case POWER_OFF: return "off";
+        }
+        return "unknown";
+}
@@ -0,0 +1,166 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+#include <syslog.h>
+
+#include "AnimX-present.h"
+#include "AnimX-stats.h"
+#include "AnimX-trace.h"
+#include "AnimX-utils.h"
+
+// Takes the pending damage with `pr->mutex` held. Returns the number of
+// rectangles put into `rects`.
+static int take_damage(Presenter *pr, XRectangle *rects) {
+        int num_rects = pr->num_rects;
+        if (num_rects < 0) {
+                rects[0] = (XRectangle){ .x = pr->x1, .y = pr->y1,
+                                         .width = pr->x2 - pr->x1, .height = pr->y2 - pr->y1 };
+                num_rects = 1;
+        } else {
+                memcpy(rects, pr->rects, num_rects * sizeof(XRectangle));
+        }
+        pr->dirty = 0;
+        pr->num_rects = 0;
+        return num_rects;
+}
+
+// Takes the damage and flips with `ds->lock` held throughout. A pipeline
+// drawing in between would otherwise land in the flip without being
+// copied back, and the next flip would show the stale front for it.
+// Must be called without `pr->mutex` held.
+static void publish(Presenter *pr, Display_Session *ds) {
+        pthread_mutex_lock(&ds->lock);
+        pthread_mutex_lock(&pr->mutex);
+        if (!pr->dirty) {
+                pthread_mutex_unlock(&pr->mutex);
+                pthread_mutex_unlock(&ds->lock);
+                return;
+        }
+        XRectangle rects[PRESENT_MAX_RECTS];
+        int num_rects = take_damage(pr, rects);
+        pr->last_update_us = get_time_us();
+        pr->updates++;
+        pthread_mutex_unlock(&pr->mutex);
+        long start = get_time_us();
+        session_present_locked(ds, rects, num_rects);
+        pthread_mutex_unlock(&ds->lock);
+        stats_record(STAGE_PRESENT, get_time_us() - start);
+        trace_end(TRACE_PRESENT, start, num_rects);
+}
+
+static void *presenter_thread(void *arg) {
+        Presenter *pr = (Presenter *)arg;
+        stats_thread_start("presenter");
+        trace_thread_name("presenter");
+        pthread_mutex_lock(&pr->mutex);
+        while (1) {
+                if (!pr->dirty) {
+                        if (pr->stop) break;
+                        pthread_cond_wait(&pr->cond, &pr->mutex);
+                        continue;
+                }
+
+                // Damage that arrives within one refresh period shares an
+                // update. The first one after a quiet spell goes out at once.
+                pthread_mutex_unlock(&pr->mutex);
+                long period = session_frame_period_us(pr->ds);
+                pthread_mutex_lock(&pr->mutex);
+                long due = pr->last_update_us + period;
+                if (!pr->stop && get_time_us() < due) {
+                        struct timespec ts = us_to_timespec(due);
+                        pthread_cond_timedwait(&pr->cond, &pr->mutex, &ts);
+                        continue;
+                }
+
+                pthread_mutex_unlock(&pr->mutex);
+                publish(pr, pr->ds);
+                pthread_mutex_lock(&pr->mutex);
+        }
+        pthread_mutex_unlock(&pr->mutex);
+        return NULL;
+}
+
+int presenter_start(Presenter *pr, Display_Session *ds) {
+        pr->ds = ds;
+        pr->stop = 0;
+        pr->dirty = 0;
+        pr->num_rects = 0;
+        pr->last_update_us = 0;
+        init_monotonic_cond(&pr->cond);
+        if (pthread_create(&pr->thread, NULL, presenter_thread, pr) != 0) {
+                syslog(LOG_ERR, "Presenter: failed to start thread, updating the root per frame");
+                pthread_cond_destroy(&pr->cond);
+                return -1;
+        }
+        pthread_mutex_lock(&pr->mutex);
+        pr->running = 1;
+        pthread_mutex_unlock(&pr->mutex);
+        return 0;
+}
+
+void presenter_stop(Presenter *pr) {
+        pthread_mutex_lock(&pr->mutex);
+        if (!pr->running) {
+                pthread_mutex_unlock(&pr->mutex);
+                return;
+        }
+        pr->running = 0;
+        pr->stop = 1;
+        pthread_cond_signal(&pr->cond);
+        pthread_mutex_unlock(&pr->mutex);
+
+        pthread_join(pr->thread, NULL);
+        pthread_cond_destroy(&pr->cond);
+}
+
+void presenter_damage(Presenter *pr, int x, int y, int width, int height) {
+        if (width <= 0 || height <= 0) return;
+
+        pthread_mutex_lock(&pr->mutex);
+        if (!pr->dirty) {
+                pr->x1 = x;
+                pr->y1 = y;
+                pr->x2 = x + width;
+                pr->y2 = y + height;
+                pr->num_rects = 0;
+                pr->dirty = 1;
+                if (pr->running) pthread_cond_signal(&pr->cond);
+        } else {
+                if (x < pr->x1) pr->x1 = x;
+                if (y < pr->y1) pr->y1 = y;
+                if (x + width > pr->x2) pr->x2 = x + width;
+                if (y + height > pr->y2) pr->y2 = y + height;
+        }
+        if (pr->num_rects >= PRESENT_MAX_RECTS) {
+                pr->num_rects = -1;
+        } else if (pr->num_rects >= 0) {
+                pr->rects[pr->num_rects++] = (XRectangle){ .x = x, .y = y, .width = width, .height = height };
+        }
+        pr->damages++;
+        pthread_mutex_unlock(&pr->mutex);
+}
+
+void presenter_flush(Presenter *pr, Display_Session *ds) {
+        pthread_mutex_lock(&pr->mutex);
+        int skip = pr->running || !pr->dirty;
+        pthread_mutex_unlock(&pr->mutex);
+        if (!skip) publish(pr, ds);
+}
@@ -0,0 +1,456 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include <X11/Xatom.h>
+#include <X11/extensions/shape.h>
+
+#include "config.h"
+#ifdef HAVE_XPRESENT
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xpresent.h>
+#endif
+
+#include "AnimX-session.h"
+
+static int query_monitors(Display_Session *ds) {
+        int num_outputs = ds->screen_res->noutput;
+        int connected_count = 0;
+
+        // First pass: count connected monitors with valid CRTCs
+        for (int i = 0; i < num_outputs; i++) {
+                XRROutputInfo *output_info = XRRGetOutputInfo(ds->display, ds->screen_res, ds->screen_res->outputs[i]);
+                if (output_info && output_info->connection == RR_Connected && output_info->crtc) {
+                        XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(ds->display, ds->screen_res, output_info->crtc);
+                        if (crtc_info && crtc_info->width > 0 && crtc_info->height > 0) {
+                                connected_count++;
+                        }
+                        if (crtc_info) XRRFreeCrtcInfo(crtc_info);
+                }
+                if (output_info) XRRFreeOutputInfo(output_info);
+        }
+
+        if (connected_count == 0) {
+                syslog(LOG_ERR, "No connected monitors with valid CRTCs found\n");
+                fprintf(stderr, "No connected monitors with valid CRTCs found\n");
+                return -1;
+        }
+
+        ds->output_infos = (XRROutputInfo **)malloc(connected_count * sizeof(XRROutputInfo *));
+        ds->crtc_infos = (XRRCrtcInfo **)malloc(connected_count * sizeof(XRRCrtcInfo *));
+        ds->monitor_outputs = (int *)malloc(connected_count * sizeof(int));
+        if (!ds->output_infos || !ds->crtc_infos || !ds->monitor_outputs) {
+                syslog(LOG_ERR, "Failed to allocate monitor info arrays\n");
+                fprintf(stderr, "Failed to allocate monitor info arrays\n");
+                return -1;
+        }
+
+        // Second pass: collect connected monitor info
+        int idx = 0;
+        for (int i = 0; i < num_outputs && idx < connected_count; i++) {
+                XRROutputInfo *output_info = XRRGetOutputInfo(ds->display, ds->screen_res, ds->screen_res->outputs[i]);
+                if (output_info && output_info->connection == RR_Connected && output_info->crtc) {
+                        XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(ds->display, ds->screen_res, output_info->crtc);
+                        if (crtc_info && crtc_info->width > 0 && crtc_info->height > 0) {
+                                ds->output_infos[idx] = output_info;
+                                ds->crtc_infos[idx] = crtc_info;
+                                ds->monitor_outputs[idx] = i;
+                                printf("Monitor %d: %dx%d at (%ld,%ld)\n", idx, crtc_info->width, crtc_info->height, (long)crtc_info->x, (long)crtc_info->y);
+                                idx++;
+                        } else {
+                                if (crtc_info) XRRFreeCrtcInfo(crtc_info);
+                                XRRFreeOutputInfo(output_info);
+                        }
+                } else if (output_info) {
+                        XRRFreeOutputInfo(output_info);
+                }
+        }
+        ds->num_monitors = idx;
+
+        // Root updates are paced by the fastest monitor, see AnimX-present.c
+        ds->frame_period_us = 0;
+        for (int i = 0; i < idx; i++) {
+                for (int m = 0; m < ds->screen_res->nmode; m++) {
+                        XRRModeInfo *mode = &ds->screen_res->modes[m];
+                        if (mode->id != ds->crtc_infos[i]->mode || !mode->hTotal || !mode->vTotal || !mode->dotClock) {
+                                continue;
+                        }
+                        long period = (long)((double)mode->hTotal * mode->vTotal * 1000000.0 / mode->dotClock);
+                        if (period > 0 && (!ds->frame_period_us || period < ds->frame_period_us)) {
+                                ds->frame_period_us = period;
+                        }
+                }
+        }
+        if (!ds->frame_period_us) {
+                ds->frame_period_us = 1000000L / 60;
+        }
+
+        if (idx == 0) {
+                fprintf(stderr, "No valid CRTCs found for connected monitors\n");
+                return -1;
+        }
+        return 0;
+}
+
+static void free_monitors(Display_Session *ds) {
+        for (int i = 0; i < ds->num_monitors; i++) {
+                if (ds->crtc_infos && ds->crtc_infos[i]) XRRFreeCrtcInfo(ds->crtc_infos[i]);
+                if (ds->output_infos && ds->output_infos[i]) XRRFreeOutputInfo(ds->output_infos[i]);
+        }
+        if (ds->crtc_infos) free(ds->crtc_infos);
+        if (ds->output_infos) free(ds->output_infos);
+        if (ds->monitor_outputs) free(ds->monitor_outputs);
+        if (ds->screen_res) XRRFreeScreenResources(ds->screen_res);
+        ds->screen_res = NULL;
+        ds->output_infos = NULL;
+        ds->crtc_infos = NULL;
+        ds->monitor_outputs = NULL;
+        ds->num_monitors = 0;
+}
+
+// Points the root background and its properties at the front buffer
+static void set_root_background(Display_Session *ds) {
+        XSetWindowBackgroundPixmap(ds->display, ds->root, ds->front_pixmap);
+        XChangeProperty(ds->display, ds->root, ds->xrootpmap_id, XA_PIXMAP, 32, PropModeReplace,
+                        (unsigned char *)&ds->front_pixmap, 1);
+        XChangeProperty(ds->display, ds->root, ds->esetroot_pmap_id, XA_PIXMAP, 32, PropModeReplace,
+                        (unsigned char *)&ds->front_pixmap, 1);
+}
+
+// Publishes everything drawn so far as the desktop background
+static void install_root_pixmap(Display_Session *ds) {
+        XCopyArea(ds->display, ds->root_pixmap, ds->front_pixmap, ds->root_gc,
+                  0, 0, ds->root_width, ds->root_height, 0, 0);
+        set_root_background(ds);
+        XClearWindow(ds->display, ds->root);
+}
+
+// Creates both root pixmaps, black
+static void create_root_pixmaps(Display_Session *ds) {
+        ds->root_pixmap = XCreatePixmap(ds->display, ds->root, ds->root_width, ds->root_height, ds->depth);
+        ds->front_pixmap = XCreatePixmap(ds->display, ds->root, ds->root_width, ds->root_height, ds->depth);
+}
+
+// Creates a desktop window on every monitor, showing what the root
+// pixmap has there right now.
+static void create_desktops(Display_Session *ds) {
+        ds->desktops = (Desktop_Window *)calloc(ds->num_monitors ? ds->num_monitors : 1, sizeof(Desktop_Window));
+        if (!ds->desktops) {
+                syslog(LOG_ERR, "Failed to allocate desktop windows");
+                return;
+        }
+        Atom type = XInternAtom(ds->display, "_NET_WM_WINDOW_TYPE", False);
+        Atom desktop = XInternAtom(ds->display, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
+        int shape_event, shape_error;
+        int has_shape = XShapeQueryExtension(ds->display, &shape_event, &shape_error);
+
+        for (int i = 0; i < ds->num_monitors; i++) {
+                Desktop_Window *dw = &ds->desktops[ds->num_desktops++];
+                dw->x = ds->crtc_infos[i]->x;
+                dw->y = ds->crtc_infos[i]->y;
+                dw->width = ds->crtc_infos[i]->width;
+                dw->height = ds->crtc_infos[i]->height;
+                dw->pixmap = XCreatePixmap(ds->display, ds->root, dw->width, dw->height, ds->depth);
+                XCopyArea(ds->display, ds->root_pixmap, dw->pixmap, ds->root_gc,
+                          dw->x, dw->y, dw->width, dw->height, 0, 0);
+
+                XSetWindowAttributes attrs = { .background_pixmap = dw->pixmap, .override_redirect = True };
+                dw->window = XCreateWindow(ds->display, ds->root, dw->x, dw->y, dw->width, dw->height, 0,
+                                           ds->depth, InputOutput, ds->visual,
+                                           CWBackPixmap | CWOverrideRedirect, &attrs);
+                XChangeProperty(ds->display, dw->window, type, XA_ATOM, 32, PropModeReplace,
+                                (unsigned char *)&desktop, 1);
+                XStoreName(ds->display, dw->window, "AnimX");
+                // Clicks keep going to the root, for root menus and the like
+                if (has_shape) {
+                        XShapeCombineRectangles(ds->display, dw->window, ShapeInput, 0, 0, NULL, 0, ShapeSet, Unsorted);
+                }
+                XLowerWindow(ds->display, dw->window);
+                XMapWindow(ds->display, dw->window);
+        }
+        syslog(LOG_INFO, "Created %d desktop window(s)", ds->num_desktops);
+}
+
+static void destroy_desktops(Display_Session *ds) {
+        for (int i = 0; i < ds->num_desktops; i++) {
+                XDestroyWindow(ds->display, ds->desktops[i].window);
+                XFreePixmap(ds->display, ds->desktops[i].pixmap);
+        }
+        free(ds->desktops);
+        ds->desktops = NULL;
+        ds->num_desktops = 0;
+}
+
+static int open_display_session(Display_Session *ds) {
+        XInitThreads();
+
+        ds->display = XOpenDisplay(NULL);
+        if (!ds->display) {
+                syslog(LOG_ERR, "Cannot open X display\n");
+                fprintf(stderr, "Cannot open X display\n");
+                return -1;
+        }
+
+        ds->screen = DefaultScreen(ds->display);
+        ds->root = RootWindow(ds->display, ds->screen);
+        ds->visual = DefaultVisual(ds->display, ds->screen);
+        ds->depth = DefaultDepth(ds->display, ds->screen);
+        ds->root_width = DisplayWidth(ds->display, ds->screen);
+        ds->root_height = DisplayHeight(ds->display, ds->screen);
+
+        ds->screen_res = XRRGetScreenResources(ds->display, ds->root);
+        if (!ds->screen_res) {
+                syslog(LOG_ERR, "Failed to get screen resources\n");
+                fprintf(stderr, "Failed to get screen resources\n");
+                return -1;
+        }
+
+        if (query_monitors(ds) < 0) {
+                return -1;
+        }
+
+        // The root pixmap is only cleared once for the lifetime of the
+        // session. Later wallpapers draw over whatever the previous one left.
+        create_root_pixmaps(ds);
+        ds->root_gc = XCreateGC(ds->display, ds->root_pixmap, 0, NULL);
+        if (!ds->root_gc) {
+                fprintf(stderr, "Failed to create root GC\n");
+                return -1;
+        }
+        XFillRectangle(ds->display, ds->root_pixmap, ds->root_gc, 0, 0, ds->root_width, ds->root_height);
+        XFillRectangle(ds->display, ds->front_pixmap, ds->root_gc, 0, 0, ds->root_width, ds->root_height);
+
+        ds->has_present = 0;
+#ifdef HAVE_XPRESENT
+        int present_opcode, present_event, present_error;
+        ds->has_present = XPresentQueryExtension(ds->display, &present_opcode, &present_event, &present_error);
+#endif
+
+        ds->xrootpmap_id = XInternAtom(ds->display, "_XROOTPMAP_ID", False);
+        ds->esetroot_pmap_id = XInternAtom(ds->display, "ESETROOT_PMAP_ID", False);
+        ds->root_published = 0;
+        if (ds->backend == BACKEND_WINDOW) {
+                create_desktops(ds);
+        }
+
+        syslog(LOG_INFO, "Opened display session with %d monitor(s), root %ldx%ld, %s",
+               ds->num_monitors, ds->root_width, ds->root_height,
+               ds->has_present ? "flips synced to vblank" : "no Present extension");
+        return 0;
+}
+
+static void close_display_session(Display_Session *ds) {
+        if (ds->display) destroy_desktops(ds);
+        if (ds->root_gc) XFreeGC(ds->display, ds->root_gc);
+        if (ds->root_pixmap) XFreePixmap(ds->display, ds->root_pixmap);
+        if (ds->front_pixmap) XFreePixmap(ds->display, ds->front_pixmap);
+        free_monitors(ds);
+        if (ds->display) XCloseDisplay(ds->display);
+
+        ds->display = NULL;
+        ds->root_pixmap = 0;
+        ds->front_pixmap = 0;
+        ds->root_gc = NULL;
+}
+
+int init_display_session(Display_Session *ds) {
+        int ret = 0;
+        pthread_mutex_lock(&ds->lock);
+        if (!ds->display) {
+                ret = open_display_session(ds);
+                if (ret < 0) {
+                        close_display_session(ds);
+                }
+        }
+        pthread_mutex_unlock(&ds->lock);
+        return ret;
+}
+
+int session_refresh(Display_Session *ds) {
+        int ret = 0;
+        pthread_mutex_lock(&ds->lock);
+        if (!ds->display) {
+                pthread_mutex_unlock(&ds->lock);
+                return -1;
+        }
+
+        free_monitors(ds);
+        // The server has already probed the outputs when it sent the
+        // notify, no need to make it do so again.
+        ds->screen_res = XRRGetScreenResourcesCurrent(ds->display, ds->root);
+        if (!ds->screen_res || query_monitors(ds) < 0) {
+                syslog(LOG_ERR, "Failed to re-read monitors after a RandR change");
+                ret = -1;
+        }
+
+        // DisplayWidth/Height are only updated for clients that process
+        // the notify themselves, ask the server instead.
+        Window root_ret;
+        int x, y;
+        unsigned int width, height, border, depth;
+        if (XGetGeometry(ds->display, ds->root, &root_ret, &x, &y, &width, &height, &border, &depth)
+            && ((long)width != ds->root_width || (long)height != ds->root_height)) {
+                Pixmap old_back = ds->root_pixmap, old_front = ds->front_pixmap;
+                ds->root_width = width;
+                ds->root_height = height;
+                create_root_pixmaps(ds);
+                XFillRectangle(ds->display, ds->root_pixmap, ds->root_gc, 0, 0, ds->root_width, ds->root_height);
+                install_root_pixmap(ds);
+                ds->root_published = 1;
+                if (old_back) XFreePixmap(ds->display, old_back);
+                if (old_front) XFreePixmap(ds->display, old_front);
+        }
+        if (ds->backend == BACKEND_WINDOW) {
+                destroy_desktops(ds);
+                create_desktops(ds);
+        }
+        XFlush(ds->display);
+
+        ds->layout_gen++;
+        syslog(LOG_INFO, "Refreshed display session: %d monitor(s), root %ldx%ld",
+               ds->num_monitors, ds->root_width, ds->root_height);
+        pthread_mutex_unlock(&ds->lock);
+        return ret;
+}
+
+unsigned session_layout_gen(Display_Session *ds) {
+        pthread_mutex_lock(&ds->lock);
+        unsigned gen = ds->layout_gen;
+        pthread_mutex_unlock(&ds->lock);
+        return gen;
+}
+
+// Repaints the given areas of the root from the front buffer, at the
+// next vblank when the server has the Present extension.
+static void present_root(Display_Session *ds, const XRectangle *rects, int num_rects) {
+#ifdef HAVE_XPRESENT
+        if (ds->has_present) {
+                XserverRegion update = XFixesCreateRegion(ds->display, (XRectangle *)rects, num_rects);
+                XPresentPixmap(ds->display, ds->root, ds->front_pixmap, ds->present_serial++,
+                               None, update, 0, 0, None, None, None, PresentOptionNone, 0, 0, 0, NULL, 0);
+                XFixesDestroyRegion(ds->display, update);
+                return;
+        }
+#endif
+        for (int i = 0; i < num_rects; i++) {
+                XClearArea(ds->display, ds->root, rects[i].x, rects[i].y,
+                           rects[i].width, rects[i].height, False);
+        }
+}
+
+void session_present(Display_Session *ds, const XRectangle *rects, int num_rects) {
+        pthread_mutex_lock(&ds->lock);
+        session_present_locked(ds, rects, num_rects);
+        pthread_mutex_unlock(&ds->lock);
+}
+
+void session_present_locked(Display_Session *ds, const XRectangle *rects, int num_rects) {
+        if (!ds->display) return;
+
+        if (ds->backend == BACKEND_ROOT) {
+                // Flip: what the pipelines drew becomes the background
+                Pixmap drawn = ds->root_pixmap;
+                ds->root_pixmap = ds->front_pixmap;
+                ds->front_pixmap = drawn;
+                set_root_background(ds);
+                present_root(ds, rects, num_rects);
+
+                // Bring the new back buffer up to date before anyone draws
+                // into it. The one just shown was presented a refresh ago at
+                // the earliest, so the server is done reading it.
+                for (int i = 0; i < num_rects; i++) {
+                        XCopyArea(ds->display, ds->front_pixmap, ds->root_pixmap, ds->root_gc,
+                                  rects[i].x, rects[i].y, rects[i].width, rects[i].height, rects[i].x, rects[i].y);
+                }
+                XFlush(ds->display);
+                return;
+        }
+
+        // Desktop windows: the root only changes for a new fallback frame,
+        // everything else is a copy into the damaged part of a window
+        if (!ds->root_published) {
+                install_root_pixmap(ds);
+                ds->root_published = 1;
+        }
+        for (int d = 0; d < ds->num_desktops; d++) {
+                Desktop_Window *dw = &ds->desktops[d];
+                for (int i = 0; i < num_rects; i++) {
+                        int x1 = rects[i].x > dw->x ? rects[i].x : dw->x;
+                        int y1 = rects[i].y > dw->y ? rects[i].y : dw->y;
+                        int x2 = rects[i].x + rects[i].width < dw->x + dw->width ? rects[i].x + rects[i].width : dw->x + dw->width;
+                        int y2 = rects[i].y + rects[i].height < dw->y + dw->height ? rects[i].y + rects[i].height : dw->y + dw->height;
+                        if (x2 <= x1 || y2 <= y1) continue;
+                        XCopyArea(ds->display, ds->root_pixmap, dw->pixmap, ds->root_gc,
+                                  x1, y1, x2 - x1, y2 - y1, x1 - dw->x, y1 - dw->y);
+                        XClearArea(ds->display, dw->window, x1 - dw->x, y1 - dw->y, x2 - x1, y2 - y1, False);
+                }
+        }
+        XFlush(ds->display);
+}
+
+void session_set_backend(Display_Session *ds, Backend_Type backend) {
+        pthread_mutex_lock(&ds->lock);
+        if (ds->backend == backend) {
+                pthread_mutex_unlock(&ds->lock);
+                return;
+        }
+        ds->backend = backend;
+        if (ds->display) {
+                if (backend == BACKEND_WINDOW) {
+                        create_desktops(ds);
+                } else {
+                        destroy_desktops(ds);
+                }
+                install_root_pixmap(ds);
+                ds->root_published = 1;
+                XFlush(ds->display);
+        }
+        syslog(LOG_INFO, "Switched to the %s backend", backend == BACKEND_WINDOW ? "window" : "root");
+        pthread_mutex_unlock(&ds->lock);
+}
+
+long session_frame_period_us(Display_Session *ds) {
+        pthread_mutex_lock(&ds->lock);
+        long period = ds->display ? ds->frame_period_us : 1000000L / 60;
+        pthread_mutex_unlock(&ds->lock);
+        return period;
+}
+
+int session_monitor_of_output(Display_Session *ds, int output) {
+        int monitor = -1;
+        pthread_mutex_lock(&ds->lock);
+        for (int i = 0; i < ds->num_monitors; i++) {
+                if (ds->monitor_outputs[i] == output) {
+                        monitor = i;
+                        break;
+                }
+        }
+        pthread_mutex_unlock(&ds->lock);
+        return monitor;
+}
+
+void cleanup_display_session(Display_Session *ds) {
+        pthread_mutex_lock(&ds->lock);
+        close_display_session(ds);
+        pthread_mutex_unlock(&ds->lock);
+}
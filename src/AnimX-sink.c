@@ -0,0 +1,148 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <syslog.h>
+
+#include "AnimX-sink.h"
+
+static int cmp_frames(const void *a, const void *b) {
+        unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+        return (x > y) - (x < y);
+}
+
+static int parse_select(Sink *sink, const char *list) {
+        int n = 1;
+        for (const char *p = list; *p; p++) {
+                if (*p == ',') n++;
+        }
+        sink->select = (unsigned long *)malloc(n * sizeof(unsigned long));
+        if (!sink->select) return -1;
+        const char *p = list;
+        for (int i = 0; i < n; i++) {
+                char *end;
+                errno = 0;
+                sink->select[i] = strtoul(p, &end, 10);
+                if (end == p || errno || (*end && *end != ',')) return -1;
+                p = end + (*end == ',');
+        }
+        qsort(sink->select, n, sizeof(unsigned long), cmp_frames);
+        sink->num_select = n;
+        return 0;
+}
+
+int sink_parse(Sink *sink, const char *spec) {
+        if (!strcmp(spec, "x11")) {
+                sink->type = SINK_X11;
+                return 0;
+        }
+        if (!strcmp(spec, "null")) {
+                sink->type = SINK_NULL;
+                return 0;
+        }
+        if (strncmp(spec, "dump:", 5) != 0 || !spec[5]) {
+                return -1;
+        }
+        sink->type = SINK_DUMP;
+        sink->dir = strdup(spec + 5);
+        if (!sink->dir) return -1;
+        // A trailing `:<list>` only counts if it is one, a directory may contain ':'
+        char *colon = strrchr(sink->dir, ':');
+        if (colon && colon[1] && strspn(colon + 1, "0123456789,") == strlen(colon + 1)) {
+                *colon = '\0';
+                if (parse_select(sink, colon + 1) < 0) return -1;
+        }
+        return 0;
+}
+
+// Binary PPM, so any image tool can diff the result against a golden copy
+static int write_ppm(Sink *sink, const char *path, const uint8_t *data, int width, int height) {
+        size_t row_size = (size_t)width * 3;
+        if (row_size > sink->row_size) {
+                // Sized at the first frame, only grows on a relayout
+                uint8_t *row = (uint8_t *)realloc(sink->row, row_size);
+                if (!row) {
+                        syslog(LOG_ERR, "Sink: failed to allocate a %d pixel row", width);
+                        return -1;
+                }
+                sink->row = row;
+                sink->row_size = row_size;
+        }
+        uint8_t *row = sink->row;
+        FILE *f = fopen(path, "wb");
+        if (!f) {
+                syslog(LOG_ERR, "Sink: cannot create %s: %s", path, strerror(errno));
+                fprintf(stderr, "Sink: cannot create %s: %s\n", path, strerror(errno));
+                return -1;
+        }
+        fprintf(f, "P6\n%d %d\n255\n", width, height);
+        for (int y = 0; y < height; y++) {
+                const uint8_t *src = data + (size_t)y * width * 4;
+                for (int x = 0; x < width; x++) {
+                        row[x * 3 + 0] = src[x * 4 + 2];
+                        row[x * 3 + 1] = src[x * 4 + 1];
+                        row[x * 3 + 2] = src[x * 4 + 0];
+                }
+                fwrite(row, 3, width, f);
+        }
+        if (fclose(f) != 0) {
+                syslog(LOG_ERR, "Sink: failed to write %s", path);
+                fprintf(stderr, "Sink: failed to write %s\n", path);
+                return -1;
+        }
+        return 0;
+}
+
+int sink_frame(Sink *sink, const uint8_t *data, int width, int height) {
+        unsigned long n = sink->frames++;
+        if (sink->type != SINK_DUMP) {
+                return 0;
+        }
+        if (sink->select) {
+                if (sink->next_select >= sink->num_select || sink->select[sink->next_select] != n) {
+                        return 0;
+                }
+                // Duplicates in the list are written once
+                while (sink->next_select < sink->num_select && sink->select[sink->next_select] == n) {
+                        sink->next_select++;
+                }
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/frame-%06lu.ppm", sink->dir, n);
+        return write_ppm(sink, path, data, width, height);
+}
+
+int sink_done(const Sink *sink) {
+        return sink->type == SINK_DUMP && sink->select && sink->next_select >= sink->num_select;
+}
+
+void sink_cleanup(Sink *sink) {
+        free(sink->dir);
+        free(sink->select);
+        free(sink->row);
+        sink->dir = NULL;
+        sink->select = NULL;
+        sink->row = NULL;
+        sink->row_size = 0;
+}
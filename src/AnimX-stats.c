@@ -0,0 +1,420 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#define _GNU_SOURCE // pthread_setname_np(), RUSAGE_THREAD, syscall()
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "AnimX-log.h"
+#include "AnimX-stats.h"
+#include "AnimX-utils.h"
+
+#define SUB_BITS 4
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define NUM_BUCKETS (SUB_BUCKETS * 40) // Up to about 2^42 us
+
+typedef struct {
+        atomic_ulong buckets[NUM_BUCKETS];
+        atomic_ulong total;
+        atomic_ulong sum;
+        atomic_ulong max;
+} Histogram;
+
+static Histogram g_histograms[NUM_STAGES];
+static atomic_ulong g_counts[NUM_COUNTS];
+
+static const char *stage_names[NUM_STAGES] = {
+        [STAGE_DEMUX] = "demux",
+        [STAGE_DECODE] = "decode",
+        [STAGE_SCALE] = "scale",
+        [STAGE_UPLOAD] = "upload",
+        [STAGE_PRESENT] = "present",
+};
+
+static const char *count_names[NUM_COUNTS] = {
+        [COUNT_PRESENTED] = "presented",
+        [COUNT_DROPPED] = "dropped",
+        [COUNT_LATE] = "late",
+        [COUNT_DUPLICATED] = "duplicated",
+        [COUNT_DISCARDED] = "discarded",
+};
+
+// Values below SUB_BUCKETS get a bucket each. Above that every power of
+// two is split into SUB_BUCKETS buckets by the bits below its top bit.
+static int bucket_of(unsigned long value) {
+        if (value < SUB_BUCKETS) return (int)value;
+        int top = 63 - __builtin_clzl(value);
+        int idx = (top - SUB_BITS + 1) * SUB_BUCKETS + (int)((value >> (top - SUB_BITS)) & (SUB_BUCKETS - 1));
+        return idx < NUM_BUCKETS ? idx : NUM_BUCKETS - 1;
+}
+
+// Largest value that lands in bucket `idx`
+static unsigned long bucket_value(int idx) {
+        if (idx < SUB_BUCKETS) return (unsigned long)idx;
+        int top = idx / SUB_BUCKETS + SUB_BITS - 1;
+        unsigned long sub = (unsigned long)(idx % SUB_BUCKETS);
+        int shift = top - SUB_BITS;
+        return ((SUB_BUCKETS | sub) << shift) + ((1UL << shift) - 1);
+}
+
+// One per thread ever started, reused by the next thread of the same
+// name once it exited so workers coming and going add up
+typedef struct {
+        char name[16];
+        pid_t tid;             // 0 once the thread exited
+        Stats_Thread retired;  // Exited threads of this slot
+        Stats_Thread base;     // Subtracted from everything since stats_reset()
+} Thread_Slot;
+
+static pthread_mutex_t g_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static Thread_Slot g_threads[STATS_MAX_THREADS];
+static pthread_key_t g_thread_key;
+static pthread_once_t g_thread_once = PTHREAD_ONCE_INIT;
+
+static struct {
+        pthread_t thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        int running, stop;
+        long interval_us;
+} g_threads_log = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+void stats_record(Stats_Stage stage, long us) {
+        Histogram *h = &g_histograms[stage];
+        unsigned long value = us > 0 ? (unsigned long)us : 0;
+        atomic_fetch_add_explicit(&h->buckets[bucket_of(value)], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&h->total, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&h->sum, value, memory_order_relaxed);
+        unsigned long max = atomic_load_explicit(&h->max, memory_order_relaxed);
+        while (value > max && !atomic_compare_exchange_weak_explicit(&h->max, &max, value,
+                                                                     memory_order_relaxed, memory_order_relaxed)) {
+        }
+}
+
+void stats_count(Stats_Count what, unsigned long n) {
+        atomic_fetch_add_explicit(&g_counts[what], n, memory_order_relaxed);
+}
+
+// Works on a snapshot, so concurrent updates only shift the result by
+// the samples that arrived while reading.
+static void percentiles(Histogram *h, const int *permille, unsigned long *out, int n) {
+        unsigned long counts[NUM_BUCKETS];
+        unsigned long total = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+                counts[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+                total += counts[i];
+        }
+        for (int p = 0; p < n; p++) {
+                unsigned long rank = (total * permille[p] + 999) / 1000;
+                unsigned long seen = 0;
+                out[p] = 0;
+                for (int i = 0; i < NUM_BUCKETS && total; i++) {
+                        seen += counts[i];
+                        if (seen >= rank) {
+                                out[p] = bucket_value(i);
+                                break;
+                        }
+                }
+        }
+}
+
+void stats_summary(Stats_Stage stage, Stats_Summary *out) {
+        static const int permille[] = { 500, 950, 990 };
+        Histogram *h = &g_histograms[stage];
+        unsigned long pct[3];
+        percentiles(h, permille, pct, 3);
+        out->count = atomic_load_explicit(&h->total, memory_order_relaxed);
+        out->total_us = atomic_load_explicit(&h->sum, memory_order_relaxed);
+        out->p50_us = pct[0];
+        out->p95_us = pct[1];
+        out->p99_us = pct[2];
+        out->max_us = atomic_load_explicit(&h->max, memory_order_relaxed);
+}
+
+unsigned long stats_counter(Stats_Count what) {
+        return atomic_load_explicit(&g_counts[what], memory_order_relaxed);
+}
+
+const char *stats_stage_name(Stats_Stage stage) {
+        return stage_names[stage];
+}
+
+const char *stats_count_name(Stats_Count what) {
+        return count_names[what];
+}
+
+static void add_usage(Stats_Thread *to, const Stats_Thread *from) {
+        to->user_us += from->user_us;
+        to->system_us += from->system_us;
+        to->vcsw += from->vcsw;
+        to->ivcsw += from->ivcsw;
+        to->minflt += from->minflt;
+        to->majflt += from->majflt;
+}
+
+// Clamped at 0, a thread reusing a slot may have used less than `b`
+static unsigned long sub_clamp(unsigned long a, unsigned long b) {
+        return a > b ? a - b : 0;
+}
+
+// Runs in the exiting thread, so RUSAGE_THREAD is still its own
+static void thread_exited(void *arg) {
+        Thread_Slot *slot = (Thread_Slot *)arg;
+        struct rusage ru;
+        Stats_Thread usage = {0};
+        if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+                usage.user_us = (unsigned long)ru.ru_utime.tv_sec * 1000000UL + (unsigned long)ru.ru_utime.tv_usec;
+                usage.system_us = (unsigned long)ru.ru_stime.tv_sec * 1000000UL + (unsigned long)ru.ru_stime.tv_usec;
+                usage.vcsw = (unsigned long)ru.ru_nvcsw;
+                usage.ivcsw = (unsigned long)ru.ru_nivcsw;
+                usage.minflt = (unsigned long)ru.ru_minflt;
+                usage.majflt = (unsigned long)ru.ru_majflt;
+        }
+        pthread_mutex_lock(&g_threads_lock);
+        add_usage(&slot->retired, &usage);
+        slot->tid = 0;
+        pthread_mutex_unlock(&g_threads_lock);
+}
+
+static void create_thread_key(void) {
+        pthread_key_create(&g_thread_key, thread_exited);
+}
+
+void stats_thread_start(const char *name) {
+        char short_name[16];
+        snprintf(short_name, sizeof(short_name), "%s", name);
+        pid_t tid = (pid_t)syscall(SYS_gettid);
+        if (tid != getpid()) { // The main thread keeps the process name for ps and killall
+                pthread_setname_np(pthread_self(), short_name);
+        }
+        pthread_once(&g_thread_once, create_thread_key);
+
+        Thread_Slot *slot = NULL;
+        pthread_mutex_lock(&g_threads_lock);
+        for (int i = 0; i < STATS_MAX_THREADS && !slot; i++) {
+                if (g_threads[i].name[0] && g_threads[i].tid == 0 && !strcmp(g_threads[i].name, short_name)) {
+                        slot = &g_threads[i];
+                }
+        }
+        for (int i = 0; i < STATS_MAX_THREADS && !slot; i++) {
+                if (!g_threads[i].name[0]) {
+                        slot = &g_threads[i];
+                        memcpy(slot->name, short_name, sizeof(short_name));
+                }
+        }
+        if (slot) {
+                slot->tid = tid;
+        }
+        pthread_mutex_unlock(&g_threads_lock);
+        // The main thread never runs key destructors, it just stops being sampled
+        if (slot) pthread_setspecific(g_thread_key, slot);
+}
+
+// Reads a live thread from /proc/self/task/<tid>/{stat,status}
+static void read_task(pid_t tid, Stats_Thread *usage) {
+        char path[64], line[512];
+        snprintf(path, sizeof(path), "/proc/self/task/%d/stat", (int)tid);
+        FILE *f = fopen(path, "r");
+        if (f) {
+                if (fgets(line, sizeof(line), f)) {
+                        // Fields after the name, which may itself contain spaces and parens
+                        const char *rest = strrchr(line, ')');
+                        unsigned long utime = 0, stime = 0;
+                        if (rest && sscanf(rest + 1, " %*c %*d %*d %*d %*d %*d %*u %lu %*u %lu %*u %lu %lu",
+                                           &usage->minflt, &usage->majflt, &utime, &stime) == 4) {
+                                long hz = sysconf(_SC_CLK_TCK);
+                                if (hz > 0) {
+                                        usage->user_us = utime * (1000000UL / (unsigned long)hz);
+                                        usage->system_us = stime * (1000000UL / (unsigned long)hz);
+                                }
+                        }
+                }
+                fclose(f);
+        }
+        snprintf(path, sizeof(path), "/proc/self/task/%d/status", (int)tid);
+        f = fopen(path, "r");
+        if (f) {
+                while (fgets(line, sizeof(line), f)) {
+                        sscanf(line, "voluntary_ctxt_switches: %lu", &usage->vcsw);
+                        sscanf(line, "nonvoluntary_ctxt_switches: %lu", &usage->ivcsw);
+                }
+                fclose(f);
+        }
+}
+
+// Everything slot `i` used so far, without `base`. Expects g_threads_lock held.
+static void slot_usage(int i, Stats_Thread *usage) {
+        Thread_Slot *slot = &g_threads[i];
+        *usage = slot->retired;
+        if (slot->tid) {
+                Stats_Thread live = {0};
+                read_task(slot->tid, &live);
+                add_usage(usage, &live);
+                usage->live = 1;
+        }
+}
+
+int stats_threads(Stats_Thread *out, int max) {
+        int n = 0;
+        pthread_mutex_lock(&g_threads_lock);
+        for (int i = 0; i < STATS_MAX_THREADS && g_threads[i].name[0]; i++) {
+                Stats_Thread usage;
+                slot_usage(i, &usage);
+                const Stats_Thread *base = &g_threads[i].base;
+                usage.user_us = sub_clamp(usage.user_us, base->user_us);
+                usage.system_us = sub_clamp(usage.system_us, base->system_us);
+                usage.vcsw = sub_clamp(usage.vcsw, base->vcsw);
+                usage.ivcsw = sub_clamp(usage.ivcsw, base->ivcsw);
+                usage.minflt = sub_clamp(usage.minflt, base->minflt);
+                usage.majflt = sub_clamp(usage.majflt, base->majflt);
+
+                int j = 0;
+                while (j < n && strcmp(out[j].name, g_threads[i].name)) j++;
+                if (j == n) {
+                        if (n == max) continue;
+                        memset(&out[n], 0, sizeof(out[n]));
+                        memcpy(out[n].name, g_threads[i].name, sizeof(out[n].name));
+                        n++;
+                }
+                add_usage(&out[j], &usage);
+                out[j].live += usage.live;
+        }
+        pthread_mutex_unlock(&g_threads_lock);
+        return n;
+}
+
+static void *threads_log_thread(void *arg) {
+        (void)arg;
+        stats_thread_start("threadstats");
+        Stats_Thread threads[STATS_MAX_THREADS];
+        pthread_mutex_lock(&g_threads_log.mutex);
+        while (!g_threads_log.stop) {
+                struct timespec deadline = us_to_timespec(get_time_us() + g_threads_log.interval_us);
+                pthread_cond_timedwait(&g_threads_log.cond, &g_threads_log.mutex, &deadline);
+                if (g_threads_log.stop) break;
+                pthread_mutex_unlock(&g_threads_log.mutex);
+                int n = stats_threads(threads, STATS_MAX_THREADS);
+                for (int i = 0; i < n; i++) {
+                        log_info("Thread %s (%d running): user %lums, system %lums, %lu/%lu context switches "
+                                 "(voluntary/involuntary), %lu/%lu page faults (minor/major)",
+                                 threads[i].name, threads[i].live, threads[i].user_us / 1000, threads[i].system_us / 1000,
+                                 threads[i].vcsw, threads[i].ivcsw, threads[i].minflt, threads[i].majflt);
+                }
+                pthread_mutex_lock(&g_threads_log.mutex);
+        }
+        pthread_mutex_unlock(&g_threads_log.mutex);
+        return NULL;
+}
+
+int stats_threads_log_start(int seconds) {
+        if (g_threads_log.running) return 0;
+        init_monotonic_cond(&g_threads_log.cond);
+        g_threads_log.interval_us = (long)seconds * 1000000L;
+        g_threads_log.stop = 0;
+        if (pthread_create(&g_threads_log.thread, NULL, threads_log_thread, NULL) != 0) {
+                log_error("Failed to create the thread stats logger");
+                pthread_cond_destroy(&g_threads_log.cond);
+                return -1;
+        }
+        g_threads_log.running = 1;
+        return 0;
+}
+
+void stats_threads_log_stop(void) {
+        if (!g_threads_log.running) return;
+        pthread_mutex_lock(&g_threads_log.mutex);
+        g_threads_log.stop = 1;
+        pthread_cond_signal(&g_threads_log.cond);
+        pthread_mutex_unlock(&g_threads_log.mutex);
+        pthread_join(g_threads_log.thread, NULL);
+        pthread_cond_destroy(&g_threads_log.cond);
+        g_threads_log.running = 0;
+}
+
+int stats_format(char *buf, size_t len) {
+        int n = 0;
+        for (int s = 0; s < NUM_STAGES; s++) {
+                Stats_Summary sum;
+                stats_summary((Stats_Stage)s, &sum);
+                size_t at = (size_t)n < len ? (size_t)n : len;
+                n += snprintf(buf + at, len - at,
+                              "%s.count=%lu\n"
+                              "%s.p50_us=%lu\n"
+                              "%s.p95_us=%lu\n"
+                              "%s.p99_us=%lu\n"
+                              "%s.max_us=%lu\n",
+                              stage_names[s], sum.count,
+                              stage_names[s], sum.p50_us,
+                              stage_names[s], sum.p95_us,
+                              stage_names[s], sum.p99_us,
+                              stage_names[s], sum.max_us);
+        }
+        for (int c = 0; c < NUM_COUNTS; c++) {
+                size_t at = (size_t)n < len ? (size_t)n : len;
+                n += snprintf(buf + at, len - at, "frames.%s=%lu\n", count_names[c], stats_counter((Stats_Count)c));
+        }
+        Stats_Thread threads[STATS_MAX_THREADS];
+        int num_threads = stats_threads(threads, STATS_MAX_THREADS);
+        for (int t = 0; t < num_threads; t++) {
+                const Stats_Thread *th = &threads[t];
+                size_t at = (size_t)n < len ? (size_t)n : len;
+                n += snprintf(buf + at, len - at,
+                              "thread.%s.running=%d\n"
+                              "thread.%s.user_ms=%lu\n"
+                              "thread.%s.system_ms=%lu\n"
+                              "thread.%s.vcsw=%lu\n"
+                              "thread.%s.ivcsw=%lu\n"
+                              "thread.%s.minflt=%lu\n"
+                              "thread.%s.majflt=%lu\n",
+                              th->name, th->live,
+                              th->name, th->user_us / 1000,
+                              th->name, th->system_us / 1000,
+                              th->name, th->vcsw,
+                              th->name, th->ivcsw,
+                              th->name, th->minflt,
+                              th->name, th->majflt);
+        }
+        return n;
+}
+
+void stats_reset(void) {
+        for (int s = 0; s < NUM_STAGES; s++) {
+                for (int i = 0; i < NUM_BUCKETS; i++) {
+                        atomic_store_explicit(&g_histograms[s].buckets[i], 0, memory_order_relaxed);
+                }
+                atomic_store_explicit(&g_histograms[s].total, 0, memory_order_relaxed);
+                atomic_store_explicit(&g_histograms[s].sum, 0, memory_order_relaxed);
+                atomic_store_explicit(&g_histograms[s].max, 0, memory_order_relaxed);
+        }
+        for (int c = 0; c < NUM_COUNTS; c++) {
+                atomic_store_explicit(&g_counts[c], 0, memory_order_relaxed);
+        }
+        pthread_mutex_lock(&g_threads_lock);
+        for (int i = 0; i < STATS_MAX_THREADS && g_threads[i].name[0]; i++) {
+                slot_usage(i, &g_threads[i].base);
+        }
+        pthread_mutex_unlock(&g_threads_lock);
+}
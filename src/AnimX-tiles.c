@@ -0,0 +1,98 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+
+#include "AnimX-tiles.h"
+
+static int tile_changed(const uint8_t *prev, const uint8_t *cur, int stride, int width, int height) {
+        // memcmp is vectorised by libc and stops at the first difference,
+        // which is as far as a moving tile ever needs to be read
+        for (int y = 0; y < height; y++) {
+                if (memcmp(prev + (size_t)y * stride, cur + (size_t)y * stride, (size_t)width * 4) != 0) {
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+int tiles_diff(const Context *ctx, const uint8_t *prev, const uint8_t *cur, uint8_t *mask) {
+        int changed = 0;
+        for (int s = 0; s < ctx->num_surfaces; s++) {
+                const Surface *sf = &ctx->surfaces[s];
+                int stride = sf->width * 4;
+                for (int ty = 0; ty < sf->tiles_y; ty++) {
+                        int y = ty * TILE_SIZE;
+                        int height = sf->height - y < TILE_SIZE ? sf->height - y : TILE_SIZE;
+                        for (int tx = 0; tx < sf->tiles_x; tx++) {
+                                int x = tx * TILE_SIZE;
+                                int width = sf->width - x < TILE_SIZE ? sf->width - x : TILE_SIZE;
+                                size_t at = sf->offset + (size_t)y * stride + (size_t)x * 4;
+                                uint8_t dirty = (uint8_t)tile_changed(prev + at, cur + at, stride, width, height);
+                                mask[sf->tile_offset + ty * sf->tiles_x + tx] = dirty;
+                                changed += dirty;
+                        }
+                }
+        }
+        return changed;
+}
+
+int tiles_rects(const Context *ctx, int s, const uint8_t *mask, XRectangle *rects) {
+        const Surface *sf = &ctx->surfaces[s];
+        const uint8_t *tiles = mask + sf->tile_offset;
+        int num_rects = 0;
+        if (sf->tiles_x == 0) return 0;
+
+        // Runs of changed tiles within a row become one rectangle, and a
+        // run covering the same columns as one in the row above extends
+        // that rectangle downwards instead. `open[tx]` is the rectangle
+        // ending at the row above whose run started at column tx.
+        int *open = ctx->tile_runs, *next = ctx->tile_runs + sf->tiles_x;
+        for (int tx = 0; tx < sf->tiles_x; tx++) open[tx] = -1;
+
+        for (int ty = 0; ty < sf->tiles_y; ty++) {
+                int y = ty * TILE_SIZE;
+                int height = sf->height - y < TILE_SIZE ? sf->height - y : TILE_SIZE;
+                for (int tx = 0; tx < sf->tiles_x; tx++) next[tx] = -1;
+
+                int tx = 0;
+                while (tx < sf->tiles_x) {
+                        if (!tiles[ty * sf->tiles_x + tx]) {
+                                tx++;
+                                continue;
+                        }
+                        int start = tx;
+                        while (tx < sf->tiles_x && tiles[ty * sf->tiles_x + tx]) tx++;
+                        int x = start * TILE_SIZE;
+                        int width = (tx * TILE_SIZE < sf->width ? tx * TILE_SIZE : sf->width) - x;
+
+                        int r = open[start];
+                        if (r >= 0 && rects[r].width == width) {
+                                rects[r].height += height;
+                        } else {
+                                r = num_rects++;
+                                rects[r] = (XRectangle){ .x = x, .y = y, .width = width, .height = height };
+                        }
+                        next[start] = r;
+                }
+                memcpy(open, next, sf->tiles_x * sizeof(int));
+        }
+        return num_rects;
+}
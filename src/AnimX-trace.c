@@ -0,0 +1,174 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "AnimX-trace.h"
+
+typedef struct {
+        long ts, dur; // Microseconds since trace_open()
+        long arg;
+        int ev;
+} Trace_Record;
+
+// Written only by its thread. `head` is published with release order so
+// trace_close() sees complete records.
+typedef struct Trace_Ring {
+        struct Trace_Ring *next;
+        int retired; // Its thread exited, under `g_rings_mutex`
+        long tid;
+        char name[32];
+        atomic_ulong head; // Records ever written, the ring keeps the last TRACE_RING_EVENTS
+        Trace_Record records[TRACE_RING_EVENTS];
+} Trace_Ring;
+
+atomic_int g_tracing = 0;
+
+static FILE *g_trace_file;
+static long g_trace_epoch_us;
+static pthread_mutex_t g_rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Trace_Ring *g_rings; // Newest first, see retire_ring()
+static int g_num_retired;
+static __thread Trace_Ring *t_ring;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+
+static const char *event_names[NUM_TRACE_EVENTS] = {
+        [TRACE_DEMUX] = "demux",
+        [TRACE_DECODE] = "decode",
+        [TRACE_SCALE] = "scale",
+        [TRACE_RING_WAIT] = "ring_wait",
+        [TRACE_UPLOAD] = "upload",
+        [TRACE_PRESENT] = "present",
+        [TRACE_SLEEP] = "sleep",
+        [TRACE_SEEK] = "seek",
+        [TRACE_WORKER] = "worker",
+};
+
+// Runs as a thread exits. Its ring stays for trace_close(), but past
+// TRACE_MAX_RETIRED the oldest ring of an exited thread is dropped.
+static void retire_ring(void *arg) {
+        Trace_Ring *ring = (Trace_Ring *)arg;
+        t_ring = NULL;
+        pthread_mutex_lock(&g_rings_mutex);
+        ring->retired = 1;
+        if (++g_num_retired > TRACE_MAX_RETIRED) {
+                Trace_Ring **oldest = NULL;
+                for (Trace_Ring **p = &g_rings; *p; p = &(*p)->next) {
+                        if ((*p)->retired) oldest = p;
+                }
+                Trace_Ring *drop = *oldest;
+                *oldest = drop->next;
+                free(drop);
+                g_num_retired--;
+        }
+        pthread_mutex_unlock(&g_rings_mutex);
+}
+
+static void create_ring_key(void) {
+        pthread_key_create(&g_ring_key, retire_ring);
+}
+
+static Trace_Ring *thread_ring(void) {
+        if (t_ring) return t_ring;
+        pthread_once(&g_ring_key_once, create_ring_key);
+        Trace_Ring *ring = (Trace_Ring *)calloc(1, sizeof(Trace_Ring));
+        if (!ring) return NULL;
+        if (pthread_setspecific(g_ring_key, ring) != 0) {
+                free(ring);
+                return NULL;
+        }
+        ring->tid = (long)syscall(SYS_gettid);
+        snprintf(ring->name, sizeof(ring->name), "thread %ld", ring->tid);
+        pthread_mutex_lock(&g_rings_mutex);
+        ring->next = g_rings;
+        g_rings = ring;
+        pthread_mutex_unlock(&g_rings_mutex);
+        t_ring = ring;
+        return ring;
+}
+
+void trace_record(Trace_Event ev, long start_us, long end_us, long arg) {
+        Trace_Ring *ring = thread_ring();
+        if (!ring) return;
+        unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        Trace_Record *r = &ring->records[head % TRACE_RING_EVENTS];
+        r->ts = start_us - g_trace_epoch_us;
+        r->dur = end_us - start_us;
+        r->arg = arg;
+        r->ev = ev;
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void trace_thread_name(const char *name) {
+        if (!atomic_load_explicit(&g_tracing, memory_order_relaxed)) return;
+        Trace_Ring *ring = thread_ring();
+        if (ring) snprintf(ring->name, sizeof(ring->name), "%s", name);
+}
+
+int trace_open(const char *path) {
+        g_trace_file = fopen(path, "w");
+        if (!g_trace_file) {
+                syslog(LOG_ERR, "Trace: cannot create %s: %s", path, strerror(errno));
+                fprintf(stderr, "Trace: cannot create %s: %s\n", path, strerror(errno));
+                return -1;
+        }
+        g_trace_epoch_us = get_time_us();
+        atomic_store(&g_tracing, 1);
+        trace_thread_name("main");
+        return 0;
+}
+
+void trace_close(void) {
+        if (!atomic_load_explicit(&g_tracing, memory_order_relaxed)) return;
+        atomic_store(&g_tracing, 0);
+        FILE *f = g_trace_file;
+        long pid = (long)getpid();
+        int first = 1;
+
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        pthread_mutex_lock(&g_rings_mutex);
+        for (Trace_Ring *ring = g_rings; ring; ring = ring->next) {
+                fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+                        first ? "" : ",\n", pid, ring->tid, ring->name);
+                first = 0;
+                unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+                unsigned long begin = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+                for (unsigned long i = begin; i < head; i++) {
+                        const Trace_Record *r = &ring->records[i % TRACE_RING_EVENTS];
+                        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"ts\":%ld,\"dur\":%ld,"
+                                "\"pid\":%ld,\"tid\":%ld,\"args\":{\"arg\":%ld}}",
+                                event_names[r->ev], r->ts, r->dur, pid, ring->tid, r->arg);
+                }
+        }
+        pthread_mutex_unlock(&g_rings_mutex);
+        fprintf(f, "\n]}\n");
+        fclose(f);
+        g_trace_file = NULL;
+        // Rings are left allocated, a thread that is still running may
+        // hold a pointer to its own.
+}
@@ -0,0 +1,224 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <syslog.h>
+
+#include <X11/Xutil.h>
+
+#ifdef HAVE_XCB_SHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/shm.h>
+#endif
+
+#include "AnimX-upload.h"
+
+#ifdef HAVE_XCB_SHM
+// Waits until the server is done with everything put from the slot,
+// logging whatever it rejected.
+static void drain_slot(Uploader *up, Upload_Slot *slot) {
+        for (int i = 0; i < slot->num_cookies; i++) {
+                xcb_generic_error_t *e = xcb_request_check(up->conn, slot->cookies[i]);
+                if (e) {
+                        syslog(LOG_ERR, "Upload: shared memory put failed with X error %d", (int)e->error_code);
+                        up->errors++;
+                        free(e);
+                }
+        }
+        slot->num_cookies = 0;
+}
+
+static int create_shm_slot(Uploader *up, Upload_Slot *slot, size_t size) {
+        slot->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+        if (slot->shmid < 0) {
+                return -1;
+        }
+        slot->data = (uint8_t *)shmat(slot->shmid, NULL, 0);
+        if (slot->data == (void *)-1) {
+                slot->data = NULL;
+                shmctl(slot->shmid, IPC_RMID, NULL);
+                return -1;
+        }
+
+        // Attaching is the one round trip, it fails on remote servers
+        slot->shmseg = xcb_generate_id(up->conn);
+        xcb_generic_error_t *e = xcb_request_check(up->conn, xcb_shm_attach_checked(up->conn, slot->shmseg, slot->shmid, 1));
+        // Goes away by itself once both sides have detached
+        shmctl(slot->shmid, IPC_RMID, NULL);
+        if (e) {
+                free(e);
+                shmdt(slot->data);
+                slot->data = NULL;
+                return -1;
+        }
+        return 0;
+}
+
+static void destroy_shm_slot(Uploader *up, Display_Session *ds, Upload_Slot *slot) {
+        pthread_mutex_lock(&ds->lock);
+        int open = ds->display != NULL;
+        pthread_mutex_unlock(&ds->lock);
+        if (open) {
+                drain_slot(up, slot);
+                xcb_shm_detach(up->conn, slot->shmseg);
+                xcb_flush(up->conn);
+        }
+        shmdt(slot->data);
+        free(slot->cookies);
+        slot->cookies = NULL;
+        slot->num_cookies = slot->cap_cookies = 0;
+}
+#endif
+
+static void free_slots(Uploader *up, Display_Session *ds) {
+        for (int i = 0; i < UPLOAD_SLOTS; i++) {
+                Upload_Slot *slot = &up->slots[i];
+                if (!slot->data) continue;
+#ifdef HAVE_XCB_SHM
+                if (up->kind == UPLOAD_XCB_SHM) {
+                        destroy_shm_slot(up, ds, slot);
+                } else {
+                        free(slot->data);
+                }
+#else
+                (void)ds;
+                free(slot->data);
+#endif
+                slot->data = NULL;
+        }
+        up->size = 0;
+}
+
+static int create_slots(Uploader *up, size_t size) {
+        for (int i = 0; i < UPLOAD_SLOTS; i++) {
+                Upload_Slot *slot = &up->slots[i];
+#ifdef HAVE_XCB_SHM
+                if (up->kind == UPLOAD_XCB_SHM) {
+                        if (create_shm_slot(up, slot, size) < 0) return -1;
+                        continue;
+                }
+#endif
+                slot->data = (uint8_t *)malloc(size);
+                if (!slot->data) return -1;
+        }
+        return 0;
+}
+
+// Uses shared memory through XCB when the server has MIT-SHM
+static void choose_kind(Uploader *up, Display_Session *ds) {
+        up->kind = UPLOAD_XLIB;
+        up->probed = 1;
+#ifdef HAVE_XCB_SHM
+        pthread_mutex_lock(&ds->lock);
+        xcb_connection_t *conn = ds->display ? XGetXCBConnection(ds->display) : NULL;
+        pthread_mutex_unlock(&ds->lock);
+        if (!conn) return;
+        xcb_shm_query_version_reply_t *reply = xcb_shm_query_version_reply(conn, xcb_shm_query_version(conn), NULL);
+        if (!reply) return;
+        free(reply);
+        up->conn = conn;
+        up->kind = UPLOAD_XCB_SHM;
+#else
+        (void)ds;
+#endif
+}
+
+uint8_t *upload_acquire(Uploader *up, Display_Session *ds, size_t size) {
+        if (size != up->size) {
+                free_slots(up, ds);
+                if (!up->probed) {
+                        choose_kind(up, ds);
+                }
+                if (create_slots(up, size) < 0) {
+                        free_slots(up, ds);
+                        if (up->kind == UPLOAD_XLIB) {
+                                syslog(LOG_ERR, "Upload: failed to allocate frame buffers");
+                                return NULL;
+                        }
+                        syslog(LOG_INFO, "Upload: shared memory unavailable, using XPutImage");
+                        up->kind = UPLOAD_XLIB;
+                        if (create_slots(up, size) < 0) {
+                                free_slots(up, ds);
+                                syslog(LOG_ERR, "Upload: failed to allocate frame buffers");
+                                return NULL;
+                        }
+                }
+                up->size = size;
+                up->current = 0;
+                return up->slots[0].data;
+        }
+
+        up->current = (up->current + 1) % UPLOAD_SLOTS;
+        Upload_Slot *slot = &up->slots[up->current];
+#ifdef HAVE_XCB_SHM
+        if (up->kind == UPLOAD_XCB_SHM) {
+                drain_slot(up, slot);
+        }
+#endif
+        return slot->data;
+}
+
+int upload_put(Uploader *up, Display_Session *ds, Drawable drawable, GC gc, size_t offset,
+               int width, int height, const XRectangle *src, int dst_x, int dst_y) {
+        Upload_Slot *slot = &up->slots[up->current];
+#ifdef HAVE_XCB_SHM
+        if (up->kind == UPLOAD_XCB_SHM) {
+                if (slot->num_cookies == slot->cap_cookies) {
+                        int cap = slot->cap_cookies ? slot->cap_cookies * 2 : 16;
+                        xcb_void_cookie_t *cookies = (xcb_void_cookie_t *)realloc(slot->cookies, cap * sizeof(*cookies));
+                        if (!cookies) {
+                                drain_slot(up, slot); // Nothing left to keep track of
+                        } else {
+                                slot->cookies = cookies;
+                                slot->cap_cookies = cap;
+                        }
+                }
+                XFlushGC(ds->display, gc);
+                xcb_void_cookie_t cookie = xcb_shm_put_image_checked(
+                        up->conn, drawable, XGContextFromGC(gc), width, height,
+                        src->x, src->y, src->width, src->height, dst_x, dst_y,
+                        ds->depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, slot->shmseg, (uint32_t)offset);
+                if (slot->num_cookies < slot->cap_cookies) {
+                        slot->cookies[slot->num_cookies++] = cookie;
+                }
+                return 0;
+        }
+#endif
+        XImage *ximage = XCreateImage(ds->display, ds->visual, ds->depth, ZPixmap, 0,
+                                      (char *)slot->data + offset, width, height, 32, width * 4);
+        if (!ximage) {
+                return -1;
+        }
+        ximage->byte_order = ImageByteOrder(ds->display);
+        int put = XPutImage(ds->display, drawable, gc, ximage, src->x, src->y, dst_x, dst_y, src->width, src->height);
+        ximage->data = NULL; // Belongs to the slot
+        XDestroyImage(ximage);
+        return put == Success ? 0 : -1;
+}
+
+const char *upload_kind_name(const Uploader *up) {
+        return up->kind == UPLOAD_XCB_SHM ? "xcb-shm" : "xlib";
+}
+
+void upload_cleanup(Uploader *up, Display_Session *ds) {
+        free_slots(up, ds);
+}
@@ -49,3 +49,24 @@ char *resolve(const char *fp) {
         }
         return rp;
 }
+
+long get_time_us(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L; // Microseconds
+}
+
+struct timespec us_to_timespec(long us) {
+        struct timespec ts;
+        ts.tv_sec = us / 1000000L;
+        ts.tv_nsec = (us % 1000000L) * 1000L;
+        return ts;
+}
+
+void init_monotonic_cond(pthread_cond_t *cond) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(cond, &attr);
+        pthread_condattr_destroy(&attr);
+}
@@ -0,0 +1,65 @@
+/*
+ * AnimX: Animated Wallpapers for X
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+// Maps an override-redirect window over the whole screen, or over
+// `<w>x<h>+<x>+<y>`, and keeps it there until killed. occlusion.sh uses
+// it to cover the wallpaper without a window manager.
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+
+int main(int argc, char **argv) {
+        Display *display = XOpenDisplay(NULL);
+        if (!display) {
+                fprintf(stderr, "AnimX-cover: cannot open X display\n");
+                return 1;
+        }
+        int screen = DefaultScreen(display);
+        unsigned width = DisplayWidth(display, screen), height = DisplayHeight(display, screen);
+        int x = 0, y = 0;
+        if (argc > 1 && sscanf(argv[1], "%ux%u+%d+%d", &width, &height, &x, &y) != 4) {
+                fprintf(stderr, "usage: AnimX-cover [<w>x<h>+<x>+<y>]\n");
+                return 1;
+        }
+
+        XSetWindowAttributes attrs = {
+                .override_redirect = True,
+                .background_pixel = BlackPixel(display, screen),
+                .event_mask = StructureNotifyMask,
+        };
+        Window window = XCreateWindow(display, RootWindow(display, screen), x, y, width, height, 0,
+                                      CopyFromParent, InputOutput, CopyFromParent,
+                                      CWOverrideRedirect | CWBackPixel | CWEventMask, &attrs);
+        XMapRaised(display, window);
+        XEvent ev;
+        do {
+                XNextEvent(display, &ev);
+        } while (ev.type != MapNotify);
+        printf("mapped 0x%lx %ux%u+%d+%d\n", window, width, height, x, y);
+        fflush(stdout);
+
+        // Unmapped by the server when the connection goes away
+        signal(SIGTERM, SIG_DFL);
+        pause();
+        return 0;
+}
@@ -0,0 +1,132 @@
+#!/bin/sh
+# Occlusion end to end: plays a clip on an Xvfb display through the
+# daemon, covers the wallpaper with a window (AnimX-cover) and checks
+# that decoding and presenting stop, then that playback resumes once
+# the window is gone. Counters come from `AnimX --stats`, the covered
+# state from `AnimX --status`.
+#
+# The daemon's socket and pid file are fixed, so this skips when a
+# daemon is already running.
+
+set -u
+
+: "${ANIMX:=../src/AnimX}"
+: "${COVER:=./AnimX-cover}"
+: "${FFMPEG:=ffmpeg}"
+: "${XVFB:=Xvfb}"
+: "${PERF_DIR:=.}"
+: "${OCCLUSION_SETTLE:=2}"         # Seconds counters are watched in each state
+
+CLIPS=$PERF_DIR/clips
+RESULTS=$PERF_DIR/results
+mkdir -p "$CLIPS" "$RESULTS"
+
+xvfb_pid=
+cover_pid=
+daemon_started=
+failures=0
+
+fail() {
+        echo "FAIL: $*"
+        failures=$((failures + 1))
+}
+
+cleanup() {
+        [ -n "$cover_pid" ] && kill "$cover_pid" 2>/dev/null && wait "$cover_pid" 2>/dev/null
+        [ -n "$daemon_started" ] && "$ANIMX" --stop >/dev/null 2>&1
+        [ -n "$xvfb_pid" ] && kill "$xvfb_pid" 2>/dev/null && wait "$xvfb_pid" 2>/dev/null
+        [ -n "${HOME_DIR:-}" ] && rm -rf "$HOME_DIR"
+}
+trap cleanup EXIT
+
+# stat <key>: a line of --stats, status <key>: a line of --status
+stat() {
+        "$ANIMX" --stats 2>/dev/null | sed -n "s/^$1=//p"
+}
+
+status() {
+        "$ANIMX" --status 2>/dev/null | sed -n "s/^$1=//p"
+}
+
+# wait_for <seconds> <command...>: polls until the command succeeds
+wait_for() {
+        tries=$(($1 * 10))
+        shift
+        while [ $tries -gt 0 ]; do
+                "$@" && return 0
+                sleep 0.1
+                tries=$((tries - 1))
+        done
+        return 1
+}
+
+is_ready() { [ "$(status ready)" = 1 ]; }
+is_covered() { [ "$(status visible)" = 0x0 ]; }
+is_visible() { v=$(status visible); [ -n "$v" ] && [ "$v" != 0x0 ]; }
+
+command -v "$FFMPEG" >/dev/null 2>&1 || { echo "SKIP: $FFMPEG not found"; exit 77; }
+command -v "$XVFB" >/dev/null 2>&1 || { echo "SKIP: $XVFB not found"; exit 77; }
+[ -x "$COVER" ] || { echo "SKIP: $COVER not built"; exit 77; }
+if [ -e /tmp/AnimX.pid ] && kill -0 "$(cat /tmp/AnimX.pid)" 2>/dev/null; then
+        echo "SKIP: an AnimX daemon is already running"
+        exit 77
+fi
+
+clip=$CLIPS/h264-720p30.mp4
+if [ ! -s "$clip" ]; then
+        "$FFMPEG" -nostdin -loglevel error -y -f lavfi -i testsrc2=size=1280x720:rate=30 -t 4 \
+                -c:v libx264 -pix_fmt yuv420p "$clip" || { rm -f "$clip"; echo "SKIP: cannot encode H.264"; exit 77; }
+fi
+
+n=99
+while [ -e "/tmp/.X11-unix/X$n" ]; do n=$((n + 1)); done
+"$XVFB" ":$n" -nolisten tcp -screen 0 1920x1080x24 >/dev/null 2>&1 &
+xvfb_pid=$!
+wait_for 5 test -e "/tmp/.X11-unix/X$n" || { echo "SKIP: $XVFB did not start"; exit 77; }
+DISPLAY=:$n
+export DISPLAY
+
+# ~/.AnimX is written on every run, keep it out of the real home
+HOME_DIR=$(mktemp -d)
+HOME=$HOME_DIR
+export HOME
+
+clip=$(cd "$(dirname "$clip")" && pwd)/$(basename "$clip")
+"$ANIMX" -d "$clip" --occlusion=on >"$RESULTS/occlusion.log" 2>&1
+daemon_started=yes
+wait_for 10 is_ready || { echo "FAIL: the daemon never became ready, see $RESULTS/occlusion.log"; exit 1; }
+
+# Playing
+sleep "$OCCLUSION_SETTLE"
+p1=$(stat frames.presented)
+sleep "$OCCLUSION_SETTLE"
+p2=$(stat frames.presented)
+echo "visible: presented $p1 -> $p2"
+[ "${p2:-0}" -gt "${p1:-0}" ] || fail "nothing was presented while visible"
+
+# Covered: nothing decoded or presented
+"$COVER" >"$RESULTS/occlusion-cover.log" 2>&1 &
+cover_pid=$!
+wait_for 5 is_covered || fail "--status never reported the wallpaper covered (visible=$(status visible))"
+sleep 0.5 # A frame already on its way may still land
+p3=$(stat frames.presented)
+d3=$(stat decode.count)
+sleep "$OCCLUSION_SETTLE"
+p4=$(stat frames.presented)
+d4=$(stat decode.count)
+echo "covered: presented $p3 -> $p4, decoded $d3 -> $d4, paused=$(status paused)"
+[ "${p4:-0}" -eq "${p3:-0}" ] || fail "$((p4 - p3)) frame(s) presented while covered"
+[ "${d4:-0}" -eq "${d3:-0}" ] || fail "$((d4 - d3)) frame(s) decoded while covered"
+
+# Uncovered: playback resumes
+kill "$cover_pid" 2>/dev/null
+wait "$cover_pid" 2>/dev/null
+cover_pid=
+wait_for 5 is_visible || fail "--status never reported the wallpaper visible again"
+sleep "$OCCLUSION_SETTLE"
+p5=$(stat frames.presented)
+echo "uncovered: presented $p4 -> $p5"
+[ "${p5:-0}" -gt "${p4:-0}" ] || fail "playback did not resume after the window was unmapped"
+
+[ $failures -eq 0 ] || { echo "$failures check(s) failed"; exit 1; }
+exit 0
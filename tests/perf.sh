@@ -0,0 +1,210 @@
+#!/bin/sh
+# End-to-end performance suite. Generates synthetic clips with FFmpeg's
+# lavfi sources and runs `AnimX --bench` on them: headless (--sink=null)
+# and on an Xvfb display with one, two and three monitors. Every result
+# is checked against fixed budgets and against the stored baseline.
+#
+#   PERF_MODE=check  (make check) fail on a blown budget or a regression
+#   PERF_MODE=bench  (make bench) measure and store the new baseline
+#
+# Everything below can be overridden from the environment.
+
+set -u
+
+: "${ANIMX:=../src/AnimX}"
+: "${FFMPEG:=ffmpeg}"
+: "${XVFB:=Xvfb}"
+: "${XRANDR:=xrandr}"
+: "${PERF_MODE:=check}"
+: "${PERF_DIR:=.}"
+: "${PERF_BASELINE:=$PERF_DIR/baseline}"
+: "${PERF_SECONDS:=3}"
+: "${PERF_TOLERANCE:=20}"          # Percent a result may be worse than the baseline
+: "${PERF_MIN_FPS:=24}"            # Unpaced runs
+: "${PERF_MAX_STARTUP_MS:=1500}"   # Until the first frame is done
+: "${PERF_MAX_RSS_KB:=1048576}"
+: "${PERF_PACED_FPS:=30}"
+: "${PERF_MAX_JITTER_US:=8000}"    # Standard deviation of the frame interval at PERF_PACED_FPS
+
+CLIPS=$PERF_DIR/clips
+RESULTS=$PERF_DIR/results
+mkdir -p "$CLIPS" "$RESULTS" "$PERF_BASELINE"
+
+ran=0
+failures=0
+xvfb_pid=
+
+fail() {
+        echo "FAIL: $*"
+        failures=$((failures + 1))
+}
+
+# Numeric top-level field of a --bench report
+field() {
+        sed -n "s/^  \"$2\": \\([0-9.]*\\),\$/\\1/p" "$1"
+}
+
+# awk does the floating point
+le() {
+        awk -v a="$1" -v b="$2" 'BEGIN { exit !(a <= b) }'
+}
+
+# make_clip <file> <ffmpeg output options...>
+make_clip() {
+        out=$CLIPS/$1
+        shift
+        [ -s "$out" ] && return 0
+        "$FFMPEG" -nostdin -loglevel error -y "$@" "$out" || { rm -f "$out"; return 1; }
+}
+
+make_clips() {
+        make_clip h264-720p30.mp4 -f lavfi -i testsrc2=size=1280x720:rate=30 -t 4 \
+                -c:v libx264 -pix_fmt yuv420p
+        make_clip h264-1080p60.mp4 -f lavfi -i testsrc2=size=1920x1080:rate=60 -t 4 \
+                -c:v libx264 -pix_fmt yuv420p
+        make_clip vp9-720p30.webm -f lavfi -i testsrc2=size=1280x720:rate=30 -t 4 \
+                -c:v libvpx-vp9 -deadline realtime -cpu-used 8 \
+                || echo "SKIP: no VP9 encoder, vp9 clips are left out"
+        make_clip still.png -f lavfi -i testsrc2=size=1920x1080 -frames:v 1
+        make_clip still.jpg -f lavfi -i testsrc2=size=1920x1080 -frames:v 1
+}
+
+# start_xvfb <monitors>: 1920x1080 per monitor side by side. Returns 1
+# when this Xvfb cannot offer that many monitors.
+start_xvfb() {
+        monitors=$1
+        crtcs=
+        if [ "$monitors" -gt 1 ]; then
+                "$XVFB" -help 2>&1 | grep -q -- -crtcs || return 1
+                crtcs="-crtcs $monitors"
+        fi
+        n=99
+        while [ -e "/tmp/.X11-unix/X$n" ]; do n=$((n + 1)); done
+        # shellcheck disable=SC2086
+        "$XVFB" ":$n" -nolisten tcp -screen 0 "$((1920 * monitors))x1080x24" $crtcs >/dev/null 2>&1 &
+        xvfb_pid=$!
+        i=0
+        while [ ! -e "/tmp/.X11-unix/X$n" ] && [ $i -lt 50 ]; do sleep 0.1; i=$((i + 1)); done
+        DISPLAY=:$n
+        export DISPLAY
+        if [ "$monitors" -gt 1 ]; then
+                x=0
+                for out in $("$XRANDR" 2>/dev/null | awk '/ connected/ { print $1 }'); do
+                        "$XRANDR" --output "$out" --mode 1920x1080 --pos "${x}x0" 2>/dev/null
+                        x=$((x + 1920))
+                done
+                active=$("$XRANDR" --listactivemonitors 2>/dev/null | sed -n 's/^Monitors: //p')
+                [ "${active:-0}" -ge "$monitors" ] || { stop_xvfb; return 1; }
+        fi
+        return 0
+}
+
+stop_xvfb() {
+        [ -n "$xvfb_pid" ] && kill "$xvfb_pid" 2>/dev/null && wait "$xvfb_pid" 2>/dev/null
+        xvfb_pid=
+        unset DISPLAY
+}
+
+trap stop_xvfb EXIT
+
+# check_case <name>: budgets, then the baseline
+check_case() {
+        name=$1
+        paced=$2
+        res=$RESULTS/$name.json
+        fps=$(field "$res" fps)
+        startup=$(field "$res" startup_ms)
+        rss=$(field "$res" peak_rss_kb)
+        jitter=$(field "$res" jitter_us)
+        echo "$name: fps=$fps startup_ms=$startup peak_rss_kb=$rss jitter_us=$jitter"
+
+        if [ "$paced" = yes ]; then
+                le "$(awk -v f="$PERF_PACED_FPS" 'BEGIN { print f * 0.9 }')" "$fps" \
+                        || fail "$name: $fps fps, paced at $PERF_PACED_FPS"
+                le "$jitter" "$PERF_MAX_JITTER_US" || fail "$name: jitter ${jitter}us > ${PERF_MAX_JITTER_US}us"
+        else
+                le "$PERF_MIN_FPS" "$fps" || fail "$name: $fps fps < $PERF_MIN_FPS"
+        fi
+        le "$startup" "$PERF_MAX_STARTUP_MS" || fail "$name: startup ${startup}ms > ${PERF_MAX_STARTUP_MS}ms"
+        le "$rss" "$PERF_MAX_RSS_KB" || fail "$name: peak RSS ${rss}KB > ${PERF_MAX_RSS_KB}KB"
+
+        base=$PERF_BASELINE/$name.json
+        if [ ! -s "$base" ]; then
+                echo "$name: no baseline yet, storing this run"
+                cp "$res" "$base"
+                return
+        fi
+        worse=$((100 + PERF_TOLERANCE))
+        better=$((100 - PERF_TOLERANCE))
+        # Higher is better for fps, lower for the rest. Small absolute
+        # slack keeps timer noise on tiny values from failing the run.
+        b=$(field "$base" fps)
+        [ "$paced" = yes ] || le "$(awk -v b="$b" -v p="$better" 'BEGIN { print b * p / 100 }')" "$fps" \
+                || fail "$name: fps regressed from $b to $fps"
+        b=$(field "$base" startup_ms)
+        le "$startup" "$(awk -v b="$b" -v p="$worse" 'BEGIN { print b * p / 100 + 50 }')" \
+                || fail "$name: startup regressed from ${b}ms to ${startup}ms"
+        b=$(field "$base" peak_rss_kb)
+        le "$rss" "$(awk -v b="$b" -v p="$worse" 'BEGIN { print b * p / 100 + 4096 }')" \
+                || fail "$name: peak RSS regressed from ${b}KB to ${rss}KB"
+        b=$(field "$base" jitter_us)
+        [ "$paced" = no ] || le "$jitter" "$(awk -v b="$b" -v p="$worse" 'BEGIN { print b * p / 100 + 1000 }')" \
+                || fail "$name: jitter regressed from ${b}us to ${jitter}us"
+}
+
+# run_case <name> <paced: yes|no> <clip> <AnimX options...>
+run_case() {
+        name=$1
+        paced=$2
+        clip=$CLIPS/$3
+        shift 3
+        [ -s "$clip" ] || return 0
+        fps_opt=
+        [ "$paced" = yes ] && fps_opt=--fps=$PERF_PACED_FPS
+        # shellcheck disable=SC2086
+        if ! "$ANIMX" --bench="$PERF_SECONDS" "$clip" $fps_opt "$@" >"$RESULTS/$name.json" 2>"$RESULTS/$name.log"; then
+                fail "$name: AnimX --bench failed, see $RESULTS/$name.log"
+                return
+        fi
+        ran=$((ran + 1))
+        if [ "$PERF_MODE" = bench ]; then
+                cp "$RESULTS/$name.json" "$PERF_BASELINE/$name.json"
+                echo "$name: fps=$(field "$RESULTS/$name.json" fps) (baseline updated)"
+        else
+                check_case "$name" "$paced"
+        fi
+}
+
+command -v "$FFMPEG" >/dev/null 2>&1 || { echo "SKIP: $FFMPEG not found"; exit 77; }
+make_clips
+
+# Headless: the whole pipeline into --sink=null, no X server involved
+unset DISPLAY
+for clip in h264-720p30.mp4 h264-1080p60.mp4 vp9-720p30.webm still.png still.jpg; do
+        run_case "null-$(echo "$clip" | tr . -)" no "$clip" --stages=demux,decode,scale,present --sink=null
+done
+
+if command -v "$XVFB" >/dev/null 2>&1; then
+        for monitors in 1 2 3; do
+                if ! start_xvfb "$monitors"; then
+                        echo "SKIP: $XVFB cannot provide $monitors monitors"
+                        continue
+                fi
+                for clip in h264-720p30.mp4 h264-1080p60.mp4 vp9-720p30.webm; do
+                        run_case "xvfb${monitors}-combined-${clip%.*}" no "$clip" \
+                                --stages=demux,decode,scale,present --mon=-1
+                done
+                run_case "xvfb${monitors}-paced-h264-1080p60" yes h264-1080p60.mp4 \
+                        --stages=demux,decode,scale,present --mon=-1
+                [ "$monitors" -gt 1 ] && run_case "xvfb${monitors}-mirror-h264-720p30" no h264-720p30.mp4 \
+                        --stages=demux,decode,scale,present --mon=-2
+                run_case "xvfb${monitors}-still-png" no still.png --stages=demux,decode,scale,present --mon=-1
+                stop_xvfb
+        done
+else
+        echo "SKIP: $XVFB not found, only headless cases ran"
+fi
+
+[ $ran -gt 0 ] || { echo "SKIP: nothing could run"; exit 77; }
+[ $failures -eq 0 ] || { echo "$failures check(s) failed"; exit 1; }
+exit 0